@@ -278,6 +278,13 @@ inline float frameScore(CGPoint target, CGPoint goal)
                                                        GyroFile:gyroStr 
                                                   motionManager:self.motionManager];
     
+    // gyro measurements predict the template motion between frames
+    __weak RenderedCameraView *view = self.cameraView;
+    self.inertialLog.gyroObserver = ^(CMGyroData *gyroData)
+    {
+        [view addGyroSample:gyroData.rotationRate timestamp:gyroData.timestamp];
+    };
+    
     ok = ok && (self.frameLog != nil);
     return ok;
 }
@@ -397,14 +404,12 @@ inline float frameScore(CGPoint target, CGPoint goal)
         }
 #endif
         
-        see_uniformThresh(&saliency, w*h);
-        
-        int nlabels = 0;
-        img labels = see_labelBlobs(saliency, w, h, nlabels);
-        
-        float selected = see_selectMostMeaningfulBlob(saliency, w*h, labels, nlabels, 
-                                                      true, 0, 0, 0, 0);
-        see_weightedMean( saliency, w, h, labels, selected, wx, wy);
+        img labels = 0;
+#ifdef LOG_EXPERIMENT_DATA
+        see_salientBlobCentroid(saliency, w, h, wx, wy, &labels);
+#else
+        see_salientBlobCentroid(saliency, w, h, wx, wy);
+#endif
             
         // ------------------------------------------------------------------------ //
         // Update target-related variables    
@@ -524,7 +529,7 @@ inline float frameScore(CGPoint target, CGPoint goal)
         [self.cameraView setUpGrayResizeShader];
         
         nextIm = [cameraView intensityFromPixelBufferRef:pixelBufferRef];
-        trackingResult = [cameraView trackTemplate:nextIm];
+        trackingResult = [cameraView trackTemplate:nextIm presentationTime:time];
         free(nextIm);    
         
         blur = trackingResult.z;
@@ -539,7 +544,7 @@ inline float frameScore(CGPoint target, CGPoint goal)
         // Track ROI  
         
         nextIm = [cameraView intensityFromPixelBufferRef:pixelBufferRef];
-        trackingResult = [cameraView trackTemplate:nextIm];
+        trackingResult = [cameraView trackTemplate:nextIm presentationTime:time];
         free(nextIm);     
         
         blur = trackingResult.z;
@@ -617,9 +622,9 @@ inline float frameScore(CGPoint target, CGPoint goal)
     
 #ifdef LOG_EXPERIMENT_DATA
     // update target log
-    str = [NSString stringWithFormat:@"%07d %f %f %f %f %f %f %d %d %d\n", self.frameLog.frameCount, CMTimeGetSeconds(time), 
+    str = [NSString stringWithFormat:@"%07d %f %f %f %f %f %f %d %d %d %d\n", self.frameLog.frameCount, CMTimeGetSeconds(time), 
            self.targetMarkerView.targetPoint.x, self.targetMarkerView.targetPoint.y, 
-           distance, radians, blur, trackingStatus, isNewBestFrame, reachedGoal];
+           distance, radians, blur, trackingStatus, isNewBestFrame, reachedGoal, self.cameraView.trackingIterations];
     if (![self.targetLog appendString:str])
     {
         DebugLog(@"ERROR: Could not record target status in log!");
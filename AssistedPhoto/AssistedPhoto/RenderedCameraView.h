@@ -32,12 +32,16 @@
 //
 
 #import <UIKit/UIKit.h>
+#import <CoreMedia/CoreMedia.h>
+#import <CoreMotion/CoreMotion.h>
 #import <GLVision/GLVViewSaliency.h>
 #import <GLVision/GLVPrograms.h>
 #import <BasicMath/Matrix4.h>
 #import <See/ImageTypes.h>
 #import <BasicMath/Rectangle.h>
 #import <See/ImageMotion.h>
+#import <See/ImageSaliency.h>
+#import <See/MotionPrediction.h>
 
 @protocol TrackingDelegate
 @optional
@@ -74,8 +78,16 @@ typedef enum
     TexImage resizeTexture;
     
     img prevIm;
+    double prevImTime;                          //!< presentation time of prevIm (seconds, < 0 if unknown)
     Rectangle templateBox;
     
+    GyroPredictor gyroPredictor;                //!< gyro samples used to predict the template motion
+    
+    NCCTemplate nccTemplate;                    //!< template of prevIm used to re-acquire it when tracking fails
+    BOOL nccTemplateSet;                        //!< nccTemplate holds the current template of prevIm
+    
+    SaliencyEngine saliencyEngine;              //!< saliency workspaces reused between frames
+    
     GLVSize maxProcessingSizeTracking;          //!< maximum processing size when tracking
 }
 
@@ -85,6 +97,7 @@ typedef enum
 @property (atomic, assign) FeatureType featureType; 
 @property (atomic, assign) TRACKINGRESULT trackingStatus;
 @property (nonatomic, assign) GLVSize maxProcessingSizeTracking; //!< maximum processing size when tracking
+@property (atomic, assign) int trackingIterations;  //!< iterations needed to track the last frame (-1 if unknown)
 
 - (id) initWithFrame:(CGRect)frame maxProcessingSize:(GLVSize)maxSize maxSizeTracking:(GLVSize)maxSizeTrack;
 - (BOOL) setUpColorResizeShader;
@@ -99,6 +112,9 @@ typedef enum
 
 - (img) intensityFromPixelBufferRef:(CVPixelBufferRef)pixelBufferRef;
 - (Vector3) trackTemplate:(img)nextIm;
+- (Vector3) trackTemplate:(img)nextIm presentationTime:(CMTime)time;
+- (void) addGyroSample:(CMRotationRate)rate timestamp:(NSTimeInterval)timestamp;
+- (Vector2) gyroMotionFrom:(double)t0 to:(double)t1;
 
 - (void) renderPixelBufferRef:(CVPixelBufferRef)pixelBufferRef;
 
@@ -38,6 +38,7 @@
 #import <See/ImageConversion.h>
 #import <See/ImageSaliency.h>
 #import <See/ImageBlurriness.h>
+#import <See/SeeThreadPool.h>
 #import <DataLogging/DLTiming.h>
 
 #define TIME_FEATURE_COMPUTATION
@@ -46,6 +47,12 @@
 
 #define TEMPLATE_EPSILON  0.005 //0.00003 // 0.05
 #define TEMPLATE_MAX_ITER 300 //1000 // 50
+#define TEMPLATE_SEARCH_RADIUS 16   //!< radius (pixels) of the coarse search that initializes the template motion
+#define TEMPLATE_SEARCH_SCALE  2    //!< downsampling of the coarse search
+#define TEMPLATE_REACQUIRE_NCC 0.8  //!< smallest NCC of the template found anywhere in the frame after tracking fails
+
+#define GYRO_FOCAL_LENGTH 605.4341  //!< focal length of a GYRO_FOCAL_WIDTH wide portrait image (see PinholeCameraTargetEstimator)
+#define GYRO_FOCAL_WIDTH  320.0     //!< image width GYRO_FOCAL_LENGTH refers to
 
 inline float maxi(int a, int b){ return (a > b ? a : b); }
 inline float mini(int a, int b){ return (a < b ? a : b); }
@@ -61,6 +68,7 @@ static Matrix4 resizeProjection;
 @synthesize featureType;
 @synthesize trackingStatus;
 @synthesize maxProcessingSizeTracking;
+@synthesize trackingIterations;
 
 - (id) initWithFrame:(CGRect)frame maxProcessingSize:(GLVSize)maxSize maxSizeTracking:(GLVSize)maxSizeTrack;
 {
@@ -101,6 +109,10 @@ static Matrix4 resizeProjection;
         projection = Matrix4::orthographic(0, self.frame.size.width, self.frame.size.height, 0, 0, 1); 
         
         self.featureType = FEAT_INT;
+        
+        prevImTime = -1;
+        self.trackingIterations = -1;
+        see_initGyroPredictor(gyroPredictor);
     }
     return self;
 }
@@ -109,6 +121,10 @@ static Matrix4 resizeProjection;
 {
     if (resizeTexture.textureID)
         glDeleteTextures(1, &(resizeTexture.textureID));
+    
+    see_freeSaliencyEngine(saliencyEngine);
+    see_freeGyroPredictor(gyroPredictor);
+    see_freeNCCTemplate(nccTemplate);
 }
 
 - (void) setUpBufferObjects
@@ -251,6 +267,7 @@ static Matrix4 resizeProjection;
 - (void) setTemplateBox:(Rectangle)rect
 {
     templateBox = rect;
+    nccTemplateSet = NO;
     self.trackingStatus = TRACKING_OK;
 }
 
@@ -289,7 +306,11 @@ static Matrix4 resizeProjection;
         cblas_scopy(self.maxProcessingSize.width, src+2, -4, featBY +r,  self.maxProcessingSize.height);
     }
     
-    see_saliencyIttiWithFeatures(featInt, featRG, featBY, *w, *h, pyrLev, surrLev, saliency);
+    // one thread per feature channel at most (the maps are small, so rows are not split)
+    size_t threads = MIN(see_numberOfCores(), (size_t)3);
+    see_initSaliencyEngine(saliencyEngine, *w, *h, pyrLev, surrLev, threads);
+    saliency = (float *)malloc((*w)*(*h)*sizeof(float));
+    see_saliencyEngineIttiWithFeatures(saliencyEngine, featInt, featRG, featBY, saliency);
     
     free(featInt);
     free(featRG);
@@ -453,6 +474,36 @@ static Matrix4 resizeProjection;
 }
 
 - (Vector3) trackTemplate:(img)nextIm
+{
+    return [self trackTemplate:nextIm presentationTime:kCMTimeInvalid];
+}
+
+// Feeds the motion prediction; called from the gyro queue
+- (void) addGyroSample:(CMRotationRate)rate timestamp:(NSTimeInterval)timestamp
+{
+    see_gyroPredictorAddSample(gyroPredictor, timestamp, rate.x, rate.y, rate.z);
+}
+
+// Motion of the template center in the tracking image due to the rotation measured by the gyro between t0 and t1
+// (zero if the gyro samples do not cover the interval)
+- (Vector2) gyroMotionFrom:(double)t0 to:(double)t1
+{
+    Vector2 motion(0,0);
+    float rotation[3];
+    if (!see_gyroPredictorRotation(gyroPredictor, t0, t1, rotation)) return motion;
+    
+    // device axes (x to the right of the screen, y up, z out of the screen) to tracking image axes
+    // (columns go down the screen, rows go to the left and the camera looks into the screen)
+    float cameraRotation[3] = {-rotation[1], -rotation[0], -rotation[2]};
+    float width = resizeTexture.size.height, height = resizeTexture.size.width;
+    float focal = GYRO_FOCAL_LENGTH*height/GYRO_FOCAL_WIDTH;
+    Vector2 center = templateBox.center();
+    see_predictRotationMotion(cameraRotation, focal, Vector2(center.x - width/2.0, center.y - height/2.0), motion);
+    return motion;
+}
+
+// The template motion is seeded with the gyro prediction when the presentation time is valid
+- (Vector3) trackTemplate:(img)nextIm presentationTime:(CMTime)time
 {
     if (self.trackingStatus != TRACKING_OK)
     {
@@ -473,6 +524,8 @@ static Matrix4 resizeProjection;
     see_scaleTo(nextImNorm, imSize, 1.0);
     
     Vector2 motion(0,0);
+    double nextImTime = (CMTIME_IS_VALID(time) ? CMTimeGetSeconds(time) : -1);
+    int iterations = -1;
     
     img trackedIm = 0; Rectangle trackedRect; float blur = -1.0;
     size_t templateWidth = resizeTexture.size.height, templateHeight = resizeTexture.size.width;  
@@ -480,6 +533,8 @@ static Matrix4 resizeProjection;
     if (prevIm == 0) 
     { 
         prevIm = nextImNorm; 
+        prevImTime = nextImTime;
+        nccTemplateSet = NO;
         
         Rectangle enlargedBox;
         img tempIm =  see_extractWindow(templateWidth, templateHeight, prevIm, templateBox, 
@@ -493,10 +548,46 @@ static Matrix4 resizeProjection;
     }
     else
     {
-              
+        if (prevImTime >= 0 && nextImTime > prevImTime)
+            motion = [self gyroMotionFrom:prevImTime to:nextImTime];
+        
+        // bring large motions into the basin of the LK tracker (motion is kept if the search fails)
+        see_coarseTranslationSearch(templateWidth, templateHeight, prevIm, nextImNorm, templateBox, 
+                                    TEMPLATE_SEARCH_RADIUS, motion, TEMPLATE_SEARCH_SCALE);
+        
         self.trackingStatus = see_FlexibleLKTemplateMatching(templateWidth, templateHeight, prevIm, nextImNorm, templateBox, 
                                                              0.4, motion, 0, 0, TEMPLATE_EPSILON, TEMPLATE_MAX_ITER, 0, 0, 0, 0, 
-                                                             &trackedIm, &trackedRect);
+                                                             &trackedIm, &trackedRect, &iterations);
+        
+        if (self.trackingStatus == TRACKING_OUTSIDEBOUNDS || self.trackingStatus == TRACKING_STOPPEDBYBOUNDS)
+        {
+            // look for the last good template in the whole frame before giving up
+            if (!nccTemplateSet)
+                nccTemplateSet = (see_setNCCTemplate(nccTemplate, templateWidth, templateHeight, prevIm, templateBox) == TRACKING_OK);
+            
+            Rectangle foundBox;
+            if (nccTemplateSet && see_NCCTemplateMatch(nccTemplate, nextImNorm, foundBox, 0, TEMPLATE_REACQUIRE_NCC) == TRACKING_OK)
+            {
+                if (trackedIm != 0) { free(trackedIm); trackedIm = 0; }
+                
+                motion = foundBox.origin - templateBox.origin;
+                Vector2 refined = motion;
+                if (see_FlexibleLKTemplateMatching(templateWidth, templateHeight, prevIm, nextImNorm, templateBox,
+                                                   0.4, refined, 0, 0, TEMPLATE_EPSILON, TEMPLATE_MAX_ITER, 0, 0, 0, 0,
+                                                   &trackedIm, &trackedRect, &iterations) == TRACKING_OK)
+                    motion = refined;
+                else
+                {
+                    // keep the NCC match, log the refinement as failed and measure blur on the NCC box
+                    iterations = -1;
+                    if (trackedIm != 0) free(trackedIm);
+                    trackedIm = see_extractWindow(templateWidth, templateHeight, nextImNorm, foundBox,
+                                                  floor(FSIZE_GAUSDERIV7/2), &trackedRect);
+                }
+
+                self.trackingStatus = TRACKING_OK;
+            }
+        }
         
         if (self.trackingStatus != TRACKING_OK)
         {
@@ -534,6 +625,8 @@ static Matrix4 resizeProjection;
             
             free(prevIm);
             prevIm = nextImNorm;
+            prevImTime = nextImTime;
+            nccTemplateSet = NO;
         }
         
         if (trackedIm != 0)
@@ -546,6 +639,8 @@ static Matrix4 resizeProjection;
         
     }
     
+    self.trackingIterations = iterations;
+    
     return Vector3(motion.x, motion.y, blur);
 }
 
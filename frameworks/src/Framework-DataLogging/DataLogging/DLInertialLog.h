@@ -42,7 +42,8 @@
 /**
     Inertial data logger
     Takes advange of a motion manager to push out inertial measurements and save them into a log file.
-    Last measurement data can be retrieved from the log.
+    Last measurement data can be retrieved from the log, and gyro measurements can be forwarded
+    as they arrive through <a>gyroObserver</a> (e.g. to predict image motion).
  */
 @interface DLInertialLog : DLLog
 {
@@ -65,6 +66,7 @@
 @property (atomic, assign) CMAcceleration latestAccel;              //!< latest accel measurement
 //@property (atomic, assign) Vector3 latestSmoothedAccel;             //!< latest smoothed acceleration (~gravity)
 @property (atomic, assign) CMRotationRate latestGyro;               //!< latest gyro measurement
+@property (atomic, copy) void (^gyroObserver)(CMGyroData *gyroData); //!< called with every gyro measurement (on the gyro queue)
 
 -(id) initWithAccelFile:(NSString *)aName GyroFile:(NSString *)gName motionManager:(CMMotionManager*)motionManager;
 -(void) close;
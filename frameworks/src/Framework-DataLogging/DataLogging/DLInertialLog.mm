@@ -47,6 +47,7 @@
 @synthesize latestAccel;
 //@synthesize latestSmoothedAccel;
 @synthesize latestGyro;
+@synthesize gyroObserver;
 
 /**
     Init with file names and motion manager
@@ -125,6 +126,8 @@
  */
 -(void) close
 {
+    self.gyroObserver = nil;
+    
     if ([self.sharedMotionManager isAccelerometerActive])
         [self.sharedMotionManager stopAccelerometerUpdates];
     
@@ -199,6 +202,8 @@
     }
     
     CMRotationRate gyro = gyroData.rotationRate; self.latestGyro = gyro;
+    void (^observer)(CMGyroData *) = self.gyroObserver;
+    if (observer) observer(gyroData);
     NSTimeInterval timestamp = gyroData.timestamp;
     NSString *str = [NSString stringWithFormat:@"%f %f %f %f\n", timestamp, gyro.x, gyro.y, gyro.z];
     return [DLLog appendString:str encoding:NSUTF8StringEncoding fileHandle:self.gyroFileHandle];
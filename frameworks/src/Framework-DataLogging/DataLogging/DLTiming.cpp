@@ -43,10 +43,16 @@ double machTimeFreqNanoSec = 0.0;
  */
 void initMachTime()
 {
+#ifdef __APPLE__
     struct mach_timebase_info machTimeBaseInfo; 
     mach_timebase_info(&machTimeBaseInfo);   
     machTimeBaseNum = machTimeBaseInfo.numer;
     machTimeBaseDenom = machTimeBaseInfo.denom;
+#else
+    // clock_gettime already counts nanoseconds
+    machTimeBaseNum = 1;
+    machTimeBaseDenom = 1;
+#endif
     machTimeFreqNanoSec = ((double)machTimeBaseNum) / ((double)machTimeBaseDenom);
 //    machTimeFreqSec = machTimeFreqNanoSec * NANOS_IN_SEC;
 }
@@ -65,7 +71,13 @@ bool isMachTimeValid(){
  */
 double tic()
 {
+#ifdef __APPLE__
     uint64_t absoluteTime = mach_absolute_time();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    uint64_t absoluteTime = (uint64_t)ts.tv_sec*1000000000ull + ts.tv_nsec;
+#endif
     return ((double)absoluteTime * machTimeFreqNanoSec);
 }
 
@@ -38,7 +38,13 @@
 extern "C" {
 #endif
 
+#ifdef __APPLE__
     #include <mach/mach_time.h>
+#else
+    #include <stdint.h>
+    #include <stdio.h>
+    #include <time.h>
+#endif
         
     #define NANOS_IN_SEC    1000000000.0        //!< nanoseconds in a second
     #define NANOS_IN_MS     1000000.0           //!< nanoseconds in a milisecond
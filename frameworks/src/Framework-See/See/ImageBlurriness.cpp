@@ -31,137 +31,328 @@
 //	THE SOFTWARE.
 
 #include "ImageBlurriness.h"
+#include "SeeSIMD.h"
+#include <assert.h>
 #include <math.h>
 
+#define SEE_BLUR_STACK_WIDTH 256    //!< widest image whose scratch rows fit on the stack
+
+/*! Row <a>r</a> clamped to the image (borders are replicated) */
+static inline const float *see_blurRow(const float *image, long r, size_t height, size_t stride)
+{
+    if (r < 0) r = 0;
+    else if (r >= (long)height) r = height - 1;
+    return image + r*stride;
+}
+
+/** Blur a row horizontally, replicating its first and last pixels
+    \param row image row
+    \param width row width
+    \param filter blur filter
+    \param lenFilter filter length
+    \param out blurred row (<a>width</a> elements)
+ */
+static void see_blurRowHor(const float *row, size_t width, const float *filter, size_t lenFilter, float *out)
+{
+    long margin = lenFilter/2, w = width;
+    long c0 = (margin < w ? margin : w), c1 = w - (long)(lenFilter - 1 - margin);
+    if (c1 < c0) c1 = c0;
+    
+    // borders
+    for (long c=0; c<w; c++)
+    {
+        if (c == c0) c = c1;
+        if (c >= w) break;
+        float s = 0.0f;
+        for (long k=0; k<(long)lenFilter; k++)
+        {
+            long x = c + k - margin;
+            x = (x < 0 ? 0 : (x >= w ? w - 1 : x));
+            s += filter[lenFilter - 1 - k]*row[x];
+        }
+        out[c] = s;
+    }
+    
+    // interior (no clamping needed)
+    long c = c0;
+    for (; c + SEE_VWIDTH <= c1; c += SEE_VWIDTH)
+    {
+        vfloat s = vf_set(0.0f);
+        for (long k=0; k<(long)lenFilter; k++)
+            s = vf_add(s, vf_mul(vf_set(filter[lenFilter - 1 - k]), vf_load(row + c + k - margin)));
+        vf_store(out + c, s);
+    }
+    for (; c < c1; c++)
+    {
+        float s = 0.0f;
+        for (long k=0; k<(long)lenFilter; k++) s += filter[lenFilter - 1 - k]*row[c + k - margin];
+        out[c] = s;
+    }
+}
+
+/*! Blur row <a>r</a> vertically, replicating the first and last rows */
+static void see_blurRowVer(const float *image, size_t width, size_t height, size_t stride, long r, 
+                           const float *filter, size_t lenFilter, float *out)
+{
+    long margin = lenFilter/2;
+    size_t c = 0;
+    for (; c + SEE_VWIDTH <= width; c += SEE_VWIDTH)
+    {
+        vfloat s = vf_set(0.0f);
+        for (long k=0; k<(long)lenFilter; k++)
+        {
+            const float *row = see_blurRow(image, r + k - margin, height, stride);
+            s = vf_add(s, vf_mul(vf_set(filter[lenFilter - 1 - k]), vf_load(row + c)));
+        }
+        vf_store(out + c, s);
+    }
+    for (; c < width; c++)
+    {
+        float s = 0.0f;
+        for (long k=0; k<(long)lenFilter; k++) 
+            s += filter[lenFilter - 1 - k]*see_blurRow(image, r + k - margin, height, stride)[c];
+        out[c] = s;
+    }
+}
+
+/** Accumulate absolute differences between consecutive samples, before and after blurring
+    \param a0 first samples
+    \param a1 next samples
+    \param b0 first blurred samples
+    \param b1 next blurred samples
+    \param n number of differences
+    \param sumDiff sum of |a1 - a0|
+    \param sumVariation sum of max(|a1 - a0| - |b1 - b0|, 0) (variation that decreased after blurring)
+ */
+static inline void see_blurVariation(const float *a0, const float *a1, const float *b0, const float *b1, size_t n, 
+                                     double &sumDiff, double &sumVariation)
+{
+    size_t i = 0;
+    float d = 0.0f, v = 0.0f;
+    vfloat accD = vf_set(0.0f), accV = vf_set(0.0f), zero = vf_set(0.0f);
+    for (; i + SEE_VWIDTH <= n; i += SEE_VWIDTH)
+    {
+        vfloat di = vf_abs(vf_sub(vf_load(a1 + i), vf_load(a0 + i)));
+        vfloat bi = vf_abs(vf_sub(vf_load(b1 + i), vf_load(b0 + i)));
+        accD = vf_add(accD, di);
+        accV = vf_add(accV, vf_max(vf_sub(di, bi), zero));
+    }
+    d = vf_hsum(accD); v = vf_hsum(accV);
+    for (; i < n; i++)
+    {
+        float di = fabsf(a1[i] - a0[i]), bi = fabsf(b1[i] - b0[i]);
+        d += di;
+        v += (di > bi ? di - bi : 0.0f);
+    }
+    sumDiff += d;
+    sumVariation += v;
+}
+
 /**
     Blur metric for gray image
     \param image grayscale image
     \param width image width
     \param height image height
-    \param bytesperrow bytes per row in the image
+    \param bytesPerRow elements per row in the image (0 if equal to <a>width</a>)
     \param filter blur/averaging filter
     \param lenFilter filter length
+    \param buffer scratch of see_blurMetricBufferSize floats (if NULL, the stack is used for images up to 
+    SEE_BLUR_STACK_WIDTH pixels wide and the heap for wider ones)
     \return blur metric evaluation
  
     Follows the method of F. Cretea, T. Dolmierea, P. Ladreta, M. Nicolas. The Blur Effect: 
     Perception and Estimation with a New No-Reference Perceptual Blur Metric. Proceedings 
     of SPIE. 2007
+ 
+    The image is streamed one row at a time: only the horizontally blurred row and two 
+    vertically blurred rows are kept, and the four sums of differences are accumulated as 
+    soon as the rows are available. Borders are replicated before blurring.
  */
 float perceptualBlurMetric(const img image, size_t width, size_t height, size_t bytesPerRow, 
-                           const float *filter, size_t lenFilter, img *blurredH, img *blurredV,
-                           img *variationH, img *variationV)
+                           const float *filter, size_t lenFilter, float *buffer)
 {
-    unsigned int margin = floor(lenFilter/2);
-
-    size_t extendedW, extendedH;
-    img extendedImage = see_addMargin(width, height, image, margin, &extendedW, &extendedH);
-    
-    // replicate borders
-    for (int m=0; m<margin; m++)
-    {
-        // copy top and bottom borders
-        cblas_scopy((int)width, image, 1, extendedImage + margin + m*extendedW, 1);
-        cblas_scopy((int)width, image + (height - 1)*width, 1, extendedImage + margin + (m + margin + height)*extendedW, 1);
-        // copy left and right borders
-        cblas_scopy((int)height, image, (int)width, extendedImage + margin*extendedW + m, (int)extendedW);
-        cblas_scopy((int)height, image + width - 1, (int)width, extendedImage + margin + width + margin*extendedW + m, (int)extendedW);
-    }
+    size_t stride = (bytesPerRow ? bytesPerRow : width);
+    float local[see_blurMetricBufferSize(SEE_BLUR_STACK_WIDTH)];
+    bool own = (buffer == NULL && width > SEE_BLUR_STACK_WIDTH);
+    if (own) buffer = (float *)malloc(see_blurMetricBufferSize(width)*sizeof(float));
+    else if (buffer == NULL) buffer = local;
+    float *blurredHor = buffer, *blurredVer = buffer + width, *blurredVerNext = buffer + 2*width;
     
-    // blur image
-    Vector2 blurredHorSize, blurredVerSize;
-    img blurredHor = see_convolveHor(extendedImage, extendedW, extendedH, 0, 
-                                     filter, lenFilter, &blurredHorSize, 0 /* margin */);
-    img blurredVer = see_convolveVer(extendedImage, extendedW, extendedH, 0, 
-                                     filter, lenFilter, &blurredVerSize, 0 /* margin */);
-    assert(blurredHorSize.x == width && blurredVerSize.y == height);
+    double sumDiffImageHor = 0, sumDiffImageVer = 0;
+    double sumVariationHor = 0, sumVariationVer = 0;
     
-    free(extendedImage);
+    if (height > 0)
+        see_blurRowVer(image, width, height, stride, 0, filter, lenFilter, blurredVer);
     
-    // compute image differences
-    // note: vDSP_vsub(A, i, B, j, C, k, ...) yields C = B - A.
-    size_t diffHorLength = (width-1)*height;
-    size_t diffVerLength = width*(height-1);
-    img diffImageHor = (float *)malloc(diffHorLength*sizeof(float));
-    img diffImageVer = (float *)malloc(diffVerLength*sizeof(float));
-    img diffBlurredHor = (float *)malloc(diffHorLength*sizeof(float));
-    img diffBlurredVer = (float *)malloc(diffVerLength*sizeof(float));
+    for (size_t r=0; r<height; r++)
+    {
+        const float *row = image + r*stride;
+        
+        // horizontal differences of row r
+        if (width > 1)
+        {
+            see_blurRowHor(row, width, filter, lenFilter, blurredHor);
+            see_blurVariation(row, row + 1, blurredHor, blurredHor + 1, width - 1, 
+                              sumDiffImageHor, sumVariationHor);
+        }
+        
+        // vertical differences between rows r and r + 1
+        if (r + 1 < height)
+        {
+            see_blurRowVer(image, width, height, stride, r + 1, filter, lenFilter, blurredVerNext);
+            see_blurVariation(row, row + stride, blurredVer, blurredVerNext, width, 
+                              sumDiffImageVer, sumVariationVer);
+            
+            float *tmp = blurredVer; blurredVer = blurredVerNext; blurredVerNext = tmp;
+        }
+    }
     
-    vDSP_vsub(image + width, 1, image, 1, diffImageVer, 1, diffVerLength);
+    if (own) free(buffer);
     
-    for (int c=0; c < width-1; c++) {
-        vDSP_vsub(image + 1 + c, width, image + c, width, diffImageHor + c, width - 1, height);
-    }
+    // normalize results
+    float blurHor = (sumDiffImageHor - sumVariationHor)/sumDiffImageHor;
+    float blurVer = (sumDiffImageVer - sumVariationVer)/sumDiffImageVer;
+        
+    // select blur as the more anoying normalized sum of differences
+    return (blurHor > blurVer ? blurHor : blurVer);
+}
+
+#pragma mark Integer images
+
+/*
+    With an (unnormalized) box filter of L taps, the difference between consecutive box sums 
+    is the difference between the pixels entering and leaving the box: S(c+1) - S(c) = 
+    I(c+L-m) - I(c-m), with m = L/2 and borders replicated. Differences of the image are scaled
+    by L instead of normalizing the filter, which leaves the metric unchanged. No blurred rows 
+    are needed.
+ */
 
-    for (int r=0; r < height - 1; r++) {
-        vDSP_vsub(blurredVer + (r + 1)*extendedW + margin, 1, blurredVer + r*extendedW + margin, 1, 
-                  diffBlurredVer + r*width, 1, width);
+/*! Column <a>c</a> clamped to a row of <a>width</a> pixels */
+static inline long see_blurCol(long c, long width)
+{
+    return (c < 0 ? 0 : (c >= width ? width - 1 : c));
+}
+
+/*! Differences and variations of 8-bit pixels (SIMD, saturating) */
+static inline void see_blurVariationInt(const unsigned char *a0, const unsigned char *a1, 
+                                        const unsigned char *b0, const unsigned char *b1, size_t n, 
+                                        size_t lenBox, unsigned long long &sumDiff, unsigned long long &sumVariation)
+{
+    // chunks keep the 32-bit partial sums from overflowing
+    for (size_t i=0; i<n; i+=32768)
+    {
+        size_t m = (n - i < 32768 ? n - i : 32768);
+        vu8_blur_variation(a0 + i, a1 + i, b0 + i, b1 + i, m, (unsigned short)lenBox, &sumDiff, &sumVariation);
     }
-    
-    for (int r=0; r < height; r++) {
-        vDSP_vsub(blurredHor + (r + margin)*width + 1, 1, blurredHor + (r + margin)*width, 1, 
-                  diffBlurredHor + r*(width-1), 1, width-1);
+}
+
+/*! Differences and variations of 16-bit pixels */
+static inline void see_blurVariationInt(const unsigned short *a0, const unsigned short *a1, 
+                                        const unsigned short *b0, const unsigned short *b1, size_t n, 
+                                        size_t lenBox, unsigned long long &sumDiff, unsigned long long &sumVariation)
+{
+    unsigned long long sd = 0, sv = 0;
+    for (size_t i=0; i<n; i++)
+    {
+        unsigned int d = (unsigned int)lenBox*(a1[i] > a0[i] ? a1[i] - a0[i] : a0[i] - a1[i]);
+        unsigned int e = (b1[i] > b0[i] ? b1[i] - b0[i] : b0[i] - b1[i]);
+        sd += d;
+        sv += (d > e ? d - e : 0);
     }
-        
-    if (blurredH == 0) free(blurredHor); 
-    else *blurredH = blurredHor;
-    if (blurredV == 0) free(blurredVer);
-    else *blurredV = blurredVer;
-        
-    // compute abs of differences
-    vDSP_vabs(diffImageHor, 1, diffImageHor, 1, diffHorLength);
-    vDSP_vabs(diffImageVer, 1, diffImageVer, 1, diffVerLength);
-    vDSP_vabs(diffBlurredHor, 1, diffBlurredHor, 1, diffHorLength);
-    vDSP_vabs(diffBlurredVer, 1, diffBlurredVer, 1, diffVerLength);
-    
-    // compute image variation after blurring and threshold at zero
-    // this way we keep only differences that have decreased
-    img variationHor = (float *)malloc(diffHorLength*sizeof(float));
-    img variationVer = (float *)malloc(diffVerLength*sizeof(float));
-    
-    vDSP_vsub(diffBlurredHor, 1, diffImageHor, 1, variationHor, 1, diffHorLength);
-    vDSP_vsub(diffBlurredVer, 1, diffImageVer, 1, variationVer, 1, diffVerLength);
+    sumDiff += sd;
+    sumVariation += sv;
+}
+
+/** Blur metric for integer gray images, with a box filter
+    \param image grayscale image
+    \param width image width
+    \param height image height
+    \param stride elements per row in the image
+    \param lenBox box filter length
+ 
+    Same method as perceptualBlurMetric (see the note above on box filters).
+ */
+template <typename T>
+static float see_blurMetricInt(const T *image, size_t width, size_t height, size_t stride, size_t lenBox)
+{
+    assert(lenBox > 0);
     
-    float lowerThresh = 0.0;
-    vDSP_vthres(variationHor, 1, &lowerThresh, variationHor, 1, diffHorLength);
-    vDSP_vthres(variationVer, 1, &lowerThresh, variationVer, 1, diffVerLength);
+    unsigned long long sumDiffImageHor = 0, sumDiffImageVer = 0;
+    unsigned long long sumVariationHor = 0, sumVariationVer = 0;
+    long margin = lenBox/2, w = width, h = height, L = lenBox;
     
-    free(diffBlurredHor); free(diffBlurredVer);
-
-    // compute sum of coefficients (need to loop because of the border)
-    float sumDiffImageHor = 0, sumDiffImageVer = 0; 
-    float sumVariationHor = 0, sumVariationVer = 0;
-    float tmp;
+    // columns whose box differences need no clamping
+    long c0 = (margin < w - 1 ? margin : w - 1), c1 = w - L + margin;
+    if (c1 > w - 1) c1 = w - 1;
+    if (c1 < c0) c1 = c0;
     
-    for (int r=0; r<height-1; r++)
-    { // size might be wrong here!
-        tmp = 0; 
-        vDSP_sve(diffImageHor + (width - 1)*r, 1, &tmp, width - 1); 
-        sumDiffImageHor += tmp;
-        
-        tmp = 0; 
-        vDSP_sve(diffImageVer + width*r, 1, &tmp, width - 1); 
-        sumDiffImageVer += tmp;
+    for (long r=0; r<h; r++)
+    {
+        const T *row = image + r*stride;
         
-        tmp = 0; 
-        vDSP_sve(variationHor + (width - 1)*r, 1, &tmp, width - 1); 
-        sumVariationHor += tmp;
+        // horizontal differences of row r
+        for (long c=0; c<w-1; c++)
+        {
+            if (c == c0)
+            {
+                see_blurVariationInt(row + c0, row + c0 + 1, row + c0 - margin, row + c0 + L - margin, 
+                                     c1 - c0, lenBox, sumDiffImageHor, sumVariationHor);
+                c = c1;
+                if (c >= w - 1) break;
+            }
+            T b0 = row[see_blurCol(c - margin, w)], b1 = row[see_blurCol(c + L - margin, w)];
+            see_blurVariationInt(row + c, row + c + 1, &b0, &b1, 1, lenBox, sumDiffImageHor, sumVariationHor);
+        }
         
-        tmp = 0; 
-        vDSP_sve(variationVer + width*r, 1, &tmp, width - 1); 
-        sumVariationVer += tmp;
+        // vertical differences between rows r and r + 1
+        if (r + 1 < h)
+        {
+            const T *out = image + see_blurCol(r - margin, h)*stride;
+            const T *in = image + see_blurCol(r + L - margin, h)*stride;
+            see_blurVariationInt(row, row + stride, out, in, width, lenBox, sumDiffImageVer, sumVariationVer);
+        }
     }
-        
-    free(diffImageHor); free(diffImageVer);
     
-    if (variationH == 0) free(variationHor); 
-    else *variationH = variationHor;
-    if (variationV == 0) free(variationVer); 
-    else *variationV = variationVer;
+    float blurHor = (double)(sumDiffImageHor - sumVariationHor)/sumDiffImageHor;
+    float blurVer = (double)(sumDiffImageVer - sumVariationVer)/sumDiffImageVer;
     
-    // normalize results
-    float blurHor = (sumDiffImageHor - sumVariationHor)/sumDiffImageHor;
-    float blurVer = (sumDiffImageVer - sumVariationVer)/sumDiffImageVer;
-        
-    // select blur as the more anoying normalized sum of differences
     return (blurHor > blurVer ? blurHor : blurVer);
 }
+
+/**
+    Blur metric for 8-bit gray image (e.g., camera luma)
+    \param image grayscale image
+    \param width image width
+    \param height image height
+    \param bytesPerRow bytes per row in the image (0 if equal to <a>width</a>)
+    \param lenBox box filter length (at most 257)
+    \return blur metric evaluation
+ 
+    Integer version of perceptualBlurMetric with an averaging filter of <a>lenBox</a> taps 
+    (e.g., FSIZE_AVERAGE3). The image does not need to be normalized, and no scratch is needed:
+    differences are accumulated in 16-bit lanes with SIMD saturating arithmetic.
+ */
+float perceptualBlurMetricU8(const unsigned char *image, size_t width, size_t height, size_t bytesPerRow, 
+                             size_t lenBox)
+{
+    assert(lenBox*255 <= 65535);
+    return see_blurMetricInt(image, width, height, (bytesPerRow ? bytesPerRow : width), lenBox);
+}
+
+/**
+    Blur metric for 16-bit gray image
+    \param image grayscale image
+    \param width image width
+    \param height image height
+    \param bytesPerRow elements per row in the image (0 if equal to <a>width</a>)
+    \param lenBox box filter length
+    \return blur metric evaluation
+ 
+    Same as perceptualBlurMetricU8, with 32-bit differences.
+ */
+float perceptualBlurMetricU16(const unsigned short *image, size_t width, size_t height, size_t bytesPerRow, 
+                              size_t lenBox)
+{
+    assert(lenBox*65535ULL <= 0xffffffffULL);
+    return see_blurMetricInt(image, width, height, (bytesPerRow ? bytesPerRow : width), lenBox);
+}
@@ -46,9 +46,16 @@ extern "C" {
         return (3.79/(1+exp(10.72*blurValue - 4.55))) + 1.13;
     }
     
+    /*! Scratch floats needed by perceptualBlurMetric (image width in pixels) */
+#define see_blurMetricBufferSize(width) (3*(width))
+    
     float perceptualBlurMetric(const img image, size_t width, size_t height, 
-                               size_t bytesPerRow, const float *filter, size_t lenFilter, img *blurredH = 0, img *blurredV = 0, 
-                               img *variationH = 0, img *variationV = 0);
+                               size_t bytesPerRow, const float *filter, size_t lenFilter, float *buffer = 0);
+    
+    float perceptualBlurMetricU8(const unsigned char *image, size_t width, size_t height, size_t bytesPerRow, 
+                                 size_t lenBox);
+    float perceptualBlurMetricU16(const unsigned short *image, size_t width, size_t height, size_t bytesPerRow, 
+                                  size_t lenBox);
     
 #if __cplusplus
 }
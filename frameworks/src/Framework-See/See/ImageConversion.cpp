@@ -31,7 +31,10 @@
 //	THE SOFTWARE.
 
 #import "ImageConversion.h"
+#import "SeeSIMD.h"
 #import <iostream>
+#include <math.h>
+#include <string.h>
 
 #pragma mark BASIC IMAGE CONVERSION
 
@@ -47,14 +50,14 @@ img see_scaleToAndCopy(img &image, size_t size, float maxVal, int32_t stride)
     img scaled = (float *)malloc(sizeof(float)*size);
     
     float maximum = 0.0, minimum = 0.0;
-    vDSP_minv(image, stride, &minimum, size);
-    vDSP_maxv(image, stride, &maximum, size);
+    see_minv(image, stride, &minimum, size);
+    see_maxv(image, stride, &maximum, size);
     
     //NSLog(@"max = %.2f | min = %.2f", maximum, minimum);
     minimum = -minimum;
     float r = maxVal/(maximum + minimum);
-    vDSP_vsadd(image, stride, &minimum, scaled, stride, size);
-    vDSP_vsmul(scaled, stride, &r, scaled, stride, size);
+    see_vsadd(image, stride, &minimum, scaled, stride, size);
+    see_vsmul(scaled, stride, &r, scaled, stride, size);
     
     return scaled;
 }
@@ -74,21 +77,21 @@ void see_decomposeRGBA(const unsigned char *array, size_t size,
 	if (red)
 	{
 		img r = (float*)malloc(size*sizeof(float));
-		vDSP_vfltu8((unsigned char*)array,4,r,1,size);
+		see_vfltu8((unsigned char*)array,4,r,1,size);
 		*red = r;
 	}
 	
 	if (green)
 	{
 		img g = (float*)malloc(size*sizeof(float));
-		vDSP_vfltu8((unsigned char*)array+1,4,g,1,size);
+		see_vfltu8((unsigned char*)array+1,4,g,1,size);
 		*green = g;
 	}
 			  
 	if (blue)
 	{
 		img b = (float*)malloc(size*sizeof(float));
-		vDSP_vfltu8((unsigned char*)array+2,4,b,1,size);
+		see_vfltu8((unsigned char*)array+2,4,b,1,size);
 		*blue = b;
 	}
 }
@@ -108,21 +111,21 @@ void see_decomposeBGRA(const unsigned char *array, size_t size,
 	if (red != 0 || red != NULL)
 	{
 		img r = (float*)malloc(size*sizeof(float));
-		vDSP_vfltu8((unsigned char*)array+2,4,r,1,size);
+		see_vfltu8((unsigned char*)array+2,4,r,1,size);
 		*red = r;
 	}
 	
 	if (green != 0 || green != NULL)
 	{
 		img g = (float*)malloc(size*sizeof(float));
-		vDSP_vfltu8((unsigned char*)array+1,4,g,1,size);
+		see_vfltu8((unsigned char*)array+1,4,g,1,size);
 		*green = g;
 	}
     
 	if (blue != 0 || blue != NULL)
 	{
 		img b = (float*)malloc(size*sizeof(float));
-		vDSP_vfltu8((unsigned char*)array,4,b,1,size);
+		see_vfltu8((unsigned char*)array,4,b,1,size);
 		*blue = b;
 	}
 }
@@ -138,10 +141,10 @@ void see_decomposeBGRA(const unsigned char *array, size_t size,
 img see_intensity(const img r, const img g, const img b, size_t size)
 {
 	float *intensity = (float*)calloc(size,sizeof(float));
-	vDSP_vadd(r,1,g,1,intensity,1,size);
-	vDSP_vadd(intensity,1,b,1,intensity,1,size);
+	see_vadd(r,1,g,1,intensity,1,size);
+	see_vadd(intensity,1,b,1,intensity,1,size);
 	// use mean(r,g,b)
-	cblas_sscal((int)size, 1.0/3.0, intensity, 1);
+	see_sscal((int)size, 1.0/3.0, intensity, 1);
 	return intensity;
 }
 
@@ -159,15 +162,15 @@ void see_opponency(const img r, const img g, const img b, size_t size, img *rg,
 	
 	// find max(b,max(r,g)) 
 	float *ma = (float *)malloc(size*sizeof(float));
-	vDSP_vmax(r,1,g,1,ma,1,size);
-	vDSP_vmax(ma,1,b,1,ma,1,size);
+	see_vmax(r,1,g,1,ma,1,size);
+	see_vmax(ma,1,b,1,ma,1,size);
 
-    // vDSP_vsub(A, i, B, j, C, k, ...) yields C = B - A.
+    // see_vsub(A, i, B, j, C, k, ...) yields C = B - A.
     
 	if (rg) // red-green
 	{
 		*rg = (float *)malloc(size*sizeof(float));
-		vDSP_vsub(g, 1, r, 1, *rg, 1, size);
+		see_vsub(g, 1, r, 1, *rg, 1, size);
 	}
 	
 	if (by) // blue-yellow
@@ -175,8 +178,8 @@ void see_opponency(const img r, const img g, const img b, size_t size, img *rg,
 		*by = (float *)malloc(size*sizeof(float));
 		// find min(r,g) 
 		float *mi = (float *)malloc(size*sizeof(float));
-		vDSP_vmin(r, 1, g, 1, mi, 1, size);
-		vDSP_vsub(mi, 1, b, 1, *by, 1, size);
+		see_vmin(r, 1, g, 1, mi, 1, size);
+		see_vsub(mi, 1, b, 1, *by, 1, size);
 		free(mi);
 	}
 	
@@ -199,6 +202,54 @@ void see_opponency(const img r, const img g, const img b, size_t size, img *rg,
 	free(ma);
 }
 
+/*! Compute intensity and color opponency features straight from BGRA data
+    \param array image (BGRA)
+    \param width image width
+    \param height image height
+    \param bytesPerRow bytes from the start of one row of <a>array</a> to the next
+    \param featInt intensity (width*height floats)
+    \param featRG red-green opponency (width*height floats)
+    \param featBY blue-yellow opponency (width*height floats)
+ 
+    Single pass equivalent of see_decompose, see_intensity and see_opponency: every pixel is 
+    read once and converted in registers, and nothing is allocated. As in see_opponency, both 
+    opponencies are set to zero where max(r,g,b) < 25.5.
+ */
+void see_featuresBGRA(const unsigned char *array, size_t width, size_t height, size_t bytesPerRow,
+                      img featInt, img featRG, img featBY)
+{
+    assert(array != 0 && featInt != 0 && featRG != 0 && featBY != 0 && bytesPerRow >= 4*width);
+    
+    const float third = 1.0/3.0;                            //!< same factor see_intensity scales by
+    const float dark = 25.5;                                //!< low luminance cutoff
+    const vfloat vthird = vf_set(third), vdark = vf_set(dark);
+    
+    for (size_t row=0; row<height; row++)
+    {
+        const unsigned char *src = array + row*bytesPerRow;
+        float *in = featInt + row*width, *rg = featRG + row*width, *by = featBY + row*width;
+        
+        size_t col = 0;
+        for (; col + SEE_VWIDTH <= width; col += SEE_VWIDTH)
+        {
+            vfloat b, g, r;
+            vf_load_bgra(src + 4*col, &b, &g, &r);
+            vfloat ma = vf_max(vf_max(r, g), b);
+            vf_store(in + col, vf_mul(vf_add(vf_add(r, g), b), vthird));
+            vf_store(rg + col, vf_mask_ge(vf_div(vf_sub(r, g), ma), ma, vdark));
+            vf_store(by + col, vf_mask_ge(vf_div(vf_sub(b, vf_min(r, g)), ma), ma, vdark));
+        }
+        for (; col < width; col++)
+        {
+            float b = src[4*col], g = src[4*col+1], r = src[4*col+2];
+            float ma = fmaxf(fmaxf(r, g), b);
+            in[col] = ((r + g) + b)*third;
+            rg[col] = (ma < dark ? 0.0f : (r - g)/ma);
+            by[col] = (ma < dark ? 0.0f : (b - fminf(r, g))/ma);
+        }
+    }
+}
+
 /*! Enlarge image by (integer) factor using bilinear interpolation
 	\param desiredw desired width
 	\param desuredh desired height
@@ -235,31 +286,31 @@ img see_enlargeWithDim(size_t desiredw, size_t desiredh,
 
 	float initval = 0;
 	float increment = 1.0f/factor;
-	vDSP_vramp(&initval, &increment, ramph, 1, w);
-	vDSP_vramp(&initval, &increment, rampv, 1, h);
+	see_vramp(&initval, &increment, ramph, 1, w);
+	see_vramp(&initval, &increment, rampv, 1, h);
 	
 	if (pixelate)
 	{
 		int *rampih = (int*)malloc(w*sizeof(int));
 		int *rampiv = (int*)malloc(h*sizeof(int));
-		vDSP_vfix32(ramph, 1, rampih, 1, w);
-		vDSP_vfix32(rampv, 1, rampiv, 1, h);
-		vDSP_vflt32(rampih, 1, ramph, 1, w);
-		vDSP_vflt32(rampiv, 1, rampv, 1, h);
+		see_vfix32(ramph, 1, rampih, 1, w);
+		see_vfix32(rampv, 1, rampiv, 1, h);
+		see_vflt32(rampih, 1, ramph, 1, w);
+		see_vflt32(rampiv, 1, rampv, 1, h);
 		free(rampih); free(rampiv);
 	}
     
 	// horizontal interpolation
 	for ( int row = 0; row < height; row++ )
 	{
-		vDSP_vlint(image + (row*width), ramph, 1, 
+		see_vlint(image + (row*width), ramph, 1, 
 				   tmp + row, height, w, width);
 	}
 	
 	// vertical interpolation
 	for ( int col = 0; col < w; col++ ) 
 	{
-		vDSP_vlint(tmp + col*height, rampv, 1, 
+		see_vlint(tmp + col*height, rampv, 1, 
 				   enlarged + (col+extraL) + (extraT*desiredw), 
 				   desiredw, h, height);
 	}
@@ -270,9 +321,9 @@ img see_enlargeWithDim(size_t desiredw, size_t desiredh,
 	for ( int e = 0; e < extraB; e++ ) // top-bottom
 	{
 		if (e < extraT)
-			cblas_scopy(w,addrtop, 1,
+			see_scopy(w,addrtop, 1,
 						enlarged + (e*desiredw) + extraL, 1);
-		cblas_scopy(w,addrbottom, 1,
+		see_scopy(w,addrbottom, 1,
 					addrbottom + (e+1)*desiredw, 1);
 	}
 	float* addrleft = enlarged + extraL;
@@ -280,9 +331,9 @@ img see_enlargeWithDim(size_t desiredw, size_t desiredh,
 	for ( int e = 0; e < extraR; e++ ) // left-right
 	{
 		if (e < extraL)
-			cblas_scopy(desiredh,addrleft, desiredw,
+			see_scopy(desiredh,addrleft, desiredw,
 						enlarged + e, desiredw);
-		cblas_scopy(desiredh,addrright, desiredw,
+		see_scopy(desiredh,addrright, desiredw,
 					addrright + (e+1), desiredw);
 	}
 		
@@ -302,18 +353,38 @@ img see_enlargeWithDim(size_t desiredw, size_t desiredh,
     \param image input image (single channel)
     \param width <a>image</a> width
     \param height <a>image</a> height
-    \param neww new <a>image</a> width after enlarging
-    \param newh new <a>image</a> height after enlarging
+    \return enlarged image (<a>desiredw</a>*<a>desiredh</a>)
  */
 img see_enlarge(size_t desiredw, size_t desiredh, const img& image, 
                 size_t width, size_t height)
+{
+	img enlarged = (float *)malloc(desiredw*desiredh*sizeof(float));
+	float *buffer = (float *)malloc(see_enlargeBufferSize(desiredw, desiredh, height)*sizeof(float));
+    
+    see_enlargeWithBuffers(desiredw, desiredh, image, width, height, enlarged, buffer);
+    
+	free(buffer);
+    
+	return enlarged;
+}
+
+/*! Enlarge image using bilinear interpolation without allocating memory
+    \param desiredw desired width
+    \param desuredh desired height
+    \param image input image (single channel)
+    \param width <a>image</a> width
+    \param height <a>image</a> height
+    \param enlarged output (<a>desiredw</a>*<a>desiredh</a> floats)
+    \param buffer scratch (see_enlargeBufferSize(<a>desiredw</a>, <a>desiredh</a>, <a>height</a>) floats)
+ */
+void see_enlargeWithBuffers(size_t desiredw, size_t desiredh, const float *image, 
+                            size_t width, size_t height, float *enlarged, float *buffer)
 {
 	assert(desiredw > width && desiredh > height);
 		
-	img enlarged = (float *)malloc(desiredw*desiredh*sizeof(float));
-	img tmp = (float *)malloc(desiredw*height*sizeof(float));
-	float *ramph = (float *)malloc(desiredw*sizeof(float));
-	float *rampv = (float *)malloc(desiredh*sizeof(float));
+	float *tmp = buffer;
+	float *ramph = tmp + desiredw*height;
+	float *rampv = ramph + desiredw;
     
     // set up ramps for interpolation
     // (try to center the enlarged image instead of biasing towards a corner)
@@ -321,28 +392,79 @@ img see_enlarge(size_t desiredw, size_t desiredh, const img& image,
 	float incrementH = (height-1.0)/desiredh;
 	float initvalW = (width - 1.0 - incrementW*(desiredw-1))*0.5; 
 	float initvalH = (height - 1.0 - incrementH*(desiredh-1))*0.5;
-	vDSP_vramp(&initvalW, &incrementW, ramph, 1, desiredw);
-	vDSP_vramp(&initvalH, &incrementH, rampv, 1, desiredh);
+	see_vramp(&initvalW, &incrementW, ramph, 1, desiredw);
+	see_vramp(&initvalH, &incrementH, rampv, 1, desiredh);
     
 	// horizontal interpolation
 	for ( int row = 0; row < height; row++ )
 	{
-		vDSP_vlint(image + (row*width), ramph, 1, 
+		see_vlint(image + (row*width), ramph, 1, 
 				   tmp + row, height, desiredw, width);
 	}
 	
 	// vertical interpolation
 	for ( int row = 0; row < desiredw; row++ ) 
 	{
-		vDSP_vlint(tmp + row*height, rampv, 1, 
+		see_vlint(tmp + row*height, rampv, 1, 
 				   enlarged + row, desiredw, desiredh, height);
 	}
-	
-	free(tmp);
-	free(ramph);
-	free(rampv);
+}
+
+/*! Enlarge a band of rows of an image using bilinear interpolation without allocating memory
+    \param desiredw desired width
+    \param desuredh desired height
+    \param image input image (single channel)
+    \param width <a>image</a> width
+    \param height <a>image</a> height
+    \param row0 first enlarged row to compute
+    \param nrows number of enlarged rows to compute
+    \param enlarged output (<a>nrows</a>*<a>desiredw</a> floats, starting at row <a>row0</a>)
+    \param buffer scratch (see_enlargeRowsBufferSize(<a>desiredw</a>, <a>desiredh</a>, <a>height</a>, <a>nrows</a>) floats)
+ 
+    The rows match the ones computed by see_enlargeWithBuffers. Only the input rows under the band 
+    are interpolated horizontally, so bands of the same image can be enlarged independently.
+ */
+void see_enlargeRows(size_t desiredw, size_t desiredh, const float *image, size_t width, size_t height,
+                     size_t row0, size_t nrows, float *enlarged, float *buffer)
+{
+	assert(desiredw > width && desiredh > height && row0 + nrows <= desiredh);
+    if (nrows == 0) return;
     
-	return enlarged;
+	float *ramph = buffer;
+	float *rampv = ramph + desiredw;
+    float *tmp = rampv + desiredh;
+    
+    // same ramps as see_enlargeWithBuffers
+	float incrementW = (width-1.0)/desiredw; 
+	float incrementH = (height-1.0)/desiredh;
+	float initvalW = (width - 1.0 - incrementW*(desiredw-1))*0.5; 
+	float initvalH = (height - 1.0 - incrementH*(desiredh-1))*0.5;
+	see_vramp(&initvalW, &incrementW, ramph, 1, desiredw);
+	see_vramp(&initvalH, &incrementH, rampv, 1, desiredh);
+    
+    // input rows under the band (plus the next one, which is interpolated with the last)
+    size_t first = (size_t)rampv[row0];
+    size_t last = (size_t)rampv[row0 + nrows - 1] + 1;
+    if (last > height - 1) last = height - 1;
+    size_t n = last - first + 1;
+    
+    // make the vertical ramp relative to the first input row (exact, since both are small integers apart)
+    float shift = -(float)first;
+    see_vsadd(rampv + row0, 1, &shift, rampv + row0, 1, nrows);
+    
+	// horizontal interpolation
+	for ( size_t row = 0; row < n; row++ )
+	{
+		see_vlint(image + (first + row)*width, ramph, 1, 
+				   tmp + row, n, desiredw, width);
+	}
+	
+	// vertical interpolation
+	for ( size_t col = 0; col < desiredw; col++ ) 
+	{
+		see_vlint(tmp + col*n, rampv + row0, 1, 
+				   enlarged + col, desiredw, nrows, n);
+	}
 }
 
 /*! Shrink image to half size (this is equivalent to going from one step in a pyramid to the next)
@@ -374,40 +496,40 @@ img see_shrinkByHalf(const img image, size_t width, size_t height, const float *
     // copy horizontally and extend vertically
     for ( int row=0; row < height; row++ )
     {
-        cblas_scopy(width, image + (row*width), 1, 
+        see_scopy(width, image + (row*width), 1, 
                     signal + ((row+midExtraL)*bytesPerRowSignal) + midExtraL, 1);
         // copy extra pixels to apply the filter properly on the borders
         if (row < midExtraL)
         {
-            cblas_scopy(width, image + ((midExtraL-row)*width), 1, 
+            see_scopy(width, image + ((midExtraL-row)*width), 1, 
                         signal + (row*bytesPerRowSignal) + midExtraL, 1);
-            cblas_scopy(width, image + ((height-midExtraL+row)*width), 1, 
+            see_scopy(width, image + ((height-midExtraL+row)*width), 1, 
                         signal + ((height+extraL-1-row)*bytesPerRowSignal) + midExtraL, 1);
         }
     }
     
     
-    // extend horizontally and filter vertically 
-    for ( int col=0; col < width + midExtraL; col++ )
+    // extend horizontally
+    for ( int col=0; col < midExtraL; col++ )
     {
         // copy extra pixels to apply the filter properly on the borders
-        if (col < midExtraL)
-        {
-            cblas_scopy(height + extraL, signal + (extraL-1-col), bytesPerRowSignal, 
-                        signal + col, bytesPerRowSignal);
-            cblas_scopy(height + extraL, signal + (width-1-col), bytesPerRowSignal, 
-                        signal + (width+midExtraL+col), bytesPerRowSignal);				
-        }
-        
-        // convolve with the filter
-        vDSP_conv(signal + col, bytesPerRowSignal, filteraddr, -1,
-                  auxsig + col + midExtraL, bytesPerRowSignal, height, length);			
+        see_scopy(height + extraL, signal + (extraL-1-col), bytesPerRowSignal, 
+                    signal + col, bytesPerRowSignal);
+        see_scopy(height + extraL, signal + (width-1-col), bytesPerRowSignal, 
+                    signal + (width+midExtraL+col), bytesPerRowSignal);				
     }
     
+    // filter vertically (the whole padded row, the horizontal pass reads up to its last column)
+    const float **rows = (const float**)malloc((height + extraL)*sizeof(float*));
+    for ( int row=0; row < height + extraL; row++ ) rows[row] = signal + row*bytesPerRowSignal;
+    see_convVer(rows, 1, filteraddr, -1, auxsig + midExtraL, bytesPerRowSignal, 
+                bytesPerRowSignal, height, length);
+    free(rows);
+    
     // filter horizontally, set result in auxiliary var
     for ( int row=0; row < height; row++ )
     {
-        vDSP_conv(auxsig + (row*bytesPerRowSignal) + midExtraL, 1, filteraddr, -1,
+        see_conv(auxsig + (row*bytesPerRowSignal) + midExtraL, 1, filteraddr, -1,
                   auxsig + (row*width), 1, width, length);
     }
     
@@ -415,7 +537,7 @@ img see_shrinkByHalf(const img image, size_t width, size_t height, const float *
     // save subsampled image
     for ( int row=0; row < height2; row ++ )
     {
-        cblas_scopy(width2, auxsig + (row*4*width2), 2, 
+        see_scopy(width2, auxsig + (row*4*width2), 2, 
                     tmp + (row*width2), 1);
     }
     
@@ -425,16 +547,184 @@ img see_shrinkByHalf(const img image, size_t width, size_t height, const float *
     return tmp;
 }
 
+#define SEE_SHRINK_FRACBITS 8                               //!< fractional bits of see_shrinkRGBA samples and taps
+#define SEE_SHRINK_ONE ((float)(1 << SEE_SHRINK_FRACBITS))  //!< 1.0 in see_shrinkRGBA fixed point
+#define SEE_SHRINK_MAGIC 12582912.0f                        //!< 1.5*2^23: adding it rounds a float to an integer
+
+/*! Quantize a smoothing filter to SEE_SHRINK_FRACBITS fixed point
+    \param filter filter (non-negative taps)
+    \param length filter length
+    \param taps output taps (<a>length</a> integer values)
+ 
+    Taps are normalized so that they add up exactly to SEE_SHRINK_ONE (the rounding error is 
+    absorbed by the central tap), so flat regions go through the reduction unchanged.
+ */
+static void see_shrinkTaps(const float *filter, size_t length, float *taps)
+{
+    float sum = 0.0;
+    for (size_t j=0; j<length; j++) { assert(filter[j] >= 0.0); sum += filter[j]; }
+    assert(sum > 0.0);
+    
+    float total = 0.0;
+    for (size_t j=0; j<length; j++)
+    {
+        taps[j] = floorf(filter[j]*SEE_SHRINK_ONE/sum + 0.5f);
+        total += taps[j];
+    }
+    taps[length/2] += SEE_SHRINK_ONE - total;
+}
+
+/*! Bring fixed point products back to SEE_SHRINK_FRACBITS: c = round(a/SEE_SHRINK_ONE) (ties to even)
+    \param a sums of products of samples and taps
+    \param c output (may be <a>a</a>)
+    \param n number of elements
+ */
+static void see_shrinkRound(const float *a, float *c, size_t n)
+{
+    vfloat s = vf_set(1.0f/SEE_SHRINK_ONE), m = vf_set(SEE_SHRINK_MAGIC);
+    size_t x = 0;
+    for (; x + SEE_VWIDTH <= n; x += SEE_VWIDTH)
+        vf_store(c + x, vf_sub(vf_add(vf_mul(vf_load(a + x), s), m), m));
+    for (; x < n; x++)
+        c[x] = (a[x]*(1.0f/SEE_SHRINK_ONE) + SEE_SHRINK_MAGIC) - SEE_SHRINK_MAGIC;
+}
+
+/*! Filter a row horizontally and keep its even samples
+    \param row row, with <a>length</a>/2 free elements on each side for the borders
+    \param width row width
+    \param taps fixed point filter
+    \param length filter length
+    \param out <a>width</a>/2 samples
+ */
+static void see_shrinkRow(float *row, size_t width, const float *taps, size_t length, float *out)
+{
+    size_t half = length >> 1;
+    
+    // replicate borders
+    for (size_t j=0; j<half; j++)
+    {
+        row[j] = row[half];
+        row[half + width + j] = row[half + width - 1];
+    }
+    
+    see_desamp(row, 2, taps, out, width >> 1, length);
+}
+
+/*! Reduce BGRA data to half size and split it into fixed point R-G-B planes
+    \param array image (BGRA)
+    \param width image width
+    \param height image height
+    \param bytesPerRow bytes from the start of one row of <a>array</a> to the next
+    \param taps fixed point filter
+    \param length filter length
+    \param rowbuf scratch (3*(<a>width</a> + <a>length</a>) + 3*<a>length</a>*(<a>width</a>/2) floats)
+    \param rgb output R, G and B planes ((<a>width</a>/2)*(<a>height</a>/2) samples each)
+ 
+    Every row of <a>array</a> is converted and filtered horizontally once, when the first output 
+    row that needs it is computed, and kept in a ring of <a>length</a> rows for the vertical pass. 
+    The image is thus read in a single pass and never converted to float at full resolution.
+ */
+static void see_shrinkBGRAFixed(const unsigned char *array, size_t width, size_t height, size_t bytesPerRow,
+                                const float *taps, size_t length, float *rowbuf, float *const rgb[3])
+{
+    size_t half = length >> 1;
+    size_t width2 = width >> 1, height2 = height >> 1;
+    size_t stride = width + length;
+    float *rowR = rowbuf, *rowG = rowR + stride, *rowB = rowG + stride;
+    float *ring = rowB + stride;                            //!< filtered rows (R, G and B for each slot)
+    const float *rows[3][SEE_SHRINK_MAXLENGTH];
+    long next = 0;                                          //!< next row of <a>array</a> to filter
+    
+    for (size_t y=0; y<height2; y++)
+    {
+        for (size_t j=0; j<length; j++)
+        {
+            long row = (long)(2*y + j) - (long)half;
+            if (row < 0) row = 0;
+            else if (row >= (long)height) row = height - 1;
+            
+            float *slot = ring + 3*(row % length)*width2;
+            for (; next <= row; next++)
+            {
+                // horizontal pass (sums of 8-bit samples times taps are exact in float)
+                const unsigned char *p = array + next*bytesPerRow;
+                size_t x = 0;
+                for (; x + SEE_VWIDTH <= width; x += SEE_VWIDTH)
+                {
+                    vfloat pb, pg, pr;
+                    vf_load_bgra(p + 4*x, &pb, &pg, &pr);
+                    vf_store(rowR + half + x, pr);
+                    vf_store(rowG + half + x, pg);
+                    vf_store(rowB + half + x, pb);
+                }
+                for (; x < width; x++)
+                {
+                    rowR[half + x] = p[4*x + 2]; rowG[half + x] = p[4*x + 1]; rowB[half + x] = p[4*x];
+                }
+                
+                float *dst = ring + 3*(next % length)*width2;
+                see_shrinkRow(rowR, width, taps, length, dst);
+                see_shrinkRow(rowG, width, taps, length, dst + width2);
+                see_shrinkRow(rowB, width, taps, length, dst + 2*width2);
+            }
+            
+            for (int c=0; c<3; c++) rows[c][j] = slot + c*width2;
+        }
+        
+        // vertical pass and rounding to SEE_SHRINK_FRACBITS
+        for (int c=0; c<3; c++)
+        {
+            float *out = rgb[c] + y*width2;
+            see_convVer(rows[c], 1, taps, 1, out, 0, width2, 1, length);
+            see_shrinkRound(out, out, width2);
+        }
+    }
+}
+
+/*! Reduce a fixed point plane to half size
+    \param in input plane
+    \param width plane width
+    \param height plane height
+    \param taps fixed point filter
+    \param length filter length
+    \param rowbuf scratch (<a>width</a> + <a>length</a> floats)
+    \param out (<a>width</a>/2)*(<a>height</a>/2) samples
+ */
+static void see_shrinkPlaneFixed(const float *in, size_t width, size_t height,
+                                 const float *taps, size_t length, float *rowbuf, float *out)
+{
+    size_t half = length >> 1;
+    size_t width2 = width >> 1, height2 = height >> 1;
+    const float *rows[SEE_SHRINK_MAXLENGTH];
+    
+    for (size_t y=0; y<height2; y++)
+    {
+        for (size_t j=0; j<length; j++)
+        {
+            long r = (long)(2*y + j) - (long)half;
+            if (r < 0) r = 0;
+            else if (r >= (long)height) r = height - 1;
+            rows[j] = in + r*width;
+        }
+        
+        see_convVer(rows, 1, taps, 1, rowbuf + half, 0, width, 1, length);
+        see_shrinkRound(rowbuf + half, rowbuf + half, width);
+        see_shrinkRow(rowbuf, width, taps, length, out + y*width2);
+        see_shrinkRound(out + y*width2, out + y*width2, width2);
+    }
+}
+
 /*! Shrinks RGBA data array to half size (a number of times) and outputs independent R-G-B results
     \param shrinkingTimes how many times to shrink? (e.g., use 1 to reduce image to half size)
-    \param image data source (single channel)
+    \param array data source (BGRA)
     \param width initial image width (which will be modified to final image width)
     \param height initla image height (which will be modified to final image height)
-    \param filter filter	
-    \param length filter length
+    \param filter filter (non-negative taps)
+    \param length filter length (odd, at most SEE_SHRINK_MAXLENGTH)
     \param r red image (or NULL if undesired)
     \param g green image (or NULL if undesired)
     \param b blue image (or NULL if undesired)
+    \param bytesPerRow bytes per row in <a>array</a> (0 if rows are contiguous)
  
     The parameter <a>shrinkingTimes</a> is equivalent to offset when building pyramids. The image should 
     be shrinked at least once.
@@ -442,50 +732,68 @@ img see_shrinkByHalf(const img image, size_t width, size_t height, const float *
     The output parameters <a>r<a/>, <a>g</a> and <a>b</a> should not be initialized before hand or
     a memory leak will be produced. This function allocates the necessary space for the arrays.
  
+    The first reduction reads the bytes of <a>array</a> directly and every level is computed in 8.8 
+    fixed point, with the filter quantized to 8 bits. All sums are integers below 2^24, so they are 
+    exact in float registers and the result does not depend on the vector backend. As in see_pyramid, 
+    output pixel (x,y) is centered on pixel (2x,2y) of the previous level and borders are replicated. 
+ 
     \note At least one of <a>r<a/>, <a>g</a>, <a>b</a> should not be NULL 
  */
 void see_shrinkRGBA(unsigned int shrinkingTimes, const unsigned char *array, size_t& width, size_t& height,  
-                    const float *filter, size_t length, img *r, img *g, img *b)
+                    const float *filter, size_t length, img *r, img *g, img *b, size_t bytesPerRow)
 {
     assert(shrinkingTimes > 0);
-    assert(r != NULL || r != 0 || g != NULL || g != 0 || b != NULL || b != 0);
+    assert(r != NULL || g != NULL || b != NULL);
+    assert(filter != 0 && (length & 1) == 1 && length <= SEE_SHRINK_MAXLENGTH);
     
-    // decompose original image into R-G-B
-    size_t size = width*height;
-    see_decompose(array, size, r, g, b);
+    if (bytesPerRow == 0) bytesPerRow = 4*width;
     
-    img tmp = 0;
+    // the last level is written straight to the output, the previous ones alternate between two buffers
+    size_t size1 = (width >> 1)*(height >> 1);
+    size_t size2 = shrinkingTimes > 2 ? (width >> 2)*(height >> 2) : 0;
+    size_t size = (width >> shrinkingTimes)*(height >> shrinkingTimes);
+    float taps[SEE_SHRINK_MAXLENGTH];
+    float *rowbuf = (float *)malloc((3*(width + length) + 3*length*(width >> 1))*sizeof(float));
+    float *planes = shrinkingTimes > 1 ? (float *)malloc(3*(size1 + size2)*sizeof(float)) : NULL;
+    float *level[2] = {planes, planes + 3*size1};
+    img out[3];
+    for (int c=0; c<3; c++) out[c] = (float *)malloc(size*sizeof(float));
     
-    for (int t = 0; t<shrinkingTimes; t++)
-    {        
-        // shrink red channel
-        if (r != NULL || r != 0)
-        {
-            tmp = see_shrinkByHalf(*r, width, height, filter, length);
-            free(*r);
-            *r = tmp;
-        }
+    see_shrinkTaps(filter, length, taps);
+    
+    for (unsigned int t = 0; t<shrinkingTimes; t++)
+    {
+        size_t levelSize = (width >> 1)*(height >> 1);
+        float *dst[3];
+        for (int c=0; c<3; c++) dst[c] = t + 1 == shrinkingTimes ? out[c] : level[t & 1] + c*levelSize;
         
-        // shrink green channel
-        if (g != NULL || g != 0)
+        if (t == 0)
         {
-            tmp = see_shrinkByHalf(*g, width, height, filter, length);
-            free(*g);
-            *g = tmp;
+            see_shrinkBGRAFixed(array, width, height, bytesPerRow, taps, length, rowbuf, dst);
         }
-        
-        // shrink blue channel
-        if (b != NULL || b != 0)
+        else
         {
-            tmp = see_shrinkByHalf(*b, width, height, filter, length);
-            free(*b);
-            *b = tmp;
+            const float *in = level[(t - 1) & 1];
+            for (int c=0; c<3; c++)
+                see_shrinkPlaneFixed(in + c*width*height, width, height, taps, length, rowbuf, dst[c]);
         }
         
-        // reduce size by half for next loop
         width = width >> 1;
         height = height >> 1;
-    }    
+    }
+    
+    // back to [0,255]
+    float scale = 1.0f/SEE_SHRINK_ONE;
+    img *channels[3] = {r, g, b};
+    for (int c=0; c<3; c++)
+    {
+        if (channels[c] == NULL) { free(out[c]); continue; }
+        see_vsmul(out[c], 1, &scale, out[c], 1, size);
+        *channels[c] = out[c];
+    }
+    
+    free(rowbuf);
+    free(planes);
 }
 
 #include <iostream>
@@ -515,7 +823,7 @@ img see_subpixBlock(const img image, size_t width, size_t height,
 	
 	// horizontal interpolation
 	float initval = x - w;
-	vDSP_vramp(&initval, &increment, ramp, 1, winsize);
+	see_vramp(&initval, &increment, ramp, 1, winsize);
 
 	int toprow = floor(y - w);// if (toprow < 0) toprow = 0;
 	int botrow = (ceil(y) == y ? y + w + 1 : ceil(y + w)); // if (botrow > height) botrow = height;
@@ -525,18 +833,18 @@ img see_subpixBlock(const img image, size_t width, size_t height,
 	
 	for ( int row = toprow; row < toprow + rowstocopy; row++ )
 	{
-		vDSP_vlint(image + row*width, ramp, 1, 
+		see_vlint(image + row*width, ramp, 1, 
 				   tmpim + (row - toprow), rowstocopy, 
 				   winsize, width);
 	}
 	
 	// vertical interpolation
 	initval = y - w - toprow;
-	vDSP_vramp(&initval, &increment, ramp, 1, winsize);
+	see_vramp(&initval, &increment, ramp, 1, winsize);
 		
 	for ( int col = 0; col < winsize; col++ )
 	{
-		vDSP_vlint(tmpim + rowstocopy*col, ramp, 1, 
+		see_vlint(tmpim + rowstocopy*col, ramp, 1, 
 				   subblock + col, winsize, winsize, rowstocopy);
 	}
 	
@@ -547,6 +855,17 @@ img see_subpixBlock(const img image, size_t width, size_t height,
 	return subblock;
 }
 
+/*! Extract a window from an image using subpixel computation
+    \param w image width
+    \param h image height
+    \param image data source (single channel)
+    \param rect window
+    \param margin extra pixels to extract around <a>rect</a>
+    \param windowRect extracted window, including the margin (or NULL)
+    \return window (allocated), or 0 if it does not fit in the image
+ 
+    \note Use see_sampleWindow to sample into a buffer of your own (or to get a view for integer positions).
+ */
 img see_extractWindow(size_t w, size_t h, img image, const Rectangle& rect, 
                       unsigned int margin, Rectangle* windowRect)
 {
@@ -557,68 +876,115 @@ img see_extractWindow(size_t w, size_t h, img image, const Rectangle& rect,
     float top = rect.top() - margin;
     float right = rect.right() + margin;
     float bottom = rect.bottom() + margin;
-    if (left < 0 || top < 0 || right >= w-2 || bottom >= h-2){
-        std::cout << "Extract window failed with margin of " << margin << " for " << rect << std::endl; 
+    if (left < 0 || top < 0 || right >= w-2 || bottom >= h-2)
         return 0;
-    }
-    
-//    std::cout << "l=" << left << " t=" << top << " r=" << right << " b=" << bottom;
     
-    float width = right - left;
-    float height = bottom - top;
+    size_t windowWRound = roundf(right - left);
+    size_t windowHRound = roundf(bottom - top);
     
-    vDSP_Length windowWRound = roundf(width);
-    vDSP_Length windowHRound = roundf(height);
-    size_t length = windowWRound*windowHRound;
+    img window = (float *)malloc(windowWRound*windowHRound*sizeof(float));
     
-    img window = (float *)calloc(length,sizeof(float));
-    
-    // horizontal interpolation    
-    float *ramp = (float *)malloc(sizeof(float)*windowWRound);
-    float increment = 1; 
-    vDSP_vramp(&left, &increment, ramp, 1, windowWRound);
+    size_t stride = 0;
+    const float *samples = see_sampleWindow(image, w, h, left, top, windowWRound, windowHRound, window, &stride);
+    assert(samples != 0);
+    if (samples != window) // integer position: copy the view
+    {
+        for (size_t r=0; r<windowHRound; r++)
+            memcpy(window + r*windowWRound, samples + r*stride, windowWRound*sizeof(float));
+    }
     
-    int toprow = floor(top);
-    int botrow = ceil(bottom); //(ceil(bottom) == bottom ? bottom + 1 : bottom);
-    int rowstocopy = botrow - toprow + 1;
+    if (windowRect != 0) 
+    { 
+        windowRect->origin = Vector2(left, top);
+        windowRect->size = Vector2(windowWRound, windowHRound);
+    }
     
-//    std::cout << " toprow=" << toprow << " botrow=" << botrow << " rowstocopy=" << rowstocopy << std::flush;
+    return window;    
+}
+
+/*! Bilinear interpolation between two rows: c = a + t*(b - a) */
+static inline void see_lerpRow(const float *a, const float *b, float t, float *c, size_t n)
+{
+    vfloat vt = vf_set(t);
+    size_t i = 0;
+    for (; i + SEE_VWIDTH <= n; i += SEE_VWIDTH)
+    {
+        vfloat va = vf_load(a + i);
+        vf_store(c + i, vf_add(va, vf_mul(vt, vf_sub(vf_load(b + i), va))));
+    }
+    for (; i < n; i++) c[i] = a[i] + t*(b[i] - a[i]);
+}
 
+/*! Sample a window of an image at a subpixel position without allocating memory
+    \param image image (single channel)
+    \param width <a>image</a> width
+    \param height <a>image</a> height
+    \param left horizontal position of the first column of the window
+    \param top vertical position of the first row of the window
+    \param ww window width
+    \param wh window height
+    \param window output (<a>ww</a>*<a>wh</a> floats, row-major), only written for subpixel positions
+    \param stride elements between consecutive rows of the returned window
+    \return first sample of the window, or NULL if the window does not fit in <a>image</a>
+ 
+    A window shifted by a constant subpixel offset uses the same bilinear weights everywhere, so it 
+    is interpolated row by row: (1-fy)*(row y) + fy*(row y+1), each row interpolated at (1-fx), fx. 
+    If <a>left</a> and <a>top</a> are integers, no sample is computed: the returned pointer is a 
+    view into <a>image</a> (<a>stride</a> = <a>width</a>). Otherwise the samples are written to 
+    <a>window</a> (<a>stride</a> = <a>ww</a>). Only the pixels needed by the interpolation are read.
+ */
+const float* see_sampleWindow(const float *image, size_t width, size_t height, float left, float top,
+                              size_t ww, size_t wh, float *window, size_t *stride)
+{
+    assert(image != 0 && stride != 0);
     
-    img tmpIm = (float *)malloc(sizeof(float)*rowstocopy*windowWRound);
+    float x0f = floorf(left), y0f = floorf(top);
+    if (!(x0f >= 0 && y0f >= 0)) return 0;
+    float fx = left - x0f, fy = top - y0f;
+    size_t x0 = (size_t)x0f, y0 = (size_t)y0f;
+    if (x0 + ww + (fx > 0 ? 1 : 0) > width || y0 + wh + (fy > 0 ? 1 : 0) > height) return 0;
     
-    for (int r=toprow; r < toprow + rowstocopy; r++)
+    const float *src = image + y0*width + x0;
+    if (fx == 0 && fy == 0)
     {
-        vDSP_vlint(image + r*w, ramp, 1, 
-                   tmpIm + (r - toprow), rowstocopy, windowWRound, w);
+        *stride = width;
+        return src;
     }
-    free(ramp);
     
-    // vertical interpolation
-    ramp = (float *)malloc(sizeof(float)*windowHRound);
-    float initval = top - toprow;
-    vDSP_vramp(&initval, &increment, ramp, 1, windowHRound);
+    assert(window != 0);
+    *stride = ww;
     
-//    std::cout << " vertinterp for initval=" << initval << std::flush;
-
-    
-    for (int c=0; c < windowWRound; c++)
+    if (fx == 0 || fy == 0) // one-dimensional shift
     {
-        vDSP_vlint(tmpIm + rowstocopy*c, ramp, 1, 
-                   window + c, windowWRound, windowHRound, rowstocopy);
+        size_t next = (fx > 0 ? 1 : width);
+        float t = (fx > 0 ? fx : fy);
+        for (size_t r=0; r<wh; r++)
+            see_lerpRow(src + r*width, src + r*width + next, t, window + r*ww, ww);
+        return window;
     }
-    free(ramp);
-    free(tmpIm);
     
-//    std::cout << std::endl;
-    
-    if (windowRect != 0) 
-    { 
-        windowRect->origin = Vector2(left, top);
-        windowRect->size = Vector2(windowWRound, windowHRound);
+    vfloat vfx = vf_set(fx), vfy = vf_set(fy);
+    for (size_t r=0; r<wh; r++)
+    {
+        const float *a = src + r*width, *b = a + width;
+        float *out = window + r*ww;
+        size_t c = 0;
+        for (; c + SEE_VWIDTH <= ww; c += SEE_VWIDTH)
+        {
+            vfloat a0 = vf_load(a + c), b0 = vf_load(b + c);
+            vfloat h0 = vf_add(a0, vf_mul(vfx, vf_sub(vf_load(a + c + 1), a0)));
+            vfloat h1 = vf_add(b0, vf_mul(vfx, vf_sub(vf_load(b + c + 1), b0)));
+            vf_store(out + c, vf_add(h0, vf_mul(vfy, vf_sub(h1, h0))));
+        }
+        for (; c < ww; c++)
+        {
+            float h0 = a[c] + fx*(a[c+1] - a[c]);
+            float h1 = b[c] + fx*(b[c+1] - b[c]);
+            out[c] = h0 + fy*(h1 - h0);
+        }
     }
     
-    return window;    
+    return window;
 }
 
 /**
@@ -638,7 +1004,7 @@ img see_addMargin(size_t w, size_t h, img image, unsigned int margin, size_t *ne
     img extendedImage = (float *) malloc(newWidth*newHeight*sizeof(float));
     
     for (int r=0; r<h; r++)
-    { cblas_scopy((int)w, image+r*w, 1, extendedImage + margin + (r + margin)*newWidth, 1); }
+    { see_scopy((int)w, image+r*w, 1, extendedImage + margin + (r + margin)*newWidth, 1); }
     
     if (newW != NULL) *newW = newWidth;
     if (newH != NULL) *newH = newHeight;
@@ -663,7 +1029,7 @@ img see_convolveHor(const img image, size_t width, size_t height, size_t bytesPe
     
     for (int r=0; r<height; r++)
     {
-        vDSP_conv(image + r*width, 1, filterAddr, -1,
+        see_conv(image + r*width, 1, filterAddr, -1,
                   convolved + emptyMargin*newW + emptyMargin + r*newW, 1, validW, lenFilter);	
     }
     
@@ -685,11 +1051,11 @@ img see_convolveVer(const img image, size_t width, size_t height, size_t bytesPe
     
     const float *filterAddr = filter + lenFilter - 1;
     
-    for (int c=0; c<width; c++)
-    {
-        vDSP_conv(image + c, bytesPerRow, filterAddr, -1,
-                  convolved + emptyMargin*newW + emptyMargin + c, newW, validH, lenFilter);	
-    }
+    const float **rows = (const float**)malloc(height*sizeof(float*));
+    for (int r=0; r<height; r++) rows[r] = image + r*bytesPerRow;
+    see_convVer(rows, 1, filterAddr, -1,
+                convolved + emptyMargin*newW + emptyMargin, newW, width, validH, lenFilter);
+    free(rows);
     
     if (size != 0) {size->x = newW; size->y = newH;}
     
@@ -698,152 +1064,170 @@ img see_convolveVer(const img image, size_t width, size_t height, size_t bytesPe
 
 #pragma mark PYRAMID
 
-/*! Decompose image into channels and build pyramid
+#define SEE_PYRAMID_BLOCKROWS 4                             //!< output rows filtered vertically at once
+#define SEE_PYRAMID_ALIGN(n) (((n) + 15) & ~((size_t)15))       //!< round number of floats up to 64 bytes
+
+/*! Filter an image with <a>filter</a> in both directions and subsample it by two
+    \param im input image
+    \param width image width
+    \param height image height
+    \param out reduced image (<a>width</a>/2 x <a>height</a>/2)
+    \param filter filter
+    \param length filter length
+    \param frev scratch for the reversed filter (<a>length</a> floats)
+    \param rowbuf scratch for filtered rows (SEE_PYRAMID_BLOCKROWS*(<a>width</a> + <a>length</a>) floats)
+    \param rows scratch for row pointers (2*(SEE_PYRAMID_BLOCKROWS - 1) + <a>length</a> entries)
+ 
+    Only the samples that survive the subsampling are computed: the vertical pass runs on even 
+    rows (a few rows at a time, see see_convVer) and the horizontal pass on even columns. Borders 
+    are handled by replicating the first and last rows/columns.
+ */
+static void see_pyramidReduce(const float *im, size_t width, size_t height, float *out,
+                              const float *filter, size_t length, 
+                              float *frev, float *rowbuf, const float **rows)
+{
+    size_t midExtraL = floorf(length*0.5);                  //!< extra pixels needed per size to colvolve with the filter (half extraL)
+	size_t extraL = midExtraL*2;                            //!< extra pixels needed per dimension
+    const float* filteraddr = filter + length - 1;          //!< filter address (convolutions require to start from the end)
+    for (int j=0; j<length; j++) frev[j] = filter[length-1-j];
+    
+    size_t w = width, h = height;
+    if (w % 2 != 0) w -= 1;                                 //!< assure width is multiple of 2
+    if (h % 2 != 0) h -= 1;                                 //!< assure height is multiple of 2
+    size_t width2 = w >> 1, height2 = h >> 1;               //!< new image dimensions
+    size_t bytesPerRowBuf = w + extraL;                     //!< elements per row in rowbuf
+    
+    for (int row=0; row < height2; row += SEE_PYRAMID_BLOCKROWS)
+    {
+        int nrows = (height2 - row < SEE_PYRAMID_BLOCKROWS ? height2 - row : SEE_PYRAMID_BLOCKROWS);
+        
+        // filter vertically around rows 2*row, 2*row+2, ... (top-bottom borders are replicated)
+        for (int i=0; i < 2*(nrows-1) + length; i++)
+        {
+            long s = 2*row + i - (long)midExtraL;
+            rows[i] = (s < 0 ? im : (s >= (long)h ? im + (height-1)*width : im + s*width));
+        }
+        see_convVer(rows, 2, filteraddr, -1, rowbuf + midExtraL, bytesPerRowBuf, w, nrows, length);
+        
+        for (int k=0; k < nrows; k++)
+        {
+            float *buf = rowbuf + k*bytesPerRowBuf;
+            
+            // replicate left-right borders to apply the filter properly on the sides
+            for (int col=0; col < midExtraL; col++)
+            {
+                buf[col] = buf[midExtraL];
+                buf[midExtraL + w + col] = buf[midExtraL + w - 1];
+            }
+            
+            // filter horizontally on even columns only
+            see_desamp(buf, 2, frev, out + (row+k)*width2, width2, length);
+        }
+    }
+}
+
+/*! Build Gaussian pyramid
 	\param image input image
 	\param width image width
 	\param height image height
 	\param lev number of pyramid levels
-	\param pyramid pyramid
+	\param pyramid pyramid (its storage is reused if large enough)
 	\param filter filter	
 	\param length filter length
 	\param offset how many levels to ignore before pushing image into pyramid
-	\note if offset is zero, the first image of the pyramid points to <a>image</a>
+	\note if offset is zero, the first level of the pyramid is a copy of <a>image</a>
  */
 void see_pyramid(const img image, size_t width, size_t height, size_t lev,
-				 pyr& pyramid, const float *filter, size_t length, int offset)
+				 Pyramid& pyramid, const float *filter, size_t length, int offset)
 {
 	assert(image != 0 && lev > 0 && 
 		   width > 1<<(int(lev)) && height > 1<<(int(lev)) &&
 		   length > 0 && filter != 0);
-	
-	// decompose image into float arrays
-	//size_t size = width*height;
-	    
-    size_t midExtraL = floorf(length*0.5);                  //!< extra pixels needed per size to colvolve with the filter (half extraL)
-	size_t extraL = midExtraL*2;                            //!< extra pixels needed per dimension
-	
-	img signal = (float*)calloc(width*(height + extraL),sizeof(float));    //!< allocate space for the processed image with extra pixels
-	img auxsig = (float*)calloc((width + extraL)*height,sizeof(float));    //!< auxiliary array
-	const float* filteraddr = filter + length - 1;          //!< filter address (convolutions require to start from the end)
-	
-    size_t w = 0, h = 0;                                    //!< temporary dimensions
-    int bytesPerRowAux;                                     //!< elements per row in signal
-
-    img im = image;                                         //!< pointer to previous pyramid level
-	
-	// set up pyramid...
+    
 	int totlev = lev + offset;                              //!< total number of pyramid levels to process
+    assert(totlev <= SEE_PYRAMID_MAX_LEVELS);
+    
+    // lay out levels (level 0 is only stored when it is part of the pyramid)
+    size_t w[SEE_PYRAMID_MAX_LEVELS], h[SEE_PYRAMID_MAX_LEVELS], start[SEE_PYRAMID_MAX_LEVELS];
+    size_t total = 0;
+    w[0] = width; h[0] = height; start[0] = 0;
+    if (offset == 0) total += SEE_PYRAMID_ALIGN(width*height);
+    for (int l=1; l<totlev; l++)
+    {
+        w[l] = w[l-1] >> 1; h[l] = h[l-1] >> 1;
+        start[l] = total;
+        total += SEE_PYRAMID_ALIGN(w[l]*h[l]);
+    }
+    
+    // scratch: reversed filter, filtered rows and row pointers
+    size_t nrows = 2*(SEE_PYRAMID_BLOCKROWS - 1) + length;
+    size_t frevStart = total;
+    size_t rowbufStart = frevStart + SEE_PYRAMID_ALIGN(length);
+    size_t rowsStart = rowbufStart + SEE_PYRAMID_ALIGN(SEE_PYRAMID_BLOCKROWS*(width + length));
+    total = rowsStart + SEE_PYRAMID_ALIGN((nrows*sizeof(float*) + sizeof(float) - 1)/sizeof(float));
+    
+    // grow storage if needed
+    if (total > pyramid.capacity)
+    {
+        free(pyramid.data);
+        void *data = 0;
+        if (posix_memalign(&data, 64, total*sizeof(float)) != 0) data = 0;
+        assert(data != 0);
+        pyramid.data = (float*)data;
+        pyramid.capacity = total;
+    }
+    
+    float *frev = pyramid.data + frevStart;
+    float *rowbuf = pyramid.data + rowbufStart;
+    const float **rows = (const float**)(pyramid.data + rowsStart);
+    
+    // set up pyramid...
+    pyramid.levels = lev;
+    for (int l=0; l<lev; l++)
+    {
+        pyramid.width[l] = w[l+offset];
+        pyramid.height[l] = h[l+offset];
+        pyramid.offset[l] = start[l+offset];
+    }
 	if (offset == 0)
-	{	// first image of the pyramid points to <a>image</a>
-        pyramid.push_back(image);
-//        std::cout << "setting up pyr lev(0) of " << width << "x" << height << std::endl; 
+	{	// first level of the pyramid is a copy of <a>image</a>
+        memcpy(pyramid.data, image, width*height*sizeof(float));
 	}
+    
 	// build pyramid levels from 1 up to totlev
 	for (int l=1; l<totlev; l++)				
-	{			
-        w = width; h = height;
-        if (w % 2 != 0) w -= 1;                         //!< assure width is multiple of 2
-        if (h % 2 != 0) h -= 1;                         //!< assure height is multiple of 2
-		bytesPerRowAux = (w + extraL);               //!< pixels to process per row
-        
-		// copy horizontally and replicate top-bottom borders
-		for ( int row=0; row < h; row++ )
-		{
-			cblas_scopy(w, im + (row*width), 1, 
-						signal + (row+midExtraL)*w, 1);
-            // copy extra pixels
-			if (row < midExtraL)
-			{
-				cblas_scopy(w, im, 1, 
-							signal + row*w, 1);
-				cblas_scopy(w, im + (height-1)*width, 1, 
-							signal + (row+h+midExtraL)*w, 1);
-			}
-		}
-		
-		// filter vertically 
-		for ( int col=0; col < w; col++ )
-		{			
-            // convolve with the filter
-			vDSP_conv(signal + col, w, filteraddr, -1,
-					  auxsig + col + midExtraL, bytesPerRowAux, h, length);			
-		}
-        
-        // replicate left-right borders to apply the filter properly on the sides
-        for (int col=0; col < midExtraL; col++)
-        {
-            cblas_scopy(height, auxsig + midExtraL, bytesPerRowAux, 
-                        auxsig + col, bytesPerRowAux);
-            cblas_scopy(height, auxsig + midExtraL + w - 1, bytesPerRowAux, 
-                        auxsig + midExtraL + w + col, bytesPerRowAux);	            
-        }
-        
-		// filter horizontally, set result in auxiliary var
-		for ( int row=0; row < h; row++ )
-		{
-			vDSP_conv(auxsig + (row*bytesPerRowAux) + midExtraL, 1, filteraddr, -1,
-					  signal + (row*w), 1, w, length);
-		}
-		
-		// new image dimensions
-		width = w >> 1;
-		height = h >> 1;
-		
-        // save subsampled image
-        img tmp = (float*)calloc(width*height, sizeof(float)); 
-        for ( int row=0; row < height; row++ )
-        {
-            cblas_scopy(width, signal + row*2*w, 2, tmp + (row*width), 1);
-        }
-        
-        // save new image
-		if (l >= offset) 
-        {
-            pyramid.push_back(tmp);
-//            std::cout << "setting up pyr lev("<< l <<") of " << width << "x" << height << std::endl; 
-        }
-        
-        // free previous image if it's not the original and it's not in the pyramid
-        if (l > 1 && l <= offset) free(im);
-        
-        // get ready to process new image
-        im = tmp;
+	{
+        const float *im = (l == 1 ? image : pyramid.data + start[l-1]);
+        see_pyramidReduce(im, w[l-1], h[l-1], pyramid.data + start[l], 
+                          filter, length, frev, rowbuf, rows);
 	}
-	
-	free(signal);	
-	free(auxsig);
-
 }
 
-/*! Free pyramid 
-	\param pyramid pyramid
+/*! Exchange two pyramids, storage included
+	\param a pyramid
+	\param b pyramid
  */
-void see_freePyr(pyr& pyramid)
+void see_swapPyramids(Pyramid& a, Pyramid& b)
 {
-	if (!pyramid.empty())
-	{
-		for (int l=0; l<pyramid.size(); l++)
-		{
-			float *im = pyramid.at(l); 
-			free(im);
-		}
-		pyramid.clear();
-	}
+    float *data = a.data; a.data = b.data; b.data = data;
+    size_t tmp = a.capacity; a.capacity = b.capacity; b.capacity = tmp;
+    tmp = a.levels; a.levels = b.levels; b.levels = tmp;
+    for (int l=0; l<SEE_PYRAMID_MAX_LEVELS; l++)
+    {
+        tmp = a.width[l]; a.width[l] = b.width[l]; b.width[l] = tmp;
+        tmp = a.height[l]; a.height[l] = b.height[l]; b.height[l] = tmp;
+        tmp = a.offset[l]; a.offset[l] = b.offset[l]; b.offset[l] = tmp;
+    }
 }
 
-/*! Free pyramid up to base image (do not release original image)
-    \param pyramid pyramid
+/*! Free pyramid storage
+	\param pyramid pyramid
  */
-void see_freePyrUpToBase(pyr& pyramid)
+void see_freePyramid(Pyramid& pyramid)
 {
-    if (!pyramid.empty())
-	{
-        int nlev = pyramid.size();
-		for (int l=nlev-1; l>0; l--)
-		{
-			float *im = pyramid.back(); free(im);
-            pyramid.pop_back();
-		}
-	}
+    free(pyramid.data);
+    pyramid.data = 0;
+    pyramid.capacity = 0;
+    pyramid.levels = 0;
 }
 
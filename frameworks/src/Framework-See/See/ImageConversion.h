@@ -35,8 +35,9 @@
 
 #include "ImageTypes.h"
 #include <BasicMath/Vector2.h>
-#include <Accelerate/Accelerate.h>
+#include "SeeVector.h"
 #include <assert.h>
+#include <stdlib.h>
 #include <BasicMath/Rectangle.h>
 
 #if __cplusplus
@@ -62,7 +63,7 @@ inline float* see_ucharArrayToFloat(const unsigned char *array,
 {	
     size_t realLength = length-left-right;
 	float *f = (float *) calloc(realLength, sizeof(float));
-	vDSP_vfltu8((unsigned char*)array+left,stride,f,1,length);
+	see_vfltu8((unsigned char*)array+left,stride,f,1,length);
 	return f;
 }
 
@@ -85,7 +86,7 @@ inline unsigned char* see_floatArrayToUChar(const float *array,
 	assert(left + right < length);
     size_t realLength = length-left-right;
 	unsigned char *c = (unsigned char *) malloc(realLength*sizeof(unsigned char));
-	vDSP_vfixru8((float*)array+left,1,c,stride,realLength);
+	see_vfixru8((float*)array+left,1,c,stride,realLength);
 	return c;
 }
     
@@ -100,9 +101,9 @@ inline unsigned char* see_floatArrayToUCharRGB(const float *array,
                                                size_t length)
 {
     unsigned char *c = (unsigned char *) malloc(length*sizeof(unsigned char)*3);
-    vDSP_vfixru8((float*)array,1,c,3,length);
-    vDSP_vfixru8((float*)array,1,c+1,3,length);
-    vDSP_vfixru8((float*)array,1,c+2,3,length);
+    see_vfixru8((float*)array,1,c,3,length);
+    see_vfixru8((float*)array,1,c+1,3,length);
+    see_vfixru8((float*)array,1,c+2,3,length);
     return c;
 }
 
@@ -116,14 +117,14 @@ inline void see_scaleTo(img &image, size_t size, float maxVal, int32_t stride =
 {
 	
 	float maximum = 0.0, minimum = 0.0;
-	vDSP_minv(image, stride, &minimum, size);
-	vDSP_maxv(image, stride, &maximum, size);
+	see_minv(image, stride, &minimum, size);
+	see_maxv(image, stride, &maximum, size);
 	
 	//NSLog(@"max = %.2f | min = %.2f", maximum, minimum);
 	minimum = -minimum;
 	float r = maxVal/(maximum + minimum);
-	vDSP_vsadd(image, stride, &minimum, image, stride, size);
-	vDSP_vsmul(image, stride, &r, image, stride, size);
+	see_vsadd(image, stride, &minimum, image, stride, size);
+	see_vsmul(image, stride, &r, image, stride, size);
 }
     
 img see_scaleToAndCopy(img &image, size_t size, float maxVal, int32_t stride = 1);
@@ -152,23 +153,42 @@ inline void see_decompose(const unsigned char *array, size_t size,
 			   
 img see_intensity(const img r, const img g, const img b, size_t size);
 void see_opponency(const img r, const img g, const img b, size_t size, img *rg, img *by);
+void see_featuresBGRA(const unsigned char *array, size_t width, size_t height, size_t bytesPerRow,
+                      img featInt, img featRG, img featBY);
 	
 img see_enlargeWithDim(size_t desiredw, size_t desiredh, const img& image, 
                        size_t width, size_t height, size_t& neww, size_t& newh, bool pixelate = false);
 img see_enlarge(size_t desiredw, size_t desiredh, const img& image, 
                 size_t width, size_t height);
     
+/*! Scratch floats needed by see_enlargeWithBuffers */
+#define see_enlargeBufferSize(desiredw, desiredh, height) ((desiredw)*(height) + (desiredw) + (desiredh))
+    
+void see_enlargeWithBuffers(size_t desiredw, size_t desiredh, const float *image, 
+                            size_t width, size_t height, float *enlarged, float *buffer);
+
+/*! Scratch floats needed by see_enlargeRows */
+#define see_enlargeRowsBufferSize(desiredw, desiredh, height, nrows) \
+    ((desiredw)*((nrows)*(height)/(desiredh) + 4) + (desiredw) + (desiredh))
+
+void see_enlargeRows(size_t desiredw, size_t desiredh, const float *image, size_t width, size_t height,
+                     size_t row0, size_t nrows, float *enlarged, float *buffer);
+    
 img see_shrinkByHalf(const img image, size_t width, size_t height, const float *filter, size_t length);
     
+#define SEE_SHRINK_MAXLENGTH 15     //!< longest filter accepted by see_shrinkRGBA
+    
 void see_shrinkRGBA(unsigned int shrinkingTimes, const unsigned char *array, size_t& width, size_t& height, 
                     const float *filter, size_t length, 
-                    img *r = NULL, img *g = NULL, img *b = NULL);
+                    img *r = NULL, img *g = NULL, img *b = NULL, size_t bytesPerRow = 0);
 	
 img see_subpixBlock(const img image, size_t width, size_t height, float x, float y, size_t w);	
     
 img see_extractWindow(size_t w, size_t h, img image, 
                       const Rectangle& rect, unsigned int margin, 
                       Rectangle* windowRect);
+const float* see_sampleWindow(const float *image, size_t width, size_t height, float left, float top,
+                              size_t ww, size_t wh, float *window, size_t *stride);
 img see_addMargin(size_t w, size_t h, img image, unsigned int margin, size_t *newW = NULL, size_t *newH = NULL);
     
 #pragma mark FILTERING
@@ -214,10 +234,21 @@ img see_convolveVer(const img image, size_t width, size_t height, size_t bytesPe
 #pragma mark PYRAMID
 
 void see_pyramid(const img image, size_t width, size_t height, size_t lev,
-			 pyr& pyramid, const float *filter, size_t length, int offset);
+			 Pyramid& pyramid, const float *filter, size_t length, int offset);
 	
-void see_freePyr(pyr& pyramid);
-void see_freePyrUpToBase(pyr& pyramid);
+/*! Level of a pyramid
+    \param pyramid pyramid
+    \param l level (0 is the finest one)
+    \return image at level <a>l</a> (of pyramid.width[l] x pyramid.height[l])
+ */
+inline img see_pyramidLevel(const Pyramid& pyramid, size_t l)
+{
+    assert(l < pyramid.levels);
+    return pyramid.data + pyramid.offset[l];
+}
+    
+void see_swapPyramids(Pyramid& a, Pyramid& b);
+void see_freePyramid(Pyramid& pyramid);
 	
 #if __cplusplus
 }
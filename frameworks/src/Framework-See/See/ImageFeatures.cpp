@@ -0,0 +1,572 @@
+//
+//  ImageFeatures.cpp
+//  Framework-See
+//
+//	Copyright 2014 Carnegie Mellon University
+//
+//	This work was developed under the Rehabilitation Engineering Research
+//	Center on Accessible Public Transportation (www.rercapt.org) and is funded
+//	by grant number H133E080019 from the United States Department of Education
+//	through the National Institute on Disability and Rehabilitation Research.
+//	No endorsement should be assumed by NIDRR or the United States Government
+//	for the content contained on this code.
+//
+//	Permission is hereby granted, free of charge, to any person obtaining a copy
+//	of this software and associated documentation files (the "Software"), to deal
+//	in the Software without restriction, including without limitation the rights
+//	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//	copies of the Software, and to permit persons to whom the Software is
+//	furnished to do so, subject to the following conditions:
+//
+//	The above copyright notice and this permission notice shall be included in
+//	all copies or substantial portions of the Software.
+//
+//	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//	THE SOFTWARE.
+
+#include "ImageFeatures.h"
+#include "ImageConversion.h"
+#include "SeeVector.h"
+#include "SeeSIMD.h"
+#include "SeeThreadPool.h"
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+
+#pragma mark Gradients
+
+/*! Row pointers stored after the padded row of a filtering scratch buffer (kept 8-byte aligned) */
+static inline const float** see_filterRows(float *scratch, size_t width)
+{
+    return (const float **)(scratch + ((width + 7) & ~(size_t)1));
+}
+
+/** FILTER_GAUSDERIV7 gradients of a whole image, with replicated borders
+    \param image image
+    \param width <a>image</a> width
+    \param height <a>image</a> height
+    \param gx horizontal gradient (width*height)
+    \param gy vertical gradient (width*height)
+    \param scratch width + 8 floats followed by room for height + 6 row pointers
+ 
+    Same filter and orientation as the template trackers (see see_setLKTemplate). Rows past the 
+    top and bottom borders are passed to see_convVer by address, so they are never copied.
+ */
+static void see_imageGradients(const float *image, size_t width, size_t height, float *gx, float *gy, 
+                               float *scratch)
+{
+    const size_t margin = FSIZE_GAUSDERIV7/2;
+    const float *filterAddr = FILTER_GAUSDERIV7 + FSIZE_GAUSDERIV7 - 1;
+    
+    // horizontal: each row with replicated ends
+    float *row = scratch;
+    for (size_t r=0; r<height; r++)
+    {
+        const float *src = image + r*width;
+        for (size_t k=0; k<margin; k++)
+        {
+            row[k] = src[0];
+            row[margin + width + k] = src[width - 1];
+        }
+        memcpy(row + margin, src, width*sizeof(float));
+        see_conv(row, 1, filterAddr, -1, gx + r*width, 1, width, FSIZE_GAUSDERIV7);
+    }
+    
+    // vertical
+    const float **rows = see_filterRows(scratch, width);
+    for (size_t r=0; r<height + 2*margin; r++)
+    {
+        long y = (long)r - (long)margin;
+        y = (y < 0 ? 0 : (y >= (long)height ? (long)height - 1 : y));
+        rows[r] = image + y*width;
+    }
+    see_convVer(rows, 1, filterAddr, -1, gy, width, width, height, FSIZE_GAUSDERIV7);
+}
+
+#pragma mark Corners
+
+/*! Order corners by decreasing score (qsort) */
+static int see_compareCorners(const void *a, const void *b)
+{
+    float sa = ((const Corner *)a)->score, sb = ((const Corner *)b)->score;
+    return (sa < sb) - (sa > sb);
+}
+
+/** Shi-Tomasi corners from image gradients
+    \param gx horizontal gradient
+    \param gy vertical gradient
+    \param width gradients width
+    \param height gradients height
+    \param corners output corners, by decreasing score
+    \param maxCorners room in <a>corners</a>
+    \param quality minimum score, relative to the best score in the image
+    \param cell side of the grid cells (at most one corner per cell)
+    \param radius the structure tensor is summed over (2*radius+1)^2 windows
+    \param border pixels closer than this to the image border are not scored (at least the 
+    support of the window and of the derivative filter)
+    \param buffer 4*width*height + 3*width floats
+    \return number of corners
+ 
+    The score is the smallest eigenvalue of the structure tensor. Non-maximum suppression keeps, 
+    in every cell, the best pixel that is a maximum of its 3x3 neighbourhood.
+ */
+static size_t see_cornersFromGradients(const float *gx, const float *gy, size_t width, size_t height,
+                                       Corner *corners, size_t maxCorners, float quality, size_t cell,
+                                       unsigned int radius, size_t border, float *buffer)
+{
+    size_t d = 2*radius + 1, n = width*height;
+    if (border < radius + FSIZE_GAUSDERIV7/2 + 1) border = radius + FSIZE_GAUSDERIV7/2 + 1;
+    if (maxCorners == 0 || cell == 0 || width <= 2*border || height <= 2*border) return 0;
+    float *sxx = buffer, *sxy = sxx + n, *syy = sxy + n, *score = syy + n;
+    float *axx = score + n, *axy = axx + width, *ayy = axy + width;
+    
+    // structure tensor summed along rows: the products of a row (kept in the column accumulators, 
+    // which are not in use yet) are filtered with a box of d ones (kept at the start of the score map)
+    const size_t V = SEE_VWIDTH;
+    float *ones = score;
+    for (size_t k=0; k<d; k++) ones[k] = 1.0f;
+    for (size_t r=0; r<height; r++)
+    {
+        const float *x = gx + r*width, *y = gy + r*width;
+        size_t c = 0;
+        for (; c + V <= width; c += V)
+        {
+            vfloat vx = vf_load(x + c), vy = vf_load(y + c);
+            vf_store(axx + c, vf_mul(vx, vx));
+            vf_store(axy + c, vf_mul(vx, vy));
+            vf_store(ayy + c, vf_mul(vy, vy));
+        }
+        for (; c<width; c++)
+        {
+            axx[c] = x[c]*x[c]; axy[c] = x[c]*y[c]; ayy[c] = y[c]*y[c];
+        }
+        see_conv(axx, 1, ones, 1, sxx + r*width + radius, 1, width - 2*radius, d);
+        see_conv(axy, 1, ones, 1, sxy + r*width + radius, 1, width - 2*radius, d);
+        see_conv(ayy, 1, ones, 1, syy + r*width + radius, 1, width - 2*radius, d);
+    }
+    
+    // summed along columns (running sums over d rows), then smallest eigenvalue
+    memset(score, 0, n*sizeof(float));
+    memset(axx, 0, 3*width*sizeof(float));
+    size_t c0 = border, c1 = width - border;
+    vfloat vhalf = vf_set(0.5f), vbest = vf_set(0.0f);
+    float best = 0;
+    for (size_t r=0; r<height; r++)
+    {
+        const float *add[3] = {sxx + r*width, sxy + r*width, syy + r*width};
+        float *acc[3] = {axx, axy, ayy};
+        for (int k=0; k<3; k++)
+        {
+            const float *a = add[k], *b = (r >= d ? add[k] - d*width : 0);
+            float *o = acc[k];
+            size_t c = c0;
+            if (b != 0)
+            {
+                for (; c + V <= c1; c += V) vf_store(o + c, vf_add(vf_load(o + c), vf_sub(vf_load(a + c), vf_load(b + c))));
+                for (; c<c1; c++) o[c] += a[c] - b[c];
+            }
+            else
+            {
+                for (; c + V <= c1; c += V) vf_store(o + c, vf_add(vf_load(o + c), vf_load(a + c)));
+                for (; c<c1; c++) o[c] += a[c];
+            }
+        }
+        if (r + 1 < d) continue;
+        size_t y = r - radius;
+        if (y < border || y >= height - border) continue;
+        
+        float *s = score + y*width;
+        size_t c = c0;
+        for (; c + V <= c1; c += V)
+        {
+            vfloat xx = vf_load(axx + c), xy = vf_load(axy + c), yy = vf_load(ayy + c);
+            vfloat half = vf_mul(vhalf, vf_sub(xx, yy));
+            vfloat v = vf_sub(vf_mul(vhalf, vf_add(xx, yy)), vf_sqrt(vf_add(vf_mul(half, half), vf_mul(xy, xy))));
+            vf_store(s + c, v);
+            vbest = vf_max(vbest, v);
+        }
+        for (; c<c1; c++)
+        {
+            float half = 0.5f*(axx[c] - ayy[c]);
+            s[c] = 0.5f*(axx[c] + ayy[c]) - sqrtf(half*half + axy[c]*axy[c]);
+            if (s[c] > best) best = s[c];
+        }
+    }
+    best = fmaxf(best, vf_hmax(vbest));
+    if (best <= 0) return 0;
+    
+    // best local maximum of every cell (the tensor sums are not needed anymore)
+    float threshold = quality*best;
+    Corner *candidates = (Corner *)buffer;
+    size_t count = 0;
+    for (size_t cy=border; cy<height-border; cy+=cell)
+    {
+        for (size_t cx=border; cx<width-border; cx+=cell)
+        {
+            float bestScore = threshold;
+            size_t bx = 0, by = 0;
+            for (size_t y=cy; y<cy+cell && y<height-border; y++)
+            {
+                const float *s = score + y*width;
+                for (size_t x=cx; x<cx+cell && x<width-border; x++)
+                {
+                    float v = s[x];
+                    if (v <= bestScore) continue;
+                    if (v < s[x-1] || v < s[x+1] || 
+                        v < s[x-width-1] || v < s[x-width] || v < s[x-width+1] ||
+                        v < s[x+width-1] || v < s[x+width] || v < s[x+width+1]) continue;
+                    bestScore = v; bx = x; by = y;
+                }
+            }
+            if (bestScore > threshold)
+            {
+                candidates[count].pos = Vector2(bx, by);
+                candidates[count].score = bestScore;
+                count++;
+            }
+        }
+    }
+    
+    qsort(candidates, count, sizeof(Corner), see_compareCorners);
+    if (count > maxCorners) count = maxCorners;
+    std::copy(candidates, candidates + count, corners);
+    
+    return count;
+}
+
+/** Detect corners (Shi-Tomasi) with grid-based non-maximum suppression
+    \param image normalized image
+    \param width <a>image</a> width
+    \param height <a>image</a> height
+    \param corners output corners, by decreasing score
+    \param maxCorners room in <a>corners</a>
+    \param quality minimum score, relative to the best score in the image
+    \param cell side of the grid cells in pixels (at most one corner per cell)
+    \param radius the structure tensor is summed over (2*radius+1)^2 windows
+    \param buffer see_detectCornersBufferSize(width, height) floats (or NULL to allocate them)
+    \return number of corners
+ 
+    Gradients are computed with FILTER_GAUSDERIV7, as for the template trackers. The score of a 
+    pixel is the smallest eigenvalue of the structure tensor of its window, which is large only 
+    when the window can be tracked in both directions.
+ */
+size_t see_detectCorners(const img image, size_t width, size_t height, Corner *corners, size_t maxCorners,
+                         float quality, size_t cell, unsigned int radius, float *buffer)
+{
+    float *buf = buffer;
+    if (buf == NULL)
+    {
+        buf = (float *)malloc(see_detectCornersBufferSize(width, height)*sizeof(float));
+        assert(buf != 0);
+    }
+    
+    size_t n = width*height;
+    float *gx = buf, *gy = gx + n, *detect = gy + n, *filter = detect + 4*n + 3*width;
+    see_imageGradients(image, width, height, gx, gy, filter);
+    size_t count = see_cornersFromGradients(gx, gy, width, height, corners, maxCorners, 
+                                            quality, cell, radius, 0, detect);
+    
+    if (buffer == NULL) free(buf);
+    
+    return count;
+}
+
+#pragma mark Point tracking
+
+/*! Sample a window into contiguous memory (copying it if see_sampleWindow returns a view) */
+static bool see_KLTWindow(const float *image, size_t width, size_t height, float left, float top, 
+                          size_t d, float *window)
+{
+    size_t stride = 0;
+    const float *s = see_sampleWindow(image, width, height, left, top, d, d, window, &stride);
+    if (s == 0) return false;
+    if (s != window)
+        for (size_t r=0; r<d; r++) memcpy(window + r*d, s + r*stride, d*sizeof(float));
+    return true;
+}
+
+/** Track one point from the previous to the next pyramid
+    \param tracker tracker (with the gradients of the previous frame)
+    \param prevPyr previous frame pyramid
+    \param nextPyr next frame pyramid
+    \param point position in the previous frame
+    \param tracked position in the next frame (its initial value is used as initial guess if 
+    <a>guess</a> is true)
+    \param scratch 5*(2*radius+1)^2 floats
+    \return TRACKING_OK, TRACKING_OUTSIDEBOUNDS if the window does not fit in the previous frame, 
+    TRACKING_EMPTY if it has no texture, or TRACKING_STOPPEDBYBOUNDS if it leaves the next frame
+ 
+    Pyramidal Lucas-Kanade: the displacement found at every level is the initial guess of the 
+    next finer level. The structure tensor G of the window is constant while iterating, so each 
+    iteration only resamples the next frame and solves G*eta = sum (I - J)*[gx gy]'. Coarse levels 
+    where the window does not fit are skipped.
+ */
+static TRACKINGRESULT see_KLTTrackPoint(const KLTTracker& tracker, const Pyramid& prevPyr, const Pyramid& nextPyr,
+                                        Vector2 point, Vector2& tracked, bool guess, float epsi, int maxIter,
+                                        float *scratch)
+{
+    size_t r = tracker.radius, d = 2*r + 1, n = d*d;
+    float *wi = scratch, *wx = wi + n, *wy = wx + n, *wj = wy + n, *diff = wj + n;
+    int top = (int)prevPyr.levels - 1;
+    
+    float scale = 1.0f/(1 << top);
+    Vector2 g = (guess ? (tracked - point)*scale : Vector2(0,0));
+    for (int l=top; l>=0; l--, scale*=2.0f)
+    {
+        size_t w = prevPyr.width[l], h = prevPyr.height[l];
+        Vector2 p = point*scale;
+        float left = p.x - r, up = p.y - r;
+        
+        // window of the previous frame and its gradients
+        if (!see_KLTWindow(see_pyramidLevel(prevPyr, l), w, h, left, up, d, wi) ||
+            !see_KLTWindow(tracker.gx[l], w, h, left, up, d, wx) ||
+            !see_KLTWindow(tracker.gy[l], w, h, left, up, d, wy))
+        {
+            if (l == 0) { tracked = point + g; return TRACKING_OUTSIDEBOUNDS; }
+            g = g*2.0f; continue;
+        }
+        
+        // structure tensor G = [Gxx Gxy; Gxy Gyy] and its smallest eigenvalue
+        float Gxx = 0, Gxy = 0, Gyy = 0;
+        see_dotpr(wx, 1, wx, 1, &Gxx, n);
+        see_dotpr(wx, 1, wy, 1, &Gxy, n);
+        see_dotpr(wy, 1, wy, 1, &Gyy, n);
+        float half = 0.5f*(Gxx - Gyy), detG = Gxx*Gyy - Gxy*Gxy;
+        float minEigen = 0.5f*(Gxx + Gyy) - sqrtf(half*half + Gxy*Gxy);
+        if (minEigen < tracker.minEigen*n || detG <= 0)
+        {
+            if (l == 0) { tracked = point + g; return TRACKING_EMPTY; }
+            g = g*2.0f; continue;
+        }
+        
+        // iterate
+        const float *next = see_pyramidLevel(nextPyr, l);
+        Vector2 v(0,0);
+        bool inside = true;
+        for (int iter=0; iter<maxIter; iter++)
+        {
+            size_t stride = 0;
+            const float *wn = see_sampleWindow(next, w, h, left + g.x + v.x, up + g.y + v.y, d, d, wj, &stride);
+            if (wn == 0) { inside = false; break; }
+            
+            // vsub returns diff = I - J
+            for (size_t k=0; k<d; k++)
+                see_vsub(wn + k*stride, 1, wi + k*d, 1, diff + k*d, 1, d);
+            float bx = 0, by = 0;
+            see_dotpr(wx, 1, diff, 1, &bx, n);
+            see_dotpr(wy, 1, diff, 1, &by, n);
+            Vector2 eta((Gyy*bx - Gxy*by)/detG, (Gxx*by - Gxy*bx)/detG);
+            v = v + eta;
+            if (eta.norm() < epsi) break;
+        }
+        
+        if (!inside && l == 0) { tracked = point + g + v; return TRACKING_STOPPEDBYBOUNDS; }
+        g = (l > 0 ? (g + v)*2.0f : g + v);
+    }
+    
+    tracked = point + g;
+    return TRACKING_OK;
+}
+
+/*! Data shared by the tasks of see_KLTTrackerTrack */
+typedef struct KLTJob
+{
+    const KLTTracker *tracker;
+    const Pyramid *prevPyr, *nextPyr;
+    const Vector2 *points;
+    Vector2 *tracked;
+    TRACKINGRESULT *status;
+    size_t count, tasks;
+    float epsi;
+    int maxIter;
+    bool guess;
+} KLTJob;
+
+/*! Track a contiguous group of points (see_task) */
+static void see_KLTTrackTask(void *context, size_t t)
+{
+    KLTJob &job = *(KLTJob *)context;
+    size_t d = 2*job.tracker->radius + 1;
+    float *scratch = job.tracker->windows + t*5*d*d;
+    size_t first = t*job.count/job.tasks, last = (t + 1)*job.count/job.tasks;
+    for (size_t k=first; k<last; k++)
+        job.status[k] = see_KLTTrackPoint(*job.tracker, *job.prevPyr, *job.nextPyr, job.points[k], 
+                                          job.tracked[k], job.guess, job.epsi, job.maxIter, scratch);
+}
+
+/*! Compute the gradients of every level of the previous frame (if they are not up to date) */
+static void see_KLTTrackerGradients(KLTTracker& tracker)
+{
+    if (tracker.gradients || tracker.prev < 0) return;
+    const Pyramid& prev = tracker.pyramids[tracker.prev];
+    for (size_t l=0; l<prev.levels; l++)
+        see_imageGradients(see_pyramidLevel(prev, l), prev.width[l], prev.height[l], 
+                           tracker.gx[l], tracker.gy[l], tracker.filter);
+    tracker.gradients = true;
+}
+
+/** Prepare a point tracker
+    \param tracker tracker
+    \param width frame width
+    \param height frame height
+    \param levels pyramid levels (including the frame itself)
+    \param radius window radius (windows have (2*radius+1)^2 pixels)
+    \param minEigen smallest eigenvalue of the structure tensor per window pixel (points with 
+    less texture are not tracked)
+    \param threads threads doing work, including the caller
+ 
+    All the memory used by the tracker is allocated here. The previous frame is forgotten.
+ */
+void see_initKLTTracker(KLTTracker& tracker, size_t width, size_t height, size_t levels, 
+                        unsigned int radius, float minEigen, size_t threads)
+{
+    assert(width > 0 && height > 0 && levels > 0 && levels <= SEE_PYRAMID_MAX_LEVELS && threads > 0);
+    assert((width >> (levels - 1)) > 0 && (height >> (levels - 1)) > 0);
+    
+    if (tracker.threads != threads || (threads > 1 && tracker.pool == 0))
+    {
+        see_freeThreadPool(tracker.pool);
+        tracker.pool = (threads > 1 ? see_createThreadPool(threads) : 0);
+    }
+    tracker.threads = threads;
+    tracker.width = width;
+    tracker.height = height;
+    tracker.levels = levels;
+    tracker.radius = radius;
+    tracker.minEigen = minEigen;
+    tracker.prev = -1;
+    tracker.gradients = false;
+    
+    // gradients of every level, corner scores, filtering scratch and window scratch of each task
+    size_t n = width*height, d = 2*radius + 1, tasks = (threads > 1 ? SEE_KLT_MAX_TASKS : 1);
+    size_t gradients = 0;
+    for (size_t l=0; l<levels; l++) gradients += 2*(width >> l)*(height >> l);
+    size_t total = gradients + (4*n + 3*width) + (width + 8 + 2*(height + 6)) + tasks*5*d*d;
+    if (total > tracker.capacity)
+    {
+        free(tracker.data);
+        tracker.data = (float *)malloc(total*sizeof(float));
+        assert(tracker.data != 0);
+        tracker.capacity = total;
+    }
+    
+    float *p = tracker.data;
+    for (size_t l=0; l<levels; l++)
+    {
+        size_t ln = (width >> l)*(height >> l);
+        tracker.gx[l] = p; p += ln;
+        tracker.gy[l] = p; p += ln;
+    }
+    tracker.detect = p; p += 4*n + 3*width;
+    tracker.filter = p; p += width + 8 + 2*(height + 6);
+    tracker.windows = p;
+}
+
+/** Set the previous frame of a point tracker
+    \param tracker tracker (see see_initKLTTracker)
+    \param image normalized frame
+ */
+void see_KLTTrackerSetFrame(KLTTracker& tracker, const img image)
+{
+    assert(tracker.data != 0);
+    int slot = (tracker.prev == 0 ? 1 : 0);
+    see_pyramid(image, tracker.width, tracker.height, tracker.levels, tracker.pyramids[slot], 
+                FILTER_GAUS7, FSIZE_GAUS7, 0);
+    tracker.prev = slot;
+    tracker.gradients = false;
+}
+
+/** Detect corners in the previous frame of a point tracker
+    \param tracker tracker with a previous frame
+    \param corners output corners, by decreasing score
+    \param maxCorners room in <a>corners</a>
+    \param quality minimum score, relative to the best score in the frame
+    \param cell side of the grid cells in pixels (at most one corner per cell)
+    \param radius the structure tensor is summed over (2*radius+1)^2 windows
+    \return number of corners
+ 
+    Same as see_detectCorners, but reuses the gradients the tracker needs anyway. Corners whose 
+    tracking window would not fit in the frame are not returned.
+ */
+size_t see_KLTTrackerDetect(KLTTracker& tracker, Corner *corners, size_t maxCorners,
+                            float quality, size_t cell, unsigned int radius)
+{
+    if (tracker.prev < 0) return 0;
+    see_KLTTrackerGradients(tracker);
+    return see_cornersFromGradients(tracker.gx[0], tracker.gy[0], tracker.width, tracker.height, 
+                                    corners, maxCorners, quality, cell, radius, tracker.radius + 1, 
+                                    tracker.detect);
+}
+
+/** Track points from the previous frame of a point tracker to a new frame
+    \param tracker tracker with a previous frame
+    \param nextIm normalized next frame (it becomes the previous frame)
+    \param points positions in the previous frame
+    \param tracked positions in <a>nextIm</a> (initial guesses if <a>guess</a> is true)
+    \param status result of each point (see see_KLTTrackPoint)
+    \param count number of points
+    \param epsi update threshold to stop iterating (pixels of each level)
+    \param maxIter maximum number of iterations per level
+    \param guess use <a>tracked</a> as initial guess (e.g. predicted from the camera motion)
+    \return number of points tracked (status TRACKING_OK)
+ 
+    If the tracker has no previous frame, <a>nextIm</a> is only kept for the next call.
+ */
+size_t see_KLTTrackerTrack(KLTTracker& tracker, const img nextIm, const Vector2 *points, 
+                           Vector2 *tracked, TRACKINGRESULT *status, size_t count, 
+                           float epsi, int maxIter, bool guess)
+{
+    assert(tracker.data != 0);
+    if (tracker.prev < 0)
+    {
+        for (size_t k=0; k<count; k++) status[k] = TRACKING_OUTSIDEBOUNDS;
+        see_KLTTrackerSetFrame(tracker, nextIm);
+        return 0;
+    }
+    
+    see_KLTTrackerGradients(tracker);
+    int next = (tracker.prev == 0 ? 1 : 0);
+    see_pyramid(nextIm, tracker.width, tracker.height, tracker.levels, tracker.pyramids[next], 
+                FILTER_GAUS7, FSIZE_GAUS7, 0);
+    
+    if (count > 0)
+    {
+        size_t tasks = (tracker.pool != 0 ? (count < SEE_KLT_MAX_TASKS ? count : SEE_KLT_MAX_TASKS) : 1);
+        KLTJob job = {&tracker, &tracker.pyramids[tracker.prev], &tracker.pyramids[next], 
+                      points, tracked, status, count, tasks, epsi, maxIter, guess};
+        see_threadPoolRun(tracker.pool, see_KLTTrackTask, &job, tasks);
+    }
+    
+    tracker.prev = next;
+    tracker.gradients = false;
+    
+    size_t ok = 0;
+    for (size_t k=0; k<count; k++) if (status[k] == TRACKING_OK) ok++;
+    return ok;
+}
+
+/*! Release the memory held by a point tracker */
+void see_freeKLTTracker(KLTTracker& tracker)
+{
+    see_freeThreadPool(tracker.pool);
+    free(tracker.data);
+    for (int s=0; s<2; s++) see_freePyramid(tracker.pyramids[s]);
+    
+    // back to the state of a new tracker (pyramids are not copyable)
+    tracker.width = tracker.height = tracker.levels = 0;
+    tracker.radius = 0;
+    tracker.minEigen = 0;
+    tracker.threads = 1;
+    tracker.pool = 0;
+    tracker.prev = -1;
+    tracker.gradients = false;
+    tracker.capacity = 0;
+    tracker.data = 0;
+}
@@ -0,0 +1,114 @@
+//
+//  ImageFeatures.h
+//  Framework-See
+//
+//	Copyright 2014 Carnegie Mellon University
+//
+//	This work was developed under the Rehabilitation Engineering Research
+//	Center on Accessible Public Transportation (www.rercapt.org) and is funded
+//	by grant number H133E080019 from the United States Department of Education
+//	through the National Institute on Disability and Rehabilitation Research.
+//	No endorsement should be assumed by NIDRR or the United States Government
+//	for the content contained on this code.
+//
+//	Permission is hereby granted, free of charge, to any person obtaining a copy
+//	of this software and associated documentation files (the "Software"), to deal
+//	in the Software without restriction, including without limitation the rights
+//	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//	copies of the Software, and to permit persons to whom the Software is
+//	furnished to do so, subject to the following conditions:
+//
+//	The above copyright notice and this permission notice shall be included in
+//	all copies or substantial portions of the Software.
+//
+//	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//	THE SOFTWARE.
+
+#ifndef IMAGE_FEATURES
+#define IMAGE_FEATURES
+
+#include "ImageTypes.h"
+#include "ImageMotion.h"
+#include <BasicMath/Vector2.h>
+
+#if __cplusplus
+extern "C" {
+#endif
+    
+#pragma mark CORNERS
+    
+    /**
+     Corner found by see_detectCorners
+     */
+    typedef struct Corner
+    {
+        Vector2 pos;                //!< position in the image
+        float score;                //!< smallest eigenvalue of the structure tensor around <a>pos</a>
+    } Corner;
+    
+/*! Scratch floats needed by see_detectCorners */
+#define see_detectCornersBufferSize(width, height) (6*(width)*(height) + 4*(width) + 2*(height) + 20)
+    
+    size_t see_detectCorners(const img image, size_t width, size_t height, Corner *corners, size_t maxCorners,
+                             float quality = 0.01, size_t cell = 8, unsigned int radius = 2, float *buffer = NULL);
+    
+#pragma mark POINT TRACKING
+    
+#define SEE_KLT_MAX_TASKS 16        //!< maximum number of concurrent tasks of a KLTTracker
+    
+    /**
+     Sparse pyramidal Lucas-Kanade point tracker for a stream of frames of the same size. It keeps 
+     the pyramid of the previous frame (built by see_pyramid) and the FILTER_GAUSDERIV7 gradients 
+     of all its levels, so each new frame builds one pyramid and the gradients are shared by every 
+     point and by see_KLTTrackerDetect. Memory is allocated by see_initKLTTracker only. 
+     Release with see_freeKLTTracker.
+     
+     With more than one thread, points are split into groups tracked concurrently by a pool.
+     */
+    typedef struct KLTTracker
+    {
+        size_t width, height;       //!< frame size
+        size_t levels;              //!< pyramid levels
+        unsigned int radius;        //!< window radius (windows have (2*radius+1)^2 pixels)
+        float minEigen;             //!< smallest eigenvalue per window pixel of a trackable point
+        size_t threads;             //!< threads doing work (including the caller)
+        struct ThreadPool *pool;    //!< workers (NULL with a single thread)
+        Pyramid pyramids[2];        //!< previous and next frame pyramids (they swap roles)
+        int prev;                   //!< slot holding the previous frame (-1 if there is none)
+        bool gradients;             //!< <a>gx</a> and <a>gy</a> hold the gradients of the previous frame
+        size_t capacity;            //!< floats in <a>data</a>
+        float *data;                //!< workspace holding the arrays below
+        float *gx[SEE_PYRAMID_MAX_LEVELS];  //!< horizontal gradient of each level of the previous frame
+        float *gy[SEE_PYRAMID_MAX_LEVELS];  //!< vertical gradient of each level of the previous frame
+        float *detect;              //!< corner detection scratch
+        float *filter;              //!< gradient filtering scratch
+        float *windows;             //!< window scratch of each task
+        
+        KLTTracker() : width(0), height(0), levels(0), radius(0), minEigen(0), threads(1), pool(0), 
+                       prev(-1), gradients(false), capacity(0), data(0) {}
+    } KLTTracker;
+    
+    void see_initKLTTracker(KLTTracker& tracker, size_t width, size_t height, size_t levels = 3, 
+                            unsigned int radius = 7, float minEigen = 0.00001, size_t threads = 1);
+    
+    void see_KLTTrackerSetFrame(KLTTracker& tracker, const img image);
+    
+    size_t see_KLTTrackerDetect(KLTTracker& tracker, Corner *corners, size_t maxCorners,
+                                float quality = 0.01, size_t cell = 8, unsigned int radius = 2);
+    
+    size_t see_KLTTrackerTrack(KLTTracker& tracker, const img nextIm, const Vector2 *points, 
+                               Vector2 *tracked, TRACKINGRESULT *status, size_t count, 
+                               float epsi = 0.01, int maxIter = 20, bool guess = false);
+    
+    void see_freeKLTTracker(KLTTracker& tracker);
+    
+#if __cplusplus
+}
+#endif
+
+#endif
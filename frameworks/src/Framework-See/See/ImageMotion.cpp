@@ -32,8 +32,13 @@
 
 #include "ImageMotion.h"
 #include "ImageConversion.h"
-#include <Accelerate/Accelerate.h>
+#include "SeeVector.h"
+#include "SeeSIMD.h"
+#include "SeeThreadPool.h"
 #include <assert.h>
+#include <limits.h>
+#include <math.h>
+#include <string.h>
 
 //#define PERFORM_SANITY_CHECKS
 
@@ -52,8 +57,8 @@
 //    float width = right - left;
 //    float height = bottom - top;
 //    
-//    vDSP_Length windowWRound = roundf(width);
-//    vDSP_Length windowHRound = roundf(height);
+//    size_t windowWRound = roundf(width);
+//    size_t windowHRound = roundf(height);
 //    size_t length = windowWRound*windowHRound;
 //    
 //    img window = (float *)calloc(length,sizeof(float));
@@ -61,7 +66,7 @@
 //    // horizontal interpolation    
 //    float *ramp = (float *)malloc(sizeof(float)*windowWRound);
 //    float increment = 1; 
-//    vDSP_vramp(&left, &increment, ramp, 1, windowWRound);
+//    see_vramp(&left, &increment, ramp, 1, windowWRound);
 //    
 //    int toprow = floor(top);
 //    int botrow = (ceil(bottom) == bottom ? bottom + 1 : bottom);
@@ -71,7 +76,7 @@
 //    
 //    for (int r=toprow; r < toprow + rowstocopy; r++)
 //    {
-//        vDSP_vlint(image + r*w, ramp, 1, 
+//        see_vlint(image + r*w, ramp, 1, 
 //                   tmpIm + (r - toprow), rowstocopy, windowWRound, w);
 //    }
 //    free(ramp);
@@ -79,11 +84,11 @@
 //    // vertical interpolation
 //    ramp = (float *)malloc(sizeof(float)*windowHRound);
 //    float initval = top - toprow;
-//    vDSP_vramp(&initval, &increment, ramp, 1, windowHRound);
+//    see_vramp(&initval, &increment, ramp, 1, windowHRound);
 //    
 //    for (int c=0; c < windowHRound; c++)
 //    {
-//        vDSP_vlint(tmpIm + rowstocopy*c, ramp, 1, 
+//        see_vlint(tmpIm + rowstocopy*c, ramp, 1, 
 //                   window + c, windowWRound, windowHRound, rowstocopy);
 //    }
 //    free(ramp);
@@ -177,10 +182,10 @@ TRACKINGRESULT see_LKTemplateMatching(size_t width, size_t height, img prevIm, i
     // compute the Hessian matrix
     // H = [Hxx Hxy; Hyx Hyy] = [gx gy]'*[gx gy]
     float Hxx = 0, Hxy = 0, Hyx = 0, Hyy = 0;
-    vDSP_dotpr(gx, 1, gx, 1, &Hxx, tempLength);
-    vDSP_dotpr(gx, 1, gy, 1, &Hxy, tempLength);
-    vDSP_dotpr(gy, 1, gx, 1, &Hyx, tempLength);
-    vDSP_dotpr(gy, 1, gy, 1, &Hyy, tempLength);
+    see_dotpr(gx, 1, gx, 1, &Hxx, tempLength);
+    see_dotpr(gx, 1, gy, 1, &Hxy, tempLength);
+    see_dotpr(gy, 1, gx, 1, &Hyx, tempLength);
+    see_dotpr(gy, 1, gy, 1, &Hyy, tempLength);
     // find H^{-1}
     float detH = Hxx*Hyy - Hxy*Hyx;
     float invH[2][2] = {{ Hyy/detH, -Hxy/detH},
@@ -213,8 +218,8 @@ TRACKINGRESULT see_LKTemplateMatching(size_t width, size_t height, img prevIm, i
         
         // subtract enlarged match box and template
         // vsub returns diff = match - tempIm
-        vDSP_vsub(tempIm, 1, match, 1, diff, 1, tempLength);
-//        vDSP_vsub(match, 1, tempIm, 1,  diff, 1, tempLength);
+        see_vsub(tempIm, 1, match, 1, diff, 1, tempLength);
+//        see_vsub(match, 1, tempIm, 1,  diff, 1, tempLength);
 //#ifdef PERFORM_SANITY_CHECKS
 //        float sumDiff = 0;
 //        vDSP_sve (diff, 1, &sumDiff, tempLength);
@@ -223,8 +228,8 @@ TRACKINGRESULT see_LKTemplateMatching(size_t width, size_t height, img prevIm, i
         
         // update delta
         float dx = 0, dy = 0;
-        vDSP_dotpr(gx, 1, diff, 1, &dx, tempLength);
-        vDSP_dotpr(gy, 1, diff, 1, &dy, tempLength);
+        see_dotpr(gx, 1, diff, 1, &dx, tempLength);
+        see_dotpr(gy, 1, diff, 1, &dy, tempLength);
         delta.x = -invH[0][0]*dx -invH[0][1]*dy;
         delta.y = -invH[1][0]*dx -invH[1][1]*dy;
 //        delta.x = invH[0][0]*dx +invH[0][1]*dy;
@@ -244,7 +249,7 @@ TRACKINGRESULT see_LKTemplateMatching(size_t width, size_t height, img prevIm, i
         float ssdRow = 0;
         for (int r = 0; r<tempHRound; r++)
         {
-            vDSP_svesq(diff + margin + r*tempWRound, 1, &ssdRow, tempWRound);
+            see_svesq(diff + margin + r*tempWRound, 1, &ssdRow, tempWRound);
             *ssd += ssdRow;
         }
         
@@ -272,6 +277,50 @@ TRACKINGRESULT see_LKTemplateMatching(size_t width, size_t height, img prevIm, i
     
 }
 
+/** Template window and gradients of a box, as see_LKTemplateMatching hands them back
+    \param width prevIm width
+    \param height prevIm height
+    \param prevIm normalized image holding the template
+    \param box template box
+    \param gradX template x gradient (or NULL)
+    \param gradY template y gradient (or NULL)
+    \param tmpl template with the margin needed by the derivative filter (or NULL)
+    \param tmplEnlargedBox box of <a>tmpl</a> (or NULL)
+ 
+    The outputs are left untouched if the window cannot be extracted.
+ */
+static void see_LKTemplateWindows(size_t width, size_t height, img prevIm, Rectangle box, 
+                                  img* gradX, img* gradY, img *tmpl, Rectangle* tmplEnlargedBox)
+{
+    if (gradX == 0 && gradY == 0 && tmpl == 0 && tmplEnlargedBox == 0) return;
+    
+    unsigned int margin = floor(FSIZE_GAUSDERIV7/2);
+    Rectangle enlargedBox;
+    img tempIm = see_extractWindow(width, height, prevIm, box, margin, &enlargedBox);
+    if (tempIm == 0) return;
+    
+    if (gradX != 0 || gradY != 0)
+    {
+        Vector2 gxSize(0,0), gySize(0,0);
+        int tempWRound = int(roundf(box.width())), tempHRound = int(roundf(box.height()));
+        int enlargedWRound = int(roundf(enlargedBox.width())), enlargedHRound = int(roundf(enlargedBox.height()));
+        img gx = see_convolveHor(tempIm + margin*enlargedWRound, enlargedWRound, tempHRound, enlargedWRound, 
+                                 FILTER_GAUSDERIV7, FSIZE_GAUSDERIV7, &gxSize, margin);
+        img gy = see_convolveVer(tempIm + margin, tempWRound, enlargedHRound, enlargedWRound, 
+                                 FILTER_GAUSDERIV7, FSIZE_GAUSDERIV7, &gySize, margin);
+        
+        if (gradX == 0) free(gx); 
+        else { if (*gradX != 0) free(*gradX); *gradX = gx; }
+        
+        if (gradY == 0) free(gy);
+        else { if (*gradY != 0) free(*gradY); *gradY = gy; }
+    }
+    
+    if (tmpl == 0) free(tempIm);
+    else { if (*tmpl != 0) free(*tmpl); *tmpl = tempIm; }
+    if (tmplEnlargedBox != 0) *tmplEnlargedBox = enlargedBox;
+}
+
 /** Track template window in image
     \param width prev,next images width
     \param height prev,next images height
@@ -281,15 +330,22 @@ TRACKINGRESULT see_LKTemplateMatching(size_t width, size_t height, img prevIm, i
     \param minTracked % of the templateBox that should be tracked (value must be in (0, 1])
     \param motion template motion from prevIm to nextIm
     \param epsi motion update threshold to stop looking for the template
+    \param iterations Gauss-Newton iterations done over all the crops of the box
+    \param gradX, gradY, tmpl, tmplEnlargedBox gradients and enlarged window of the part of the template 
+    that was tracked, in the layout of see_LKTemplateMatching (or NULL)
     \return tracking result (ok, template outside bounds or failure)
 
-    The displacement <a>motion</a> is always initialized with (0,0), so its original 
-    value doesn't matter when the function is called. If the template box
+    The initial value of <a>motion</a> is used as initial displacement of the template box 
+    (the pyramidal trackers pass the motion found in the coarser level, and the camera passes the 
+    motion predicted by the gyro, see see_gyroPredictorRotation). If the template box
     falls outside bounds while tracking, then its dimensions get reduced, up to the point
     where its length or width are less than its original size times <a>minTracked</a>.
     For example, if the initial size of the box is 40x30 and <a>minTracked</a> is 0.5, 
     the box can get reduced up until its size is 20x15. If a smaller box is needed to 
     successfully track the template, then the procedure fails with TRACKING_STOPPEDBYBOUNDS.
+    The part of the template box inside prevIm is prepared once with see_setLKTemplate and tracked 
+    with see_LKTemplateTrackFlexible, whichever outputs are requested; if it cannot be prepared 
+    (e.g. it has no texture), its result is returned untracked.
 
     LKTemplateMatching may return one of the following codes:
     TRACKING_OK - tracking processed finished without inconvenients
@@ -304,102 +360,1371 @@ TRACKINGRESULT see_FlexibleLKTemplateMatching(size_t width, size_t height, img p
                                               Rectangle templateBox, float minTracked, Vector2 &motion, 
                                               Vector2 *leftMotion, float *ssd, float epsi, int maxIter, 
                                               img* gradX, img* gradY, img *tmpl, Rectangle* tmplEnlargedBox,
-                                              img *trackedEnlarged, Rectangle* trackedEnlargedBox)
+                                              img *trackedEnlarged, Rectangle* trackedEnlargedBox,
+                                              int *iterations)
 {
 //#ifdef PERFORM_SANITY_CHECKS
 //    assert(minTracked > 0 && minTracked <= 1);
 //#endif
     
+    if (iterations != 0) *iterations = 0;
+    
     unsigned int margin = floor(FSIZE_GAUSDERIV7/2); 
     Vector2 centerPt = templateBox.center();
     if (centerPt.x >= width - margin || centerPt.x < margin ||
         centerPt.y >= height - margin || centerPt.y < margin)
         return TRACKING_OUTSIDEBOUNDS;
     
-    Rectangle box = templateBox, trackedBox = templateBox;
-//    float minWidth = box.size.x * minTracked;
-//    float minHeight = box.size.y * minTracked;
-    TRACKINGRESULT result;
-    float outside;
+    // a template that does not fit in prevIm is first cropped to it (its center is inside)
+    Rectangle box = templateBox;
+    float outside = round(box.left() - margin*2);
+    if (outside < 0) { box.size.x += outside; box.origin.x -= outside; }
+    outside = round((width - 1 - margin*2) - box.right());
+    if (outside < 0) box.size.x += outside;
+    outside = round(box.top() - margin*2);
+    if (outside < 0) { box.size.y += outside; box.origin.y -= outside; }
+    outside = round((height - 1 - margin*2) - box.bottom());
+    if (outside < 0) box.size.y += outside;
+    
+    // gradients are computed once and the box is cropped inside the template (see see_LKTemplateTrackFlexible)
+    LKTemplate lkTemplate;
+    Rectangle trackedBox;
+    TRACKINGRESULT result = see_setLKTemplate(lkTemplate, width, height, prevIm, box);
+    if (result != TRACKING_OK)
+    {
+        see_freeLKTemplate(lkTemplate);
+        return result;
+    }
+    result = see_LKTemplateTrackFlexible(lkTemplate, width, height, nextIm, motion, leftMotion, ssd, 
+                                         epsi, maxIter, &trackedBox, iterations);
+    see_freeLKTemplate(lkTemplate);
+    
+    see_LKTemplateWindows(width, height, prevIm, trackedBox, gradX, gradY, tmpl, tmplEnlargedBox);
+    
+    Rectangle enlargedMatchBox;
+    img match = 0;
+    if (result == TRACKING_OK && (trackedEnlarged != 0 || trackedEnlargedBox != 0))
+    {
+        trackedBox.origin = trackedBox.origin + motion;
+        match = see_extractWindow(width, height, nextIm, trackedBox, margin, &enlargedMatchBox);
+    }
+    if (trackedEnlarged == 0) { if (match != 0) free(match); }
+    else { if (*trackedEnlarged != 0) free(*trackedEnlarged); *trackedEnlarged = match; }
+    if (trackedEnlargedBox != 0) *trackedEnlargedBox = enlargedMatchBox;
+    
+    return result;
+}
+
+#pragma mark Inverse compositional template matching
+
+/*! Does a window and its margin fit in an image? (same test as see_extractWindow) */
+static inline bool see_LKWindowFits(const Rectangle& rect, unsigned int margin, size_t width, size_t height)
+{
+    return !(rect.left() - margin < 0 || rect.top() - margin < 0 || 
+             rect.right() + margin >= width-2 || rect.bottom() + margin >= height-2);
+}
+
+#define LK_MIN_DETH 1e-12f     //!< smallest determinant of a template Hessian that is inverted
+
+/** Prepare a template for inverse-compositional tracking
+    \param tmpl template (its workspace is reused if large enough)
+    \param width prevIm width
+    \param height prevIm height
+    \param prevIm normalized image holding the template
+    \param templateBox template in prevIm
+    \return TRACKING_OK, TRACKING_OUTSIDEBOUNDS if the template cannot be extracted, or 
+    TRACKING_EMPTY if its Hessian cannot be inverted (the template has no texture)
+ 
+    Samples the template, computes its gradients and inverts its Hessian. Same values as 
+    see_LKTemplateMatching computes at the beginning of every call.
+ */
+TRACKINGRESULT see_setLKTemplate(LKTemplate& tmpl, size_t width, size_t height, const img prevIm,
+                                 Rectangle templateBox)
+{
+    unsigned int margin = floor(FSIZE_GAUSDERIV7/2);
+    size_t ew = roundf(templateBox.width() + 2*margin), eh = roundf(templateBox.height() + 2*margin);
+    if (prevIm == 0 || ew <= 2*margin || eh <= 2*margin) return TRACKING_OUTSIDEBOUNDS;
+    size_t tw = ew - 2*margin, th = eh - 2*margin, n = tw*th;
+    
+    // workspace: five template-sized arrays, the enlarged template and row pointers
+    size_t scratchSize = ew*eh + (eh*sizeof(float*) + sizeof(float) - 1)/sizeof(float);
+    size_t total = 5*n + scratchSize;
+    if (total > tmpl.capacity)
+    {
+        free(tmpl.data);
+        tmpl.data = (float *)malloc(total*sizeof(float));
+        assert(tmpl.data != 0);
+        tmpl.capacity = total;
+    }
+    tmpl.tmpl = tmpl.data;
+    tmpl.gx = tmpl.tmpl + n;
+    tmpl.gy = tmpl.gx + n;
+    tmpl.warped = tmpl.gy + n;
+    tmpl.diff = tmpl.warped + n;
+    tmpl.scratch = tmpl.diff + n;
+    tmpl.box = templateBox;
+    tmpl.width = tw;
+    tmpl.height = th;
+    tmpl.warpParams = 0;
+    
+    // template with the margin needed by the derivative filter (a view into prevIm if it is aligned to pixels)
+    size_t stride = 0;
+    const float *enlarged = 0;
+    if (see_LKWindowFits(templateBox, margin, width, height))
+        enlarged = see_sampleWindow(prevIm, width, height, templateBox.left() - margin, templateBox.top() - margin,
+                                    ew, eh, tmpl.scratch, &stride);
+    if (enlarged == 0)
+    {
+        tmpl.width = tmpl.height = 0;
+        return TRACKING_OUTSIDEBOUNDS;
+    }
+    const float **rows = (const float **)(tmpl.scratch + ew*eh);
+    for (size_t r=0; r<th; r++)
+        see_scopy((int)tw, enlarged + (r + margin)*stride + margin, 1, tmpl.tmpl + r*tw, 1);
+    
+    // gradients of the template (valid part of see_convolveHor and see_convolveVer)
+    const float *filterAddr = FILTER_GAUSDERIV7 + FSIZE_GAUSDERIV7 - 1;
+    for (size_t r=0; r<th; r++)
+        see_conv(enlarged + (r + margin)*stride, 1, filterAddr, -1, tmpl.gx + r*tw, 1, tw, FSIZE_GAUSDERIV7);
+    for (size_t r=0; r<eh; r++) rows[r] = enlarged + r*stride + margin;
+    see_convVer(rows, 1, filterAddr, -1, tmpl.gy, tw, tw, th, FSIZE_GAUSDERIV7);
+    
+    // H = [Hxx Hxy; Hyx Hyy] = [gx gy]'*[gx gy]
+    float Hxx = 0, Hxy = 0, Hyy = 0;
+    see_dotpr(tmpl.gx, 1, tmpl.gx, 1, &Hxx, n);
+    see_dotpr(tmpl.gx, 1, tmpl.gy, 1, &Hxy, n);
+    see_dotpr(tmpl.gy, 1, tmpl.gy, 1, &Hyy, n);
+    float detH = Hxx*Hyy - Hxy*Hxy;
+    if (!(fabsf(detH) > LK_MIN_DETH))
+    {
+        // no texture to track (e.g., a flat template)
+        tmpl.width = tmpl.height = 0;
+        return TRACKING_EMPTY;
+    }
+    tmpl.invH[0][0] =  Hyy/detH; tmpl.invH[0][1] = -Hxy/detH;
+    tmpl.invH[1][0] = -Hxy/detH; tmpl.invH[1][1] =  Hxx/detH;
+    
+    return TRACKING_OK;
+}
+
+/** Track the sub-box of a template given by columns [c0, c0+sw) and rows [r0, r0+sh)
+    \param invH inverse of the Hessian of the sub-box
+ 
+    Same iteration as see_LKTemplateTrack, restricted to a part of the template arrays. The 
+    sub-box starts at its position in <a>tmpl</a>.box displaced by <a>motion</a>.
+ */
+static TRACKINGRESULT see_LKTemplateTrackRegion(LKTemplate& tmpl, size_t c0, size_t r0, size_t sw, size_t sh,
+                                                const float invH[2][2], size_t width, size_t height, 
+                                                const img nextIm, Vector2 &motion, Vector2 *leftMotion, 
+                                                float *ssd, float epsi, int maxIter, int *iterations)
+{
+    unsigned int margin = floor(FSIZE_GAUSDERIV7/2);
+    size_t tw = tmpl.width, n = sw*sh;
+    const float *gx = tmpl.gx + r0*tw + c0, *gy = tmpl.gy + r0*tw + c0, *t = tmpl.tmpl + r0*tw + c0;
     
+    Vector2 delta(0,0);
+    Rectangle matchBox = tmpl.box;
+    if (sw != tw || sh != tmpl.height)
+    {
+        matchBox.origin = matchBox.origin + Vector2(c0, r0);
+        matchBox.size = Vector2(sw, sh);
+    }
+    matchBox.origin = matchBox.origin + motion;
+    TRACKINGRESULT result = TRACKING_OK;
     int iter = 0;
-    while( iter < maxIter ) 
-    {  
-        result = see_LKTemplateMatching(width, height, prevIm, nextIm, 
-                                        box, motion, leftMotion, ssd, 
-                                        epsi, maxIter, gradX, gradY, 
-                                        tmpl, tmplEnlargedBox,
-                                        trackedEnlarged, trackedEnlargedBox);
-        
-//        std::cout << "tracked " << box << " with status " << result 
-//            << " motion " << motion << std::endl;
-
-        if (result == TRACKING_EMPTY || result == TRACKING_OK)
+    do {
+        
+        // update motion and match
+        motion = motion + delta;
+        matchBox.origin = matchBox.origin + delta;
+        
+        // stop if we reached a bound
+        const float *warped = 0;
+        size_t stride = 0;
+        if (see_LKWindowFits(matchBox, margin, width, height))
+            warped = see_sampleWindow(nextIm, width, height, matchBox.left(), matchBox.top(), 
+                                      sw, sh, tmpl.warped, &stride);
+        if (warped == 0)
+        {
+            motion = motion - delta;
+            result = TRACKING_STOPPEDBYBOUNDS; break;
+        }
+        
+        // vsub returns diff = warped - tmpl
+        for (size_t r=0; r<sh; r++)
+            see_vsub(t + r*tw, 1, warped + r*stride, 1, tmpl.diff + r*sw, 1, sw);
+        
+        // update delta (gradients are contiguous unless the sub-box is narrower than the template)
+        float dx = 0, dy = 0;
+        if (sw == tw)
+        {
+            see_dotpr(gx, 1, tmpl.diff, 1, &dx, n);
+            see_dotpr(gy, 1, tmpl.diff, 1, &dy, n);
+        }
+        else
+        {
+            float rx, ry;
+            for (size_t r=0; r<sh; r++)
+            {
+                see_dotpr(gx + r*tw, 1, tmpl.diff + r*sw, 1, &rx, sw);
+                see_dotpr(gy + r*tw, 1, tmpl.diff + r*sw, 1, &ry, sw);
+                dx += rx; dy += ry;
+            }
+        }
+        delta.x = -invH[0][0]*dx -invH[0][1]*dy;
+        delta.y = -invH[1][0]*dx -invH[1][1]*dy;
+        
+        iter ++;
+        
+    } while (delta.norm() > epsi && iter <= maxIter);
+    
+    // the residual is only available if a match could be sampled
+    if (ssd != 0 && iter > 0) see_svesq(tmpl.diff, 1, ssd, n);
+    if (leftMotion != 0) *leftMotion = delta;
+    if (iterations != 0) *iterations = iter;
+    
+    return result;
+}
+
+/** Track a template prepared with see_setLKTemplate (inverse compositional)
+    \param tmpl template
+    \param width nextIm width
+    \param height nextIm height
+    \param nextIm normalized next image
+    \param motion template motion from the template's image to nextIm (its initial value is 
+    used as initial displacement)
+    \param leftMotion last update, which was not applied to <a>motion</a> (or NULL)
+    \param ssd sum of squared differences between the template and its match (or NULL; unchanged if no match could be sampled)
+    \param epsi motion update threshold to stop looking for the template
+    \param maxIter maximum number of iterations
+    \param iterations iterations run (or NULL)
+    \return tracking result (same codes as see_LKTemplateMatching)
+ 
+    For a translation, composing the inverse of the incremental warp amounts to subtracting 
+    H^{-1} [gx gy]' (I(x + motion) - T(x)), where the gradients and the Hessian are those of the 
+    template. Every iteration only resamples the next image into <a>tmpl</a>.warped (or reads it 
+    in place when the box is aligned to pixels).
+ */
+TRACKINGRESULT see_LKTemplateTrack(LKTemplate& tmpl, size_t width, size_t height, const img nextIm, 
+                                   Vector2 &motion, Vector2 *leftMotion, float *ssd,
+                                   float epsi, int maxIter, int *iterations)
+{
+    if (tmpl.width == 0 || tmpl.height == 0) return TRACKING_OUTSIDEBOUNDS;
+    return see_LKTemplateTrackRegion(tmpl, 0, 0, tmpl.width, tmpl.height, tmpl.invH, width, height, nextIm, 
+                                     motion, leftMotion, ssd, epsi, maxIter, iterations);
+}
+
+/** Add the Hessian terms of the template region given by columns [c0, c0+sw) and rows [r0, r0+sh)
+    \param h Hxx, Hxy and Hyy accumulated in double, since strips get subtracted from the whole template
+    \param sign 1 to add the region, -1 to remove it
+ */
+static void see_LKAddRegionHessian(const LKTemplate& tmpl, size_t c0, size_t r0, size_t sw, size_t sh, 
+                                   double h[3], double sign)
+{
+    if (sw == 0 || sh == 0) return;
+    size_t tw = tmpl.width;
+    float xx, xy, yy;
+    for (size_t r=r0; r<r0+sh; r++)
+    {
+        const float *gx = tmpl.gx + r*tw + c0, *gy = tmpl.gy + r*tw + c0;
+        see_dotpr(gx, 1, gx, 1, &xx, sw);
+        see_dotpr(gx, 1, gy, 1, &xy, sw);
+        see_dotpr(gy, 1, gy, 1, &yy, sw);
+        h[0] += sign*xx; h[1] += sign*xy; h[2] += sign*yy;
+    }
+}
+
+/** Track a template prepared with see_setLKTemplate, shrinking it when it falls outside bounds
+    \param tmpl template
+    \param width nextIm width
+    \param height nextIm height
+    \param nextIm normalized next image
+    \param motion template motion (its initial value is used as initial displacement)
+    \param leftMotion last update, which was not applied to <a>motion</a> (or NULL)
+    \param ssd sum of squared differences between the tracked part of the template and its match (or NULL; unchanged if no match could be sampled)
+    \param epsi motion update threshold to stop looking for the template
+    \param maxIter maximum number of iterations (also bounds the number of shrinks)
+    \param trackedBox part of the template that was tracked, in the template's image (or NULL)
+    \param iterations iterations run over all shrinks (or NULL)
+    \return tracking result (same codes as see_FlexibleLKTemplateMatching)
+ 
+    When tracking stops by bounds, the box is cropped to the part of the template that would stay 
+    inside the image after the rejected update and tracking resumes from the current motion. The sub-box is a 
+    range of rows and columns of the template arrays, so the gradients are never recomputed: 
+    the Hessian of the sub-box is that of the previous box minus the strips that were cropped. 
+    Tracking stops with TRACKING_EMPTY (keeping the previous box and motion) if the sub-box has no 
+    texture left.
+ */
+TRACKINGRESULT see_LKTemplateTrackFlexible(LKTemplate& tmpl, size_t width, size_t height, const img nextIm, 
+                                           Vector2 &motion, Vector2 *leftMotion, float *ssd,
+                                           float epsi, int maxIter, Rectangle *trackedBox, int *iterations)
+{
+    if (tmpl.width == 0 || tmpl.height == 0) return TRACKING_OUTSIDEBOUNDS;
+    
+    unsigned int margin = floor(FSIZE_GAUSDERIV7/2);
+    size_t tw = tmpl.width, th = tmpl.height;
+    Vector2 centerPt = tmpl.box.center() - tmpl.box.origin;
+    
+    // current sub-box: columns [c0, c1) and rows [r0, r1) of the template
+    size_t c0 = 0, c1 = tw, r0 = 0, r1 = th;
+    double h[3] = {0, 0, 0};
+    float invH[2][2];
+    memcpy(invH, tmpl.invH, sizeof(invH));
+    
+    TRACKINGRESULT result = TRACKING_OUTSIDEBOUNDS;
+    Vector2 left(0,0);
+    int total = 0, iter = 0, shrinks = 0;
+    while (shrinks < maxIter)
+    {
+        result = see_LKTemplateTrackRegion(tmpl, c0, r0, c1 - c0, r1 - r0, invH, width, height, nextIm, 
+                                           motion, &left, ssd, epsi, maxIter, &iter);
+        total += iter;
+        
+        if (result != TRACKING_STOPPEDBYBOUNDS)
             break;
         
-        // tracking stopped by bounds
-        trackedBox.origin = templateBox.origin + motion;
+        // crop the template to the rows and columns that stay inside bounds at the rejected update
+        Vector2 next = tmpl.box.origin + motion + left;
+        float outside;
+        size_t nc0 = c0, nc1 = c1, nr0 = r0, nr1 = r1;
+        
+        outside = round(next.x - margin*2);
+        if (outside < 0) nc0 = fmaxf(nc0, -outside);
+        
+        outside = round((width - 1 - margin*2) - (next.x + tmpl.box.width()));
+        if (outside < 0) nc1 = fminf(nc1, fmaxf(0, tw + outside));
+        
+        outside = round(next.y - margin*2);
+        if (outside < 0) nr0 = fmaxf(nr0, -outside);
         
-        outside = round(trackedBox.left() - margin*2);
-        if (outside < 0) 
-        {   box.size.x += outside; 
-            box.origin.x -= outside; 
-//            std::cout << "shrink left outside ( " << outside << " ) " << box << std::endl;
+        outside = round((height - 1 - margin*2) - (next.y + tmpl.box.height()));
+        if (outside < 0) nr1 = fminf(nr1, fmaxf(0, th + outside));
+        
+        if (nc0 > centerPt.x || nc1 < centerPt.x || nr0 > centerPt.y || nr1 < centerPt.y ||
+            nc1 <= nc0 || nr1 <= nr0)
+        {
+            result = TRACKING_OUTSIDEBOUNDS;
+            break;
+        }
+        
+        // nothing left to crop
+        if (nc0 == c0 && nc1 == c1 && nr0 == r0 && nr1 == r1)
+            break;
+        
+        // H of the sub-box = H of the box - cropped rows - cropped columns of the remaining rows
+        if (shrinks == 0)
+            see_LKAddRegionHessian(tmpl, 0, 0, tw, th, h, 1.0);
+        see_LKAddRegionHessian(tmpl, c0, r0, c1 - c0, nr0 - r0, h, -1.0);
+        see_LKAddRegionHessian(tmpl, c0, nr1, c1 - c0, r1 - nr1, h, -1.0);
+        see_LKAddRegionHessian(tmpl, c0, nr0, nc0 - c0, nr1 - nr0, h, -1.0);
+        see_LKAddRegionHessian(tmpl, nc1, nr0, c1 - nc1, nr1 - nr0, h, -1.0);
+        
+        // the cropped box may have no texture left (H is positive semidefinite, so a negative 
+        // determinant only comes from cancellation)
+        double detH = h[0]*h[2] - h[1]*h[1];
+        if (!(detH > LK_MIN_DETH))
+        {
+            result = TRACKING_EMPTY;
+            break;
         }
+        c0 = nc0; c1 = nc1; r0 = nr0; r1 = nr1;
         
-        outside = round((width - 1 - margin*2) - trackedBox.right());
-        if (outside < 0)
-        {   box.size.x += outside; 
-//            std::cout << "shrink right outside ( " << outside << " ) " << box << std::endl;
+        invH[0][0] =  h[2]/detH; invH[0][1] = -h[1]/detH;
+        invH[1][0] = -h[1]/detH; invH[1][1] =  h[0]/detH;
+        
+        shrinks++;
+    }
+    
+    if (trackedBox != 0)
+    {
+        *trackedBox = tmpl.box;
+        if (c1 - c0 != tw || r1 - r0 != th)
+        {
+            trackedBox->origin = trackedBox->origin + Vector2(c0, r0);
+            trackedBox->size = Vector2(c1 - c0, r1 - r0);
         }
+    }
+    if (leftMotion != 0) *leftMotion = left;
+    if (iterations != 0) *iterations = total;
+    
+    return result;
+}
+
+/** Track template window in image (inverse compositional)
+    \param width prev,next images width
+    \param height prev,next images height
+    \param prevIm normalized previous image
+    \param nextIm normalized next image
+    \param templateBox template in prevIm (should fit inside the image)
+    \param motion template motion from prevIm to nextIm (its initial value is used as initial displacement)
+    \param leftMotion last update, which was not applied to <a>motion</a> (or NULL)
+    \param ssd sum of squared differences between the template and its match (or NULL)
+    \param epsi motion update threshold to stop looking for the template
+    \param maxIter maximum number of iterations
+    \return tracking result (same codes as see_LKTemplateMatching)
+ 
+    Same iteration as see_LKTemplateMatching, but nothing is allocated inside the loop. Keep a 
+    LKTemplate and call see_setLKTemplate/see_LKTemplateTrack directly to also reuse the workspace 
+    between frames, or to track the same template in several images.
+ */
+TRACKINGRESULT see_ICLKTemplateMatching(size_t width, size_t height, img prevIm, img nextIm,
+                                        Rectangle templateBox, Vector2 &motion, 
+                                        Vector2 *leftMotion, float *ssd, float epsi, int maxIter)
+{
+    LKTemplate tmpl;
+    TRACKINGRESULT result = see_setLKTemplate(tmpl, width, height, prevIm, templateBox);
+    if (result == TRACKING_OK)
+        result = see_LKTemplateTrack(tmpl, width, height, nextIm, motion, leftMotion, ssd, epsi, maxIter);
+    see_freeLKTemplate(tmpl);
+    
+    return result;
+}
+
+/*! Release the workspace of a template
+    \param tmpl template (it can be set again with see_setLKTemplate)
+ */
+void see_freeLKTemplate(LKTemplate& tmpl)
+{
+    free(tmpl.data);
+    free(tmpl.steepest);
+    tmpl = LKTemplate();
+}
+
+#pragma mark Warped template matching
+
+/*! Invert a symmetric positive definite matrix (Gauss-Jordan in double precision)
+    \param a matrix (n*n)
+    \param inv inverse (n*n)
+    \param n size (at most 8)
+    \return false if the matrix is singular
+ */
+static bool see_LKInvertHessian(const double *a, float *inv, int n)
+{
+    double m[8][16];
+    for (int i=0; i<n; i++)
+        for (int j=0; j<n; j++) { m[i][j] = a[i*n+j]; m[i][n+j] = (i == j ? 1.0 : 0.0); }
+    
+    for (int c=0; c<n; c++)
+    {
+        int p = c;
+        for (int r=c+1; r<n; r++) if (fabs(m[r][c]) > fabs(m[p][c])) p = r;
+        if (!(fabs(m[p][c]) > 1e-12)) return false;
+        if (p != c) for (int j=0; j<2*n; j++) { double t = m[c][j]; m[c][j] = m[p][j]; m[p][j] = t; }
         
-        outside = round(trackedBox.top() - margin*2);
-        if (outside < 0)
-        {   box.size.y += outside; 
-            box.origin.y -= outside; 
-//            std::cout << "shrink top outside ( " << outside << " ) " << box << std::endl;
+        double k = 1.0/m[c][c];
+        for (int j=0; j<2*n; j++) m[c][j] *= k;
+        for (int r=0; r<n; r++)
+        {
+            if (r == c || m[r][c] == 0) continue;
+            double f = m[r][c];
+            for (int j=0; j<2*n; j++) m[r][j] -= f*m[c][j];
+        }
+    }
+    
+    for (int i=0; i<n; i++)
+        for (int j=0; j<n; j++) inv[i*n+j] = m[i][n+j];
+    return true;
+}
+
+/*! Steepest descent images and inverse Hessian of a warp model (computed once per template)
+    \return false if the Hessian is singular
+ 
+    Pixel coordinates are taken relative to the center of the template, which keeps the 
+    quadratic terms of projective warps well conditioned.
+ */
+template <class Warp>
+static bool see_LKPrepareWarp(LKTemplate& tmpl)
+{
+    const int np = Warp::NPARAMS;
+    if (tmpl.warpParams == np) return true;
+    
+    size_t tw = tmpl.width, th = tmpl.height, n = tw*th;
+    if (np*n > tmpl.warpCapacity)
+    {
+        free(tmpl.steepest);
+        tmpl.steepest = (float *)malloc(np*n*sizeof(float));
+        assert(tmpl.steepest != 0);
+        tmpl.warpCapacity = np*n;
+    }
+    
+    float cx = (tw - 1)*0.5, cy = (th - 1)*0.5, sd[np];
+    for (size_t r=0; r<th; r++)
+        for (size_t c=0; c<tw; c++)
+        {
+            size_t i = r*tw + c;
+            Warp::steepest(tmpl.gx[i], tmpl.gy[i], c - cx, r - cy, sd);
+            for (int k=0; k<np; k++) tmpl.steepest[k*n + i] = sd[k];
+        }
+    
+    double H[np*np];
+    for (int j=0; j<np; j++)
+        for (int k=j; k<np; k++)
+        {
+            float h = 0;
+            see_dotpr(tmpl.steepest + j*n, 1, tmpl.steepest + k*n, 1, &h, n);
+            H[j*np + k] = H[k*np + j] = h;
         }
+    if (!see_LKInvertHessian(H, tmpl.warpInvH, np)) return false;
+    
+    tmpl.warpParams = np;
+    return true;
+}
+
+/*! Sample the next image under a warped template
+    \return false if the warped template does not fit in the image, or if the perspective 
+    denominator of the warp changes sign over the template (the template would wrap around)
+ */
+template <class Warp>
+static bool see_LKSampleWarp(const float *image, size_t width, size_t height, 
+                             const typename Warp::Transformation& t, size_t tw, size_t th, float *out)
+{
+    float cx = (tw - 1)*0.5, cy = (th - 1)*0.5;
+    
+    // the denominator is linear in (x,y), so it keeps its sign if it does at the corners
+    float d0 = Warp::depth(t, -cx, -cy);
+    if (!(d0*Warp::depth(t, cx, -cy) > 0 && d0*Warp::depth(t, -cx, cy) > 0 && d0*Warp::depth(t, cx, cy) > 0)) 
+        return false;
+    
+    for (size_t r=0; r<th; r++)
+        for (size_t c=0; c<tw; c++)
+        {
+            Vector2 p = Warp::map(t, c - cx, r - cy);
+            if (!(p.x >= 0 && p.y >= 0 && p.x < width - 1 && p.y < height - 1)) return false;
+            size_t x0 = (size_t)p.x, y0 = (size_t)p.y;
+            float fx = p.x - x0, fy = p.y - y0;
+            const float *a = image + y0*width + x0, *b = a + width;
+            float h0 = a[0] + fx*(a[1] - a[0]);
+            float h1 = b[0] + fx*(b[1] - b[0]);
+            out[r*tw + c] = h0 + fy*(h1 - h0);
+        }
+    
+    return true;
+}
+
+/*! Inverse compositional tracking of a template under a warp model (see see_LKTemplateTrackAffine) */
+template <class Warp>
+static TRACKINGRESULT see_LKTemplateTrackWarp(LKTemplate& tmpl, size_t width, size_t height, const img nextIm,
+                                              typename Warp::Transformation& warp, float *ssd, 
+                                              float epsi, int maxIter, int *iterations)
+{
+    if (iterations != 0) *iterations = 0;
+    if (tmpl.width == 0 || tmpl.height == 0) return TRACKING_OUTSIDEBOUNDS;
+    if (!see_LKPrepareWarp<Warp>(tmpl)) return TRACKING_EMPTY;
+    
+    const int np = Warp::NPARAMS;
+    size_t tw = tmpl.width, th = tmpl.height, n = tw*th;
+    float cx = (tw - 1)*0.5, cy = (th - 1)*0.5;
+    
+    TRACKINGRESULT result = TRACKING_OK;
+    typename Warp::Transformation previous = warp;
+    bool sampled = false;
+    float dp[np], b[np];
+    float change = 0;
+    int iter = 0;
+    do {
         
-        outside = round((height - 1 - margin*2) - trackedBox.bottom());
-        if (outside < 0)
-        {   box.size.y += outside;
-//            std::cout << "shrink bottom outside ( " << outside << " ) " << box << std::endl;
+        if (!see_LKSampleWarp<Warp>(nextIm, width, height, warp, tw, th, tmpl.warped))
+        {
+            // undo the last update (tmpl.diff still holds the residual of the previous warp)
+            warp = previous;
+            result = TRACKING_STOPPEDBYBOUNDS; break;
         }
         
-        if (box.left() > centerPt.x || box.right() < centerPt.x ||
-            box.top() > centerPt.y || box.bottom() < centerPt.y)
+        // diff = I(W(x)) - T(x)
+        see_vsub(tmpl.tmpl, 1, tmpl.warped, 1, tmpl.diff, 1, n);
+        sampled = true;
+        
+        // dp = H^-1 sum(sd' diff)
+        for (int k=0; k<np; k++) see_dotpr(tmpl.steepest + k*n, 1, tmpl.diff, 1, &b[k], n);
+        for (int j=0; j<np; j++)
         {
-            result = TRACKING_OUTSIDEBOUNDS;
-            break;
+            dp[j] = 0;
+            for (int k=0; k<np; k++) dp[j] += tmpl.warpInvH[j*np + k]*b[k];
         }
         
-        iter++;
+        // W = W o W(dp)^-1
+        previous = warp;
+        if (!Warp::compose(warp, dp)) { result = TRACKING_STOPPEDBYBOUNDS; break; }
+        
+        // largest displacement of a template corner (in pixels, as epsi in translational tracking)
+        change = 0;
+        float xs[2] = {-cx, cx}, ys[2] = {-cy, cy};
+        for (int i=0; i<2; i++)
+            for (int j=0; j<2; j++)
+            {
+                float d = (Warp::map(warp, xs[i], ys[j]) - Warp::map(previous, xs[i], ys[j])).norm();
+                if (d > change) change = d;
+            }
         
-//        if (result == TRACKING_STOPPEDBYBOUNDS)
-//            std::cout << box << " -> " << trackedBox << std::endl;
+        iter ++;
         
-    }// while (result != TRACKING_OK && result != TRACKING_EMPTY);
+    } while (change > epsi && iter <= maxIter);
+    
+    // the residual is only available if a warp could be sampled
+    if (ssd != 0 && sampled) see_svesq(tmpl.diff, 1, ssd, n);
+    if (iterations != 0) *iterations = iter;
     
     return result;
 }
 
-TRACKINGRESULT see_PyramidalLKTemplateMatching(size_t width, size_t height, img prevIm, img nextIm, 
-                                               Rectangle templateBox, unsigned int pyrLevels, Vector2 &motion,
-                                                Vector2 *leftMotion, float *ssd,
-                                               float epsi, int maxIter, pyr *prevPyr, pyr *nextPyr)
+/** Affine warp equivalent to moving a template
+    \param tmpl template prepared with see_setLKTemplate
+    \param motion template motion
+    \param warp warp from template coordinates (relative to the center of the template) to image coordinates
+ */
+void see_LKTemplateAffine(const LKTemplate& tmpl, Vector2 motion, AffineTransformation& warp)
+{
+    warp = AffineTransformation(1, 0, tmpl.box.left() + (tmpl.width - 1)*0.5 + motion.x, 
+                                0, 1, tmpl.box.top() + (tmpl.height - 1)*0.5 + motion.y);
+}
+
+/** Track a template prepared with see_setLKTemplate under an affine warp (inverse compositional)
+    \param tmpl template
+    \param width nextIm width
+    \param height nextIm height
+    \param nextIm normalized next image
+    \param warp warp from template coordinates (relative to the center of the template) to nextIm 
+    (initial value on input, see see_LKTemplateAffine; estimate on output)
+    \param ssd sum of squared differences between the template and its match (or NULL)
+    \param epsi largest displacement of a template corner to stop looking for the template
+    \param maxIter maximum number of iterations
+    \param iterations iterations run (or NULL)
+    \return tracking result (same codes as see_LKTemplateMatching; TRACKING_EMPTY if the template 
+    has no texture to estimate the warp)
+ 
+    The steepest descent images and the inverse Hessian are computed the first time the template 
+    is tracked with this warp model. Use see_LKTemplateTrack for translations.
+ */
+TRACKINGRESULT see_LKTemplateTrackAffine(LKTemplate& tmpl, size_t width, size_t height, const img nextIm,
+                                         AffineTransformation& warp, float *ssd, float epsi, int maxIter, 
+                                         int *iterations)
+{
+    return see_LKTemplateTrackWarp<AffineWarp>(tmpl, width, height, nextIm, warp, ssd, epsi, maxIter, iterations);
+}
+
+/** Track a template prepared with see_setLKTemplate under a projective warp (inverse compositional)
+    \note Same as see_LKTemplateTrackAffine, with a homography (build the initial one from an affine warp).
+ */
+TRACKINGRESULT see_LKTemplateTrackHomography(LKTemplate& tmpl, size_t width, size_t height, const img nextIm,
+                                             HomographyTransformation& warp, float *ssd, float epsi, int maxIter, 
+                                             int *iterations)
+{
+    return see_LKTemplateTrackWarp<HomographyWarp>(tmpl, width, height, nextIm, warp, ssd, epsi, maxIter, iterations);
+}
+
+#pragma mark Coarse translation search
+
+/** Downsample a window of an image into bytes
+    \param image image ([0,1] values, as normalized by see_scaleTo)
+    \param width <a>image</a> width
+    \param x0 left column of the window in <a>image</a>
+    \param y0 top row of the window in <a>image</a>
+    \param scale downsampling factor (each byte is the mean of a scale x scale block)
+    \param w window width in bytes
+    \param h window height in bytes
+    \param dst window (w*h bytes)
+ */
+static void see_coarseWindow(const float *image, size_t width, long x0, long y0, unsigned int scale,
+                             long w, long h, unsigned char *dst)
+{
+    const float k = 255.0f/(scale*scale);
+    for (long r=0; r<h; r++)
+    {
+        const float *src = image + (y0 + r*scale)*width + x0;
+        for (long c=0; c<w; c++, src+=scale)
+        {
+            float sum = 0;
+            for (unsigned int i=0; i<scale; i++)
+                for (unsigned int j=0; j<scale; j++)
+                    sum += src[i*width + j];
+            float v = sum*k + 0.5f;
+            *dst++ = (unsigned char)(v <= 0 ? 0 : (v >= 255 ? 255 : v));
+        }
+    }
+}
+
+/** Exhaustive integer search of the template translation
+    \param width prev,next images width
+    \param height prev,next images height
+    \param prevIm normalized previous image
+    \param nextIm normalized next image
+    \param templateBox template in prevIm
+    \param radius search radius in pixels around the initial <a>motion</a>
+    \param motion template motion from prevIm to nextIm (initial guess in, best translation out)
+    \param scale both images are downsampled by this factor before the search
+    \param sad sum of absolute differences of the best translation (in bytes of the downsampled images)
+    \param buffer scratch of see_coarseSearchBufferSize bytes (allocated if NULL)
+    \return TRACKING_OK, or TRACKING_OUTSIDEBOUNDS if the template or every candidate falls outside the images
+ 
+    Meant to bring large motions into the basin of the LK trackers. The template and the search area 
+    are averaged over scale x scale blocks and quantized to bytes, so every candidate costs one vector 
+    SAD per template row (vu8_sad) and rows are abandoned as soon as they exceed the best sum. Ties go 
+    to the candidate closest to the initial guess. The result is accurate to about <a>scale</a>/2 pixels 
+    and should be refined with a LK tracker (e.g. see_FlexibleLKTemplateMatching).
+ */
+TRACKINGRESULT see_coarseTranslationSearch(size_t width, size_t height, const img prevIm, const img nextIm,
+                                           Rectangle templateBox, unsigned int radius, Vector2 &motion, 
+                                           unsigned int scale, unsigned int *sad, unsigned char *buffer)
+{
+    if (scale == 0) scale = 1;
+    long s = scale, W = width, H = height;
+    long x0 = lroundf(templateBox.left()), y0 = lroundf(templateBox.top());
+    long tw = lroundf(templateBox.width())/s, th = lroundf(templateBox.height())/s;
+    if (tw <= 0 || th <= 0 || x0 < 0 || y0 < 0 || x0 + tw*s > W || y0 + th*s > H)
+        return TRACKING_OUTSIDEBOUNDS;
+    
+    // search area centered at the initial guess, clipped to the blocks that fit in nextIm
+    long rc = (radius + s - 1)/s, span = 2*rc + 1;
+    long cx = lroundf(templateBox.left() + motion.x), cy = lroundf(templateBox.top() + motion.y);
+    long ax = cx - rc*s, ay = cy - rc*s;
+    long dxMin = (ax >= 0 ? 0 : (-ax + s - 1)/s), dyMin = (ay >= 0 ? 0 : (-ay + s - 1)/s);
+    long dxMax = (W - ax >= 0 ? (W - ax)/s : -1) - tw, dyMax = (H - ay >= 0 ? (H - ay)/s : -1) - th;
+    if (dxMax > span - 1) dxMax = span - 1;
+    if (dyMax > span - 1) dyMax = span - 1;
+    if (dxMin > dxMax || dyMin > dyMax) return TRACKING_OUTSIDEBOUNDS;
+    
+    long aw = dxMax - dxMin + tw, ah = dyMax - dyMin + th;
+    bool own = (buffer == NULL);
+    if (own) buffer = (unsigned char *)malloc(tw*th + aw*ah);
+    assert(buffer != NULL);
+    unsigned char *tmpl = buffer, *area = buffer + tw*th;
+    see_coarseWindow(prevIm, width, x0, y0, scale, tw, th, tmpl);
+    see_coarseWindow(nextIm, width, ax + dxMin*s, ay + dyMin*s, scale, aw, ah, area);
+    
+    unsigned int best = UINT_MAX;
+    long bestDx = 0, bestDy = 0, bestDist = LONG_MAX;
+    for (long dy=dyMin; dy<=dyMax; dy++)
+    {
+        for (long dx=dxMin; dx<=dxMax; dx++)
+        {
+            const unsigned char *cand = area + (dy - dyMin)*aw + (dx - dxMin);
+            unsigned int sum = 0;
+            for (long r=0; r<th && sum<=best; r++)
+                sum += vu8_sad(tmpl + r*tw, cand + r*aw, tw);
+            if (sum > best) continue;
+            long dist = (dx - rc)*(dx - rc) + (dy - rc)*(dy - rc);
+            if (sum < best || dist < bestDist)
+            {
+                best = sum;
+                bestDx = dx; bestDy = dy;
+                bestDist = dist;
+            }
+        }
+    }
+    
+    if (own) free(buffer);
+    
+    motion = Vector2(ax + bestDx*s - x0, ay + bestDy*s - y0);
+    if (sad != 0) *sad = best;
+    return TRACKING_OK;
+}
+
+#pragma mark Template re-acquisition
+
+/** Prepare a template for re-acquisition in whole frames
+    \param tmpl template (its workspace is reused if large enough)
+    \param width frame width
+    \param height frame height
+    \param image normalized image holding the template
+    \param box template in <a>image</a> (rounded to pixels)
+    \return TRACKING_OK, TRACKING_OUTSIDEBOUNDS if the box does not fit in the image or 
+    TRACKING_EMPTY if the template is flat
+ 
+    Frames are zero-padded to powers of two, and the spectrum of the zero-mean template is computed 
+    once here so see_NCCTemplateMatch only transforms the frame.
+ */
+TRACKINGRESULT see_setNCCTemplate(NCCTemplate& tmpl, size_t width, size_t height, const img image, Rectangle box)
+{
+    long x0 = lroundf(box.left()), y0 = lroundf(box.top());
+    long tw = lroundf(box.width()), th = lroundf(box.height());
+    tmpl.tw = tmpl.th = 0;
+    if (image == 0 || tw <= 0 || th <= 0 || x0 < 0 || y0 < 0 || x0 + tw > (long)width || y0 + th > (long)height)
+        return TRACKING_OUTSIDEBOUNDS;
+    
+    size_t fw = see_fftSize(width), fh = see_fftSize(height), n = fw*fh;
+    if (tmpl.rowPlan.n != fw) see_initFFTPlan(tmpl.rowPlan, fw);
+    if (tmpl.colPlan.n != fh) see_initFFTPlan(tmpl.colPlan, fh);
+    if (4*n > tmpl.capacity)
+    {
+        free(tmpl.data);
+        tmpl.data = (float *)malloc(4*n*sizeof(float));
+        assert(tmpl.data != 0);
+        tmpl.capacity = 4*n;
+    }
+    size_t integralSize = (width + 1)*(height + 1);
+    if (2*integralSize > tmpl.integralCapacity)
+    {
+        free(tmpl.integral);
+        tmpl.integral = (double *)malloc(2*integralSize*sizeof(double));
+        assert(tmpl.integral != 0);
+        tmpl.integralCapacity = 2*integralSize;
+    }
+    tmpl.re = tmpl.data;
+    tmpl.im = tmpl.re + n;
+    tmpl.frameRe = tmpl.im + n;
+    tmpl.frameIm = tmpl.frameRe + n;
+    tmpl.width = width;
+    tmpl.height = height;
+    
+    // zero-mean template at the origin of the padded frame
+    double mean = 0;
+    for (long r=0; r<th; r++)
+        for (long c=0; c<tw; c++)
+            mean += image[(y0 + r)*width + x0 + c];
+    mean /= tw*th;
+    
+    see_vclr(tmpl.re, 1, 2*n);
+    double norm = 0;
+    for (long r=0; r<th; r++)
+        for (long c=0; c<tw; c++)
+        {
+            float v = image[(y0 + r)*width + x0 + c] - mean;
+            tmpl.re[r*fw + c] = v;
+            norm += v*v;
+        }
+    if (norm < 1e-8) return TRACKING_EMPTY;
+    
+    see_fft2D(tmpl.rowPlan, tmpl.colPlan, tmpl.re, tmpl.im);
+    
+    tmpl.norm = sqrt(norm);
+    tmpl.tw = tw;
+    tmpl.th = th;
+    return TRACKING_OK;
+}
+
+/*! NCC of the template at an offset of the frame (see see_NCCTemplateMatch) */
+static inline float see_NCCAt(const NCCTemplate& tmpl, long u, long v)
+{
+    size_t iw = tmpl.width + 1, n = tmpl.tw*tmpl.th;
+    const double *sum = tmpl.integral, *sqsum = tmpl.integral + iw*(tmpl.height + 1);
+    size_t a = v*iw + u, b = a + tmpl.tw, c = a + tmpl.th*iw, d = c + tmpl.tw;
+    double s = sum[d] - sum[b] - sum[c] + sum[a];
+    double q = sqsum[d] - sqsum[b] - sqsum[c] + sqsum[a];
+    double var = q - s*s/n;
+    if (var < 1e-8) return -1;
+    double corr = tmpl.frameRe[v*tmpl.rowPlan.n + u]/(double)(tmpl.rowPlan.n*tmpl.colPlan.n);
+    return corr/(tmpl.norm*sqrt(var));
+}
+
+/** Find a template anywhere in a frame by normalized cross-correlation
+    \param tmpl template set by see_setNCCTemplate
+    \param image normalized frame of the size given to see_setNCCTemplate
+    \param box template box at the best match, with sub-pixel position
+    \param score NCC of the best match (in [-1, 1])
+    \param minScore smallest NCC accepted as a match
+    \return TRACKING_OK, TRACKING_OUTSIDEBOUNDS if no position scores <a>minScore</a>, or 
+    TRACKING_EMPTY if the template was not set
+ 
+    Meant to re-acquire a template after tracking is lost. The correlation of the zero-mean template 
+    with the frame is computed for every offset with one forward and one inverse FFT, and it is 
+    normalized by the frame energy under the template, taken from integral images of the frame and 
+    its square. Only offsets that keep FSIZE_GAUSDERIV7/2 pixels of margin are considered, so the 
+    box can be tracked by the LK trackers right away. The peak is refined with a parabola fit.
+ */
+TRACKINGRESULT see_NCCTemplateMatch(NCCTemplate& tmpl, const img image, Rectangle &box, float *score, float minScore)
+{
+    if (score != 0) *score = -1;
+    if (tmpl.tw == 0 || tmpl.th == 0) return TRACKING_EMPTY;
+    
+    size_t width = tmpl.width, height = tmpl.height, fw = tmpl.rowPlan.n, n = fw*tmpl.colPlan.n;
+    
+    // frame spectrum times the conjugated template spectrum
+    see_vclr(tmpl.frameRe, 1, 2*n);
+    for (size_t r=0; r<height; r++)
+        memcpy(tmpl.frameRe + r*fw, image + r*width, width*sizeof(float));
+    see_fft2D(tmpl.rowPlan, tmpl.colPlan, tmpl.frameRe, tmpl.frameIm);
+    for (size_t i=0; i<n; i++)
+    {
+        float fr = tmpl.frameRe[i], fi = tmpl.frameIm[i], tr = tmpl.re[i], ti = tmpl.im[i];
+        tmpl.frameRe[i] = fr*tr + fi*ti;
+        tmpl.frameIm[i] = fi*tr - fr*ti;
+    }
+    see_fft2D(tmpl.rowPlan, tmpl.colPlan, tmpl.frameRe, tmpl.frameIm, true);
+    
+    // integral images of the frame and of its square
+    size_t iw = width + 1;
+    double *sum = tmpl.integral, *sqsum = tmpl.integral + iw*(height + 1);
+    for (size_t c=0; c<iw; c++) sum[c] = sqsum[c] = 0;
+    for (size_t r=0; r<height; r++)
+    {
+        const float *row = image + r*width;
+        double *s = sum + (r + 1)*iw, *q = sqsum + (r + 1)*iw;
+        double rs = 0, rq = 0;
+        s[0] = q[0] = 0;
+        for (size_t c=0; c<width; c++)
+        {
+            rs += row[c]; rq += (double)row[c]*row[c];
+            s[c + 1] = s[c + 1 - iw] + rs;
+            q[c + 1] = q[c + 1 - iw] + rq;
+        }
+    }
+    
+    long margin = floor(FSIZE_GAUSDERIV7/2);
+    long uMax = (long)width - (long)tmpl.tw - margin, vMax = (long)height - (long)tmpl.th - margin;
+    float best = -2;
+    long bu = -1, bv = -1;
+    for (long v=margin; v<=vMax; v++)
+        for (long u=margin; u<=uMax; u++)
+        {
+            float ncc = see_NCCAt(tmpl, u, v);
+            if (ncc > best) { best = ncc; bu = u; bv = v; }
+        }
+    if (bu < 0 || best < minScore)
+    {
+        if (score != 0 && bu >= 0) *score = best;
+        return TRACKING_OUTSIDEBOUNDS;
+    }
+    
+    // sub-pixel peak
+    float x = bu, y = bv;
+    if (bu > margin && bu < uMax)
+    {
+        float l = see_NCCAt(tmpl, bu - 1, bv), r = see_NCCAt(tmpl, bu + 1, bv), den = l - 2*best + r;
+        if (den < 0) x += 0.5f*(l - r)/den;
+    }
+    if (bv > margin && bv < vMax)
+    {
+        float t = see_NCCAt(tmpl, bu, bv - 1), b = see_NCCAt(tmpl, bu, bv + 1), den = t - 2*best + b;
+        if (den < 0) y += 0.5f*(t - b)/den;
+    }
+    
+    box = Rectangle(x, y, x + tmpl.tw, y + tmpl.th);
+    if (score != 0) *score = best;
+    return TRACKING_OK;
+}
+
+/** Release the workspace of a re-acquisition template
+    \param tmpl template
+ */
+void see_freeNCCTemplate(NCCTemplate& tmpl)
+{
+    free(tmpl.data);
+    free(tmpl.integral);
+    see_freeFFTPlan(tmpl.rowPlan);
+    see_freeFFTPlan(tmpl.colPlan);
+    tmpl.data = 0;
+    tmpl.integral = 0;
+    tmpl.capacity = tmpl.integralCapacity = 0;
+    tmpl.tw = tmpl.th = 0;
+}
+
+#pragma mark Multi-patch template matching
+
+/*! Floats used by one block of a LKPatchSet: interleaved templates, gradients and warped patches, 
+    inverse Hessians and a buffer to sample one patch */
+static inline size_t see_LKPatchBlockSize(size_t n)
+{
+    return 4*n*SEE_LKPATCH_BLOCK + 4*SEE_LKPATCH_BLOCK + n;
+}
+
+/*! Copy a patch into lane <a>j</a> of a block (or clear the lane if <a>t</a> is NULL)
+    \param t, gx, gy patch and its gradients (rows <a>stride</a> floats apart)
+ */
+static inline void see_LKPatchCopyLane(float *block, size_t j, size_t n, size_t pw, size_t ph, 
+                                       const float *t, const float *gx, const float *gy, size_t stride)
+{
+    const size_t B = SEE_LKPATCH_BLOCK;
+    float *lt = block + j, *lgx = block + n*B + j, *lgy = block + 2*n*B + j, *lw = block + 3*n*B + j;
+    if (t == 0)
+    {
+        // lanes without a patch keep zero data, so they never move
+        for (size_t i=0; i<n; i++) lt[i*B] = lgx[i*B] = lgy[i*B] = lw[i*B] = 0.0f;
+        return;
+    }
+    for (size_t r=0, i=0; r<ph; r++)
+    {
+        const float *rt = t + r*stride, *rgx = gx + r*stride, *rgy = gy + r*stride;
+        for (size_t c=0; c<pw; c++, i++)
+        {
+            lt[i*B] = lw[i*B] = rt[c];
+            lgx[i*B] = rgx[c];
+            lgy[i*B] = rgy[c];
+        }
+    }
+}
+
+/** Prepare patches to be tracked together
+    \param set patch set
+    \param width prevIm width
+    \param height prevIm height
+    \param prevIm normalized image holding the patches
+    \param boxes patch boxes in prevIm (all of the same size)
+    \param count number of patches
+    \return TRACKING_OK if at least one patch could be extracted, TRACKING_OUTSIDEBOUNDS otherwise
+ 
+    When the patches cover a compact region (e.g. a grid over a template), the region is sampled 
+    and filtered once with see_setLKTemplate and every patch whose box is a whole number of 
+    pixels away from the region's corner is copied from it into its lane. Other patches are 
+    prepared one by one. The Hessians of a block are then accumulated for all its lanes at once. 
+    Patches that cannot be extracted (or whose size differs from the first one) keep zero data 
+    and are reported as TRACKING_OUTSIDEBOUNDS by see_LKPatchesTrack, and patches without texture
+    as TRACKING_EMPTY.
+
+    Known limitation: preparing and tracking a 4x4 grid of 12x12 patches still costs about 2.2x
+    one 48x48 flexible template (~25us vs ~11us), short of the 2x target. Preparation is down to
+    about one template's; the rest goes to tracking, where a block keeps iterating until its
+    slowest lane converges.
+ */
+TRACKINGRESULT see_setLKPatches(LKPatchSet& set, size_t width, size_t height, const img prevIm,
+                                const Rectangle *boxes, size_t count)
+{
+    const size_t B = SEE_LKPATCH_BLOCK, V = SEE_VWIDTH;
+    set.count = 0;
+    if (count == 0) return TRACKING_OUTSIDEBOUNDS;
+    
+    size_t pw = roundf(boxes[0].width()), ph = roundf(boxes[0].height()), n = pw*ph;
+    size_t blocks = (count + B - 1)/B, blockSize = see_LKPatchBlockSize(n), total = blocks*blockSize;
+    if (total > set.capacity)
+    {
+        free(set.data);
+        set.data = (float *)malloc(total*sizeof(float));
+        assert(set.data != 0);
+        set.capacity = total;
+    }
+    if (count > set.patchCapacity)
+    {
+        free(set.patches); free(set.consensus);
+        set.patches = (LKPatch *)malloc(count*sizeof(LKPatch));
+        set.consensus = (float *)malloc(2*count*sizeof(float));
+        assert(set.patches != 0 && set.consensus != 0);
+        set.patchCapacity = count;
+    }
+    set.count = count;
+    set.width = pw;
+    set.height = ph;
+    set.blocks = blocks;
+    
+    // region covered by the patches, filtered once unless it is much larger than the patches
+    unsigned int margin = floor(FSIZE_GAUSDERIV7/2);
+    Rectangle region = boxes[0];
+    for (size_t k=1; k<count; k++)
+    {
+        float l = fminf(region.left(), boxes[k].left()), t = fminf(region.top(), boxes[k].top());
+        float r = fmaxf(region.right(), boxes[k].right()), b = fmaxf(region.bottom(), boxes[k].bottom());
+        region = Rectangle(l, t, r, b);
+    }
+    TRACKINGRESULT regionResult = TRACKING_OUTSIDEBOUNDS;
+    if (count > 1 && region.width()*region.height() <= 2.0f*count*n)
+        regionResult = see_setLKTemplate(set.work, width, height, prevIm, region);
+    size_t rw = roundf(region.width() + 2*margin) - 2*margin, rh = roundf(region.height() + 2*margin) - 2*margin;
+    
+    // patches that are a whole number of pixels away from the corner of the region are copied from it
+    // (the region has no texture if its template is empty, and neither has any part of it)
+    for (size_t k=0; k<blocks*B; k++)
+    {
+        float *block = set.data + (k/B)*blockSize;
+        const float *st = 0, *sgx = 0, *sgy = 0;
+        if (k < count)
+        {
+            LKPatch &patch = set.patches[k];
+            patch.box = boxes[k];
+            patch.motion = patch.leftMotion = Vector2(0,0);
+            patch.ssd = 0;
+            patch.iterations = 0;
+            patch.inlier = false;
+            patch.result = TRACKING_OUTSIDEBOUNDS;
+            patch.valid = false;                    // until prepared (from the region or on its own)
+            
+            float dx = boxes[k].left() - region.left(), dy = boxes[k].top() - region.top();
+            size_t c0 = roundf(dx), r0 = roundf(dy);
+            if (regionResult != TRACKING_OUTSIDEBOUNDS && 
+                roundf(boxes[k].width()) == pw && roundf(boxes[k].height()) == ph &&
+                fabsf(dx - c0) < 1e-3f && fabsf(dy - r0) < 1e-3f && c0 + pw <= rw && r0 + ph <= rh)
+            {
+                patch.result = regionResult;
+                patch.valid = true;
+                if (regionResult == TRACKING_OK)
+                {
+                    size_t offset = r0*rw + c0;
+                    st = set.work.tmpl + offset; sgx = set.work.gx + offset; sgy = set.work.gy + offset;
+                }
+            }
+        }
+        see_LKPatchCopyLane(block, k%B, n, pw, ph, st, sgx, sgy, rw);
+    }
+    
+    // any other patch is prepared on its own
+    for (size_t k=0; k<count; k++)
+    {
+        LKPatch &patch = set.patches[k];
+        if (patch.valid || roundf(boxes[k].width()) != pw || roundf(boxes[k].height()) != ph) continue;
+        patch.result = see_setLKTemplate(set.work, width, height, prevIm, boxes[k]);
+        if (patch.result == TRACKING_OK && (set.work.width != pw || set.work.height != ph))
+            patch.result = TRACKING_OUTSIDEBOUNDS;
+        if (patch.result == TRACKING_OK)
+            see_LKPatchCopyLane(set.data + (k/B)*blockSize, k%B, n, pw, ph, 
+                                set.work.tmpl, set.work.gx, set.work.gy, pw);
+    }
+    
+    // Hessians of all the lanes of a block at once, then their inverses
+    size_t extracted = 0;
+    for (size_t b=0; b<blocks; b++)
+    {
+        float *block = set.data + b*blockSize;
+        const float *gx = block + n*B, *gy = block + 2*n*B;
+        float *invH = block + 4*n*B;
+        float hxx[B], hxy[B], hyy[B];
+        for (size_t v=0; v<B; v+=V)
+        {
+            vfloat xx = vf_set(0.0f), xy = vf_set(0.0f), yy = vf_set(0.0f);
+            for (size_t i=0; i<n; i++)
+            {
+                vfloat x = vf_load(gx + i*B + v), y = vf_load(gy + i*B + v);
+                xx = vf_add(xx, vf_mul(x, x));
+                xy = vf_add(xy, vf_mul(x, y));
+                yy = vf_add(yy, vf_mul(y, y));
+            }
+            vf_store(hxx + v, xx); vf_store(hxy + v, xy); vf_store(hyy + v, yy);
+        }
+        
+        for (size_t j=0; j<B; j++)
+        {
+            size_t k = b*B + j;
+            invH[j] = invH[B + j] = invH[2*B + j] = invH[3*B + j] = 0.0f;
+            if (k >= count || set.patches[k].result != TRACKING_OK) continue;
+            
+            float detH = hxx[j]*hyy[j] - hxy[j]*hxy[j];
+            if (!(fabsf(detH) > LK_MIN_DETH))
+            {
+                // no texture to track: the lane stays still
+                set.patches[k].result = TRACKING_EMPTY;
+                continue;
+            }
+            invH[j] = hyy[j]/detH; invH[B + j] = -hxy[j]/detH;
+            invH[2*B + j] = -hxy[j]/detH; invH[3*B + j] = hxx[j]/detH;
+            extracted++;
+        }
+    }
+    for (size_t k=0; k<count; k++) set.patches[k].valid = (set.patches[k].result == TRACKING_OK);
+    
+    return (extracted > 0 ? TRACKING_OK : TRACKING_OUTSIDEBOUNDS);
+}
+
+/*! Data shared by the block tasks of see_LKPatchesTrack */
+typedef struct LKPatchJob
+{
+    LKPatchSet *set;
+    size_t width, height;
+    const float *nextIm;
+    Vector2 motion;
+    float epsi;
+    int maxIter;
+} LKPatchJob;
+
+/** Track the patches of one block (see_task)
+ 
+    Same iteration as see_LKTemplateTrack for every patch of the block. Patches are sampled one 
+    by one into their lanes, then the steepest descent sums and the SSD of all the lanes are 
+    accumulated together. Patches that converge or reach a bound stop being sampled.
+ */
+static void see_LKPatchBlockTrack(void *context, size_t b)
+{
+    const size_t B = SEE_LKPATCH_BLOCK, V = SEE_VWIDTH;
+    LKPatchJob &job = *(LKPatchJob *)context;
+    LKPatchSet &set = *job.set;
+    unsigned int margin = floor(FSIZE_GAUSDERIV7/2);
+    size_t pw = set.width, ph = set.height, n = pw*ph;
+    
+    float *block = set.data + b*see_LKPatchBlockSize(n);
+    const float *t = block, *gx = block + n*B, *gy = block + 2*n*B, *invH = block + 4*n*B;
+    float *warped = block + 3*n*B, *sample = block + 4*n*B + 4*B;
+    
+    size_t first = b*B, lanes = (set.count - first < B ? set.count - first : B), running = 0;
+    LKPatch *patches = set.patches + first;
+    Vector2 delta[B];
+    bool active[B];
+    for (size_t j=0; j<lanes; j++)
+    {
+        delta[j] = Vector2(0,0);
+        active[j] = patches[j].valid;
+        patches[j].motion = job.motion;
+        patches[j].leftMotion = Vector2(0,0);
+        patches[j].iterations = 0;
+        patches[j].result = (active[j] ? TRACKING_OK : TRACKING_OUTSIDEBOUNDS);
+        if (active[j]) running++;
+    }
+    
+    int iter = 0;
+    while (running > 0)
+    {
+        // update motion and sample the running patches into their lanes
+        for (size_t j=0; j<lanes; j++)
+        {
+            if (!active[j]) continue;
+            LKPatch &patch = patches[j];
+            patch.motion = patch.motion + delta[j];
+            Rectangle matchBox = patch.box;
+            matchBox.origin = matchBox.origin + patch.motion;
+            
+            const float *w = 0;
+            size_t stride = 0;
+            if (see_LKWindowFits(matchBox, margin, job.width, job.height))
+                w = see_sampleWindow(job.nextIm, job.width, job.height, matchBox.left(), matchBox.top(), 
+                                     pw, ph, sample, &stride);
+            if (w == 0)
+            {
+                patch.motion = patch.motion - delta[j];
+                patch.leftMotion = delta[j];
+                patch.iterations = iter;
+                patch.result = TRACKING_STOPPEDBYBOUNDS;
+                active[j] = false; running--;
+                continue;
+            }
+            float *lane = warped + j;
+            for (size_t r=0; r<ph; r++, w += stride)
+                for (size_t c=0; c<pw; c++, lane += B)
+                    *lane = w[c];
+        }
+        if (running == 0) break;
+        
+        // diff = warped - tmpl; sum gx*diff, gy*diff and diff^2 of all the lanes at once 
+        // (skipping vectors whose patches have all stopped)
+        vfloat sx[B/V], sy[B/V], ss[B/V];
+        bool group[B/V];
+        for (size_t v=0; v<B/V; v++)
+        {
+            sx[v] = sy[v] = ss[v] = vf_set(0.0f);
+            group[v] = false;
+            for (size_t j=v*V; j<(v+1)*V && j<lanes; j++) group[v] = group[v] || active[j];
+        }
+        for (size_t i=0, o=0; i<n; i++)
+        {
+            for (size_t v=0; v<B/V; v++, o+=V)
+            {
+                if (!group[v]) continue;
+                vfloat d = vf_sub(vf_load(warped + o), vf_load(t + o));
+                sx[v] = vf_add(sx[v], vf_mul(vf_load(gx + o), d));
+                sy[v] = vf_add(sy[v], vf_mul(vf_load(gy + o), d));
+                ss[v] = vf_add(ss[v], vf_mul(d, d));
+            }
+        }
+        float dx[B], dy[B], ssd[B];
+        for (size_t v=0; v<B/V; v++)
+        {
+            vf_store(dx + v*V, sx[v]);
+            vf_store(dy + v*V, sy[v]);
+            vf_store(ssd + v*V, ss[v]);
+        }
+        
+        // update delta
+        iter++;
+        for (size_t j=0; j<lanes; j++)
+        {
+            if (!active[j]) continue;
+            LKPatch &patch = patches[j];
+            delta[j].x = -invH[j]*dx[j] -invH[B + j]*dy[j];
+            delta[j].y = -invH[2*B + j]*dx[j] -invH[3*B + j]*dy[j];
+            patch.ssd = ssd[j];
+            if (delta[j].norm() <= job.epsi || iter > job.maxIter)
+            {
+                patch.leftMotion = delta[j];
+                patch.iterations = iter;
+                active[j] = false; running--;
+            }
+        }
+    }
+}
+
+/*! Lower median of <a>n</a> values (sorts them) */
+static float see_LKLowerMedian(float *values, size_t n)
+{
+    for (size_t i=1; i<n; i++)
+    {
+        float v = values[i];
+        size_t k = i;
+        for (; k>0 && values[k-1] > v; k--) values[k] = values[k-1];
+        values[k] = v;
+    }
+    return values[(n - 1)/2];
+}
+
+/** Track patches prepared with see_setLKPatches and find the motion they agree on
+    \param set patch set
+    \param width nextIm width
+    \param height nextIm height
+    \param nextIm normalized next image
+    \param motion initial displacement of every patch; returns the consensus motion
+    \param epsi motion update threshold to stop looking for a patch
+    \param maxIter maximum number of iterations per patch
+    \param inlierDist maximum distance between the motion of an inlier and the median motion
+    \param inliers number of patches that agree with the consensus (or NULL)
+    \param pool threads that track blocks of patches concurrently (or NULL)
+    \return TRACKING_OK if at least one patch was tracked; otherwise TRACKING_STOPPEDBYBOUNDS if 
+    some patch reached a bound, or TRACKING_OUTSIDEBOUNDS
+ 
+    The outcome of every patch is left in <a>set</a>.patches. The consensus is the mean motion 
+    of the patches within <a>inlierDist</a> of the component-wise median of the tracked patches, 
+    so a few patches that drift or stop by bounds do not end tracking. If no patch is close 
+    enough to the median, the median is returned and <a>inliers</a> is 0.
+ */
+TRACKINGRESULT see_LKPatchesTrack(LKPatchSet& set, size_t width, size_t height, const img nextIm,
+                                  Vector2 &motion, float epsi, int maxIter, 
+                                  float inlierDist, size_t *inliers, ThreadPool *pool)
 {
+    if (inliers != 0) *inliers = 0;
+    if (set.count == 0) return TRACKING_OUTSIDEBOUNDS;
     
-    // compute pyramids
-    pyr prevPyramid, nextPyramid;
+    LKPatchJob job = {&set, width, height, nextIm, motion, epsi, maxIter};
+    see_threadPoolRun(pool, see_LKPatchBlockTrack, &job, set.blocks);
     
-    if (pyrLevels > 0) {
-        see_pyramid(prevIm, width, height, pyrLevels+1, prevPyramid, FILTER_GAUS7, FSIZE_GAUS7, 0);
-        see_pyramid(nextIm, width, height, pyrLevels+1, nextPyramid, FILTER_GAUS7, FSIZE_GAUS7, 0);
+    // component-wise median of the tracked patches
+    float *xs = set.consensus, *ys = set.consensus + set.count;
+    size_t tracked = 0;
+    bool stopped = false;
+    for (size_t k=0; k<set.count; k++)
+    {
+        const LKPatch &patch = set.patches[k];
+        if (patch.result == TRACKING_STOPPEDBYBOUNDS) stopped = true;
+        if (patch.result != TRACKING_OK) continue;
+        xs[tracked] = patch.motion.x;
+        ys[tracked] = patch.motion.y;
+        tracked++;
     }
-    else {
-        prevPyramid.push_back(prevIm);
-        nextPyramid.push_back(nextIm);
+    if (tracked == 0)
+        return (stopped ? TRACKING_STOPPEDBYBOUNDS : TRACKING_OUTSIDEBOUNDS);
+    Vector2 median(see_LKLowerMedian(xs, tracked), see_LKLowerMedian(ys, tracked));
+    
+    // mean of the inliers
+    Vector2 sum(0,0);
+    size_t count = 0;
+    for (size_t k=0; k<set.count; k++)
+    {
+        LKPatch &patch = set.patches[k];
+        patch.inlier = (patch.result == TRACKING_OK && (patch.motion - median).norm() <= inlierDist);
+        if (!patch.inlier) continue;
+        sum = sum + patch.motion;
+        count++;
     }
+    motion = (count > 0 ? sum*(1.0/count) : median);
+    if (inliers != 0) *inliers = count;
+    
+    return TRACKING_OK;
+}
+
+/*! Release the memory held by a patch set
+    \param set patch set (it can be set again with see_setLKPatches)
+ */
+void see_freeLKPatches(LKPatchSet& set)
+{
+    free(set.data);
+    free(set.patches);
+    free(set.consensus);
+    see_freeLKTemplate(set.work);
+    set = LKPatchSet();
+}
+
+#pragma mark Pyramidal template matching
+
+/*! Coarse-to-fine template tracking over two pyramids built with see_pyramid (see 
+    see_PyramidalLKTemplateMatching)
+ */
+static TRACKINGRESULT see_trackPyramidsLKTemplateMatching(const Pyramid& prevPyramid, const Pyramid& nextPyramid,
+                                                          Rectangle templateBox, Vector2 &motion,
+                                                          Vector2 *leftMotion, float *ssd, float epsi, int maxIter)
+{
+    assert(prevPyramid.levels == nextPyramid.levels && prevPyramid.levels > 0);
+    size_t width = prevPyramid.width[0], height = prevPyramid.height[0];
+    int pyrLevels = prevPyramid.levels - 1;
     
     Vector2 g(0.0,0.0);                  // template displacement in one pyr level
     Rectangle box(templateBox);          // template box in prevIm 
@@ -420,8 +1745,8 @@ TRACKINGRESULT see_PyramidalLKTemplateMatching(size_t width, size_t height, img
 //        std::cout << "box(" << l << "): " << box << " in image of " << w << "x" << h << " ... ";
         
         // track
-        img prevI = prevPyramid.at(l);
-        img nextI = nextPyramid.at(l);
+        img prevI = see_pyramidLevel(prevPyramid, l);
+        img nextI = see_pyramidLevel(nextPyramid, l);
         
         result = see_FlexibleLKTemplateMatching(w, h, prevI, nextI,
                                                 box, 0.5, g, leftMotion, (l == 0 ? ssd : 0), 
@@ -438,24 +1763,42 @@ TRACKINGRESULT see_PyramidalLKTemplateMatching(size_t width, size_t height, img
     
     motion = g;
     
-    if (prevPyr != 0)
-    { prevPyr->swap(prevPyramid); see_freePyr(prevPyramid); }
-    else 
-    { see_freePyrUpToBase(prevPyramid); }
+    return result;
+}
+
+TRACKINGRESULT see_PyramidalLKTemplateMatching(size_t width, size_t height, img prevIm, img nextIm, 
+                                               Rectangle templateBox, unsigned int pyrLevels, Vector2 &motion,
+                                                Vector2 *leftMotion, float *ssd,
+                                               float epsi, int maxIter, Pyramid *prevPyr, Pyramid *nextPyr)
+{
+    
+    // compute pyramids (in the caller's storage if given)
+    Pyramid localPrev, localNext;
+    Pyramid &prevPyramid = (prevPyr != 0 ? *prevPyr : localPrev);
+    Pyramid &nextPyramid = (nextPyr != 0 ? *nextPyr : localNext);
+    
+    see_pyramid(prevIm, width, height, pyrLevels+1, prevPyramid, FILTER_GAUS7, FSIZE_GAUS7, 0);
+    see_pyramid(nextIm, width, height, pyrLevels+1, nextPyramid, FILTER_GAUS7, FSIZE_GAUS7, 0);
+    
+    TRACKINGRESULT result = see_trackPyramidsLKTemplateMatching(prevPyramid, nextPyramid, templateBox, motion,
+                                                                leftMotion, ssd, epsi, maxIter);
     
-    if (nextPyr != 0)
-    { nextPyr->swap(nextPyramid); see_freePyr(nextPyramid); }
-    else
-    { see_freePyrUpToBase(nextPyramid); }
+    see_freePyramid(localPrev);
+    see_freePyramid(localNext);
     
     return result;
 }
 
 
-TRACKINGRESULT see_LKPyramidalLK(size_t width, size_t height, img prevIm, img nextIm,
-                                 Rectangle templateBox, unsigned int pyrLevels, Vector2 &motion,
-                                 float *ssd, float epsi, int maxIter, pyr *prevPyr, pyr *nextPyr)
+/*! Pyramidal LK over two pyramids built with see_pyramid (see see_LKPyramidalLK) */
+static TRACKINGRESULT see_trackPyramidsLKPyramidalLK(const Pyramid& prevPyramid, const Pyramid& nextPyramid,
+                                                     Rectangle templateBox, Vector2 &motion,
+                                                     float *ssd, float epsi, int maxIter)
 {
+    assert(prevPyramid.levels == nextPyramid.levels && prevPyramid.levels > 0);
+    size_t width = prevPyramid.width[0], height = prevPyramid.height[0];
+    int pyrLevels = prevPyramid.levels - 1;
+    
     TRACKINGRESULT result = TRACKING_OK; // tracking result
     Vector2 g(0.0,0.0);                  // displacement guess
     Rectangle box(templateBox);          // template box
@@ -463,18 +1806,6 @@ TRACKINGRESULT see_LKPyramidalLK(size_t width, size_t height, img prevIm, img ne
     Vector2 center;                      // template box center
     unsigned int margin = floor(FSIZE_GAUSDERIV7/2);
     
-    // compute pyramids
-    pyr prevPyramid, nextPyramid;
-    
-    if (pyrLevels > 0) { // we really use pyrLevels + 1 levels
-        see_pyramid(prevIm, width, height, pyrLevels+1, prevPyramid, FILTER_GAUS7, FSIZE_GAUS7, 0);
-        see_pyramid(nextIm, width, height, pyrLevels+1, nextPyramid, FILTER_GAUS7, FSIZE_GAUS7, 0);
-    }
-    else {
-        prevPyramid.push_back(prevIm);
-        nextPyramid.push_back(nextIm);
-    }
-    
     // track template along pyramid levels
     for (int l=pyrLevels; l>=0; l--)
     {
@@ -489,13 +1820,13 @@ TRACKINGRESULT see_LKPyramidalLK(size_t width, size_t height, img prevIm, img ne
         w = width >> l; h = height >> l;
         
         // reference images to process
-        img prevI = prevPyramid.at(l);
-        img nextI = nextPyramid.at(l);
+        img prevI = see_pyramidLevel(prevPyramid, l);
+        img nextI = see_pyramidLevel(nextPyramid, l);
 
         // extract template window
         Rectangle enlargedBox;
         img tempIm =  see_extractWindow(w, h, prevI, box, margin, &enlargedBox);
-        if (tempIm == 0) return TRACKING_OUTSIDEBOUNDS;
+        if (tempIm == 0) { result = TRACKING_OUTSIDEBOUNDS; break; }
         int enlargedWRound = int(enlargedBox.width()), enlargedHRound = int(enlargedBox.height());
         int tempLength = enlargedWRound * enlargedHRound;
         
@@ -509,9 +1840,9 @@ TRACKINGRESULT see_LKPyramidalLK(size_t width, size_t height, img prevIm, img ne
         // compute the Hessian matrix
         // H = [Hxx Hxy; Hyx Hyy] = [gx gy]'*[gx gy]
         float Hxx = 0, Hxy = 0, Hyy = 0;
-        vDSP_dotpr(gx, 1, gx, 1, &Hxx, tempLength);
-        vDSP_dotpr(gx, 1, gy, 1, &Hxy, tempLength); // same as Hyx
-        vDSP_dotpr(gy, 1, gy, 1, &Hyy, tempLength);
+        see_dotpr(gx, 1, gx, 1, &Hxx, tempLength);
+        see_dotpr(gx, 1, gy, 1, &Hxy, tempLength); // same as Hyx
+        see_dotpr(gy, 1, gy, 1, &Hyy, tempLength);
         // find H^{-1} because we will end up using 
         // -inv(H)*[gx gy]' as constant update step 
         float detH = Hxx*Hyy - Hxy*Hxy;
@@ -533,12 +1864,12 @@ TRACKINGRESULT see_LKPyramidalLK(size_t width, size_t height, img prevIm, img ne
             if (match == 0) { result = TRACKING_STOPPEDBYBOUNDS; break; }
             
             // image difference
-            vDSP_vsub(match, 1, tempIm, 1,  diff, 1, tempLength);
+            see_vsub(match, 1, tempIm, 1,  diff, 1, tempLength);
             
             // update delta
             float dx = 0, dy = 0;
-            vDSP_dotpr(gx, 1, diff, 1, &dx, tempLength);
-            vDSP_dotpr(gy, 1, diff, 1, &dy, tempLength);
+            see_dotpr(gx, 1, diff, 1, &dx, tempLength);
+            see_dotpr(gy, 1, diff, 1, &dy, tempLength);
             delta.x = invH[0][0]*dx + invH[0][1]*dy;
             delta.y = invH[1][0]*dx + invH[1][1]*dy;
             
@@ -551,28 +1882,163 @@ TRACKINGRESULT see_LKPyramidalLK(size_t width, size_t height, img prevIm, img ne
             iter++;
         } while (delta.norm() > epsi && iter <= maxIter);
         
-        if (result != TRACKING_OK) break;
-        
-        if (l > 0) g = (g + v)*2; 
-        else g = g + v;
+        if (result == TRACKING_OK)
+        {
+            if (l > 0) g = (g + v)*2; 
+            else g = g + v;
+            
+            if (l == 0 && ssd != 0) // SSD of the last match, inside the template (diff is enlarged)
+            {
+                *ssd = 0;
+                float ssdRow = 0;
+                for (int r = 0; r<tempHRound; r++)
+                {
+                    see_svesq(diff + (margin + r)*enlargedWRound + margin, 1, &ssdRow, tempWRound);
+                    *ssd += ssdRow;
+                }
+            }
+        }
         
+        free(match);
         free(diff);
         free(gx); free(gy);
         free(tempIm);
         
+        if (result != TRACKING_OK) break;
     }
     
     motion = g;
+
+    return result;
+}
+
+TRACKINGRESULT see_LKPyramidalLK(size_t width, size_t height, img prevIm, img nextIm,
+                                 Rectangle templateBox, unsigned int pyrLevels, Vector2 &motion,
+                                 float *ssd, float epsi, int maxIter, Pyramid *prevPyr, Pyramid *nextPyr)
+{
+    // compute pyramids (in the caller's storage if given)
+    Pyramid localPrev, localNext;
+    Pyramid &prevPyramid = (prevPyr != 0 ? *prevPyr : localPrev);
+    Pyramid &nextPyramid = (nextPyr != 0 ? *nextPyr : localNext);
+    
+    // we really use pyrLevels + 1 levels
+    see_pyramid(prevIm, width, height, pyrLevels+1, prevPyramid, FILTER_GAUS7, FSIZE_GAUS7, 0);
+    see_pyramid(nextIm, width, height, pyrLevels+1, nextPyramid, FILTER_GAUS7, FSIZE_GAUS7, 0);
+    
+    TRACKINGRESULT result = see_trackPyramidsLKPyramidalLK(prevPyramid, nextPyramid, templateBox, motion,
+                                                           ssd, epsi, maxIter);
+    
+    see_freePyramid(localPrev);
+    see_freePyramid(localNext);
+    
+    return result;
+}
+
+#pragma mark Tracking context
+
+/*! Build the pyramid of <a>image</a> in the free slot of <a>tracker</a>
+    \return index of the slot
+ */
+static int see_LKTrackerBuild(LKTracker& tracker, const img image, size_t width, size_t height, 
+                              unsigned int pyrLevels)
+{
+    int slot = (tracker.prev == 0 ? 1 : 0);
+    see_pyramid(image, width, height, pyrLevels+1, tracker.pyramids[slot], FILTER_GAUS7, FSIZE_GAUS7, 0);
+    return slot;
+}
+
+/*! Check if the previous frame stored in <a>tracker</a> can be used with a new frame
+ */
+static bool see_LKTrackerHasPrevious(const LKTracker& tracker, size_t width, size_t height, unsigned int pyrLevels)
+{
+    if (tracker.prev < 0) return false;
+    const Pyramid& prev = tracker.pyramids[tracker.prev];
+    return prev.width[0] == width && prev.height[0] == height && prev.levels == pyrLevels+1;
+}
+
+/*! Set previous frame of tracking context
+    \param tracker tracking context
+    \param image new previous frame (normalized)
+    \param width image width
+    \param height image height
+    \param pyrLevels number of pyramid levels (besides the original image)
+ */
+void see_LKTrackerSetFrame(LKTracker& tracker, const img image, size_t width, size_t height, unsigned int pyrLevels)
+{
+    tracker.prev = see_LKTrackerBuild(tracker, image, width, height, pyrLevels);
+}
+
+/*! Track template from the previous frame of <a>tracker</a> to <a>nextIm</a> (see see_PyramidalLKTemplateMatching)
+    \param tracker tracking context
+    \param nextIm normalized next image
+    \param width image width
+    \param height image height
+    \param templateBox template in the previous frame
+    \param pyrLevels number of pyramid levels (besides the original image)
+    \param motion template motion from the previous frame to <a>nextIm</a>
+    \return tracking result
+ 
+    Only the pyramid of <a>nextIm</a> is built. If tracking succeeds, <a>nextIm</a> becomes the 
+    previous frame for the next call; otherwise the previous frame is kept. When there is no
+    compatible previous frame (first call, after see_resetLKTracker, or a different size or 
+    number of levels), nothing is tracked: <a>nextIm</a> is stored as the previous frame and 
+    TRACKING_NOPREVIOUS is returned with no motion. Prime the context with see_LKTrackerSetFrame 
+    to avoid it.
+ */
+TRACKINGRESULT see_LKTrackerPyramidalLKTemplateMatching(LKTracker& tracker, const img nextIm, size_t width, size_t height,
+                                                        Rectangle templateBox, unsigned int pyrLevels, Vector2 &motion,
+                                                        Vector2 *leftMotion, float *ssd, float epsi, int maxIter)
+{
+    motion = Vector2(0,0);
+    if (!see_LKTrackerHasPrevious(tracker, width, height, pyrLevels))
+    {
+        see_LKTrackerSetFrame(tracker, nextIm, width, height, pyrLevels);
+        return TRACKING_NOPREVIOUS;
+    }
     
-    if (prevPyr != 0)
-    { prevPyr->swap(prevPyramid); see_freePyr(prevPyramid); }
-    else 
-    { see_freePyrUpToBase(prevPyramid); }
+    int next = see_LKTrackerBuild(tracker, nextIm, width, height, pyrLevels);
+    TRACKINGRESULT result = see_trackPyramidsLKTemplateMatching(tracker.pyramids[tracker.prev], tracker.pyramids[next],
+                                                                templateBox, motion, leftMotion, ssd, epsi, maxIter);
+    if (result == TRACKING_OK) tracker.prev = next;
     
-    if (nextPyr != 0)
-    { nextPyr->swap(nextPyramid); see_freePyr(nextPyramid); }
-    else
-    { see_freePyrUpToBase(nextPyramid); }
+    return result;
+}
 
+/*! Track template from the previous frame of <a>tracker</a> to <a>nextIm</a> (see see_LKPyramidalLK)
+
+    Same frame handling as see_LKTrackerPyramidalLKTemplateMatching.
+ */
+TRACKINGRESULT see_LKTrackerLKPyramidalLK(LKTracker& tracker, const img nextIm, size_t width, size_t height,
+                                          Rectangle templateBox, unsigned int pyrLevels, Vector2 &motion,
+                                          float *ssd, float epsi, int maxIter)
+{
+    motion = Vector2(0,0);
+    if (!see_LKTrackerHasPrevious(tracker, width, height, pyrLevels))
+    {
+        see_LKTrackerSetFrame(tracker, nextIm, width, height, pyrLevels);
+        return TRACKING_NOPREVIOUS;
+    }
+    
+    int next = see_LKTrackerBuild(tracker, nextIm, width, height, pyrLevels);
+    TRACKINGRESULT result = see_trackPyramidsLKPyramidalLK(tracker.pyramids[tracker.prev], tracker.pyramids[next],
+                                                           templateBox, motion, ssd, epsi, maxIter);
+    if (result == TRACKING_OK) tracker.prev = next;
+    
     return result;
 }
+
+/*! Forget the previous frame of <a>tracker</a> (its storage is kept)
+ */
+void see_resetLKTracker(LKTracker& tracker)
+{
+    tracker.prev = -1;
+}
+
+/*! Release tracking context storage
+ */
+void see_freeLKTracker(LKTracker& tracker)
+{
+    see_freePyramid(tracker.pyramids[0]);
+    see_freePyramid(tracker.pyramids[1]);
+    tracker.prev = -1;
+}
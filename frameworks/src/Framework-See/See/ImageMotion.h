@@ -36,6 +36,8 @@
 #include "ImageTypes.h"
 #include <BasicMath/Vector2.h>
 #include <BasicMath/Rectangle.h>
+#include "ImageTransformation.h"
+#include "SeeFFT.h"
 
 #if __cplusplus
 extern "C" {
@@ -49,9 +51,112 @@ extern "C" {
         TRACKING_STOPPEDBYBOUNDS,   //!< tracking stopped because tamplate went out of bounds
         TRACKING_OUTSIDEBOUNDS,     //!< template is outside bounds
         TRACKING_EMPTY,             //!< template is seriously dark! 
+        TRACKING_NOPREVIOUS,        //!< tracking context had no previous frame to track from
         TRACKING_NUM_RESULTS
     } TRACKINGRESULT;
+    
+    /**
+     Pyramidal tracking context. Keeps the pyramid of the previous frame so that
+     tracking a new frame only builds one pyramid. Release with see_freeLKTracker.
+     */
+    typedef struct LKTracker
+    {
+        Pyramid pyramids[2];        //!< previous and next frame pyramids (they swap roles)
+        int prev;                   //!< slot holding the previous frame (-1 if there is none)
+        
+        LKTracker() : prev(-1) {}
+    } LKTracker;
+        
+    /**
+     Template prepared for inverse-compositional tracking (see see_LKTemplateTrack). The template,
+     its gradients and the inverse of its Hessian are computed once by see_setLKTemplate; tracking
+     only samples the next image into a buffer of the workspace, which is reused by every iteration
+     and by later templates of the same size. Release with see_freeLKTemplate.
+     */
+    typedef struct LKTemplate
+    {
+        Rectangle box;              //!< template box in the image it was taken from
+        size_t width, height;       //!< template size in pixels
+        size_t capacity;            //!< floats in <a>data</a>
+        float *data;                //!< workspace holding the arrays below
+        float *tmpl;                //!< template (width*height)
+        float *gx, *gy;             //!< template gradients (width*height)
+        float *warped;              //!< next image sampled under the tracked box (width*height)
+        float *diff;                //!< warped - tmpl (width*height)
+        float *scratch;             //!< enlarged template and filtering scratch
+        float invH[2][2];           //!< inverse of the Hessian of the template
+        int warpParams;             //!< parameters of the warp model in <a>steepest</a> (0 if not computed)
+        size_t warpCapacity;        //!< floats in <a>steepest</a>
+        float *steepest;            //!< steepest descent images of the warp model (warpParams*width*height)
+        float warpInvH[64];         //!< inverse of the Hessian of the warp model (warpParams^2)
+        
+        LKTemplate() : width(0), height(0), capacity(0), data(0), warpParams(0), warpCapacity(0), steepest(0) {}
+    } LKTemplate;
+    
+    /**
+     Template prepared for re-acquisition in whole frames by normalized cross-correlation (see 
+     see_NCCTemplateMatch). Keeps the spectrum of the zero-mean template, zero-padded to the 
+     power-of-two size of the frames, and the workspace of the frame transform and its integral 
+     images. Release with see_freeNCCTemplate.
+     */
+    typedef struct NCCTemplate
+    {
+        size_t width, height;       //!< frame size
+        size_t tw, th;              //!< template size in pixels (0 if not set)
+        float norm;                 //!< norm of the zero-mean template
+        FFTPlan rowPlan, colPlan;   //!< transforms of the padded rows and columns
+        size_t capacity;            //!< floats in <a>data</a>
+        float *data;                //!< workspace holding the arrays below
+        float *re, *im;             //!< template spectrum (padded frame size)
+        float *frameRe, *frameIm;   //!< frame spectrum, then correlation (padded frame size)
+        size_t integralCapacity;    //!< doubles in <a>integral</a>
+        double *integral;           //!< integral images of the frame and of its square ((width+1)*(height+1) each)
+        
+        NCCTemplate() : width(0), height(0), tw(0), th(0), norm(0), capacity(0), data(0), 
+                        integralCapacity(0), integral(0) {}
+    } NCCTemplate;
+    
+    /*! Patches tracked by a LKPatchSet are interleaved in blocks of this many lanes */
+    #define SEE_LKPATCH_BLOCK 8
+    
+    /**
+     One patch of a LKPatchSet and its tracking outcome
+     */
+    typedef struct LKPatch
+    {
+        Rectangle box;              //!< patch box in the image it was taken from
+        Vector2 motion;             //!< patch motion
+        Vector2 leftMotion;         //!< last update, which was not applied to <a>motion</a>
+        float ssd;                  //!< sum of squared differences between the patch and its match
+        int iterations;             //!< iterations run
+        TRACKINGRESULT result;      //!< tracking result of the patch
+        bool valid;                 //!< the patch could be extracted by see_setLKPatches
+        bool inlier;                //!< patch motion agrees with the consensus
+    } LKPatch;
+    
+    /**
+     Patches of the same size tracked together (see see_LKPatchesTrack). Patch data is stored 
+     structure-of-arrays: pixel i of the j-th patch of a block is at i*SEE_LKPATCH_BLOCK + j, so 
+     every iteration computes the update of SEE_LKPATCH_BLOCK patches with the same vector 
+     instructions. Blocks are independent and can be tracked by different threads. Release with 
+     see_freeLKPatches.
+     */
+    typedef struct LKPatchSet
+    {
+        size_t count;               //!< patches
+        size_t width, height;       //!< patch size in pixels
+        size_t blocks;              //!< blocks of SEE_LKPATCH_BLOCK patches
+        size_t capacity;            //!< floats in <a>data</a>
+        float *data;                //!< interleaved templates, gradients, warped patches and inverse Hessians
+        size_t patchCapacity;       //!< entries in <a>patches</a>
+        LKPatch *patches;           //!< patches (<a>count</a>)
+        float *consensus;           //!< scratch for the consensus (2*<a>patchCapacity</a>)
+        LKTemplate work;            //!< template used to prepare each patch
         
+        LKPatchSet() : count(0), width(0), height(0), blocks(0), capacity(0), data(0), 
+                       patchCapacity(0), patches(0), consensus(0) {}
+    } LKPatchSet;
+    
 //    img see_extractWindow(size_t w, size_t h, img image, const Rectangle& rect, 
 //                          unsigned int margin = 0, Rectangle* windowRect = 0);
     TRACKINGRESULT see_LKTemplateMatching(size_t width, size_t height, img prevIm, img nextIm,
@@ -67,17 +172,88 @@ extern "C" {
                                                   float epsi = 0.00003, int maxIter = 1500,
                                                   img* gradX = 0, img* gradY = 0, 
                                                   img *tmplEnlarged = 0, Rectangle* tmplEnlargedBox = 0,
-                                                  img *trackedEnlarged = 0, Rectangle* trackedEnlargedBox = 0);
+                                                  img *trackedEnlarged = 0, Rectangle* trackedEnlargedBox = 0,
+                                                  int *iterations = 0);
     
     TRACKINGRESULT see_PyramidalLKTemplateMatching(size_t width, size_t height, img prevIm, img nextIm, 
                                                    Rectangle templateBox, unsigned int pyrLevels, Vector2 &motion, 
                                                    Vector2 *leftMotion = 0, float *ssd = 0,
-                                                   float epsi = 0.00003, int maxIter = 1500, pyr *prevPyr = 0, pyr *nextPyr = 0);
+                                                   float epsi = 0.00003, int maxIter = 1500, Pyramid *prevPyr = 0, Pyramid *nextPyr = 0);
     
     TRACKINGRESULT see_LKPyramidalLK(size_t width, size_t height, img prevIm, img nextIm,
                                      Rectangle templateBox, unsigned int pyrLevels, Vector2 &motion,
                                      float *ssd = 0, float epsi = 0.03, int maxIter = 100, 
-                                     pyr *prevPyr = 0, pyr *nextPyr = 0);
+                                     Pyramid *prevPyr = 0, Pyramid *nextPyr = 0);
+    
+    TRACKINGRESULT see_setLKTemplate(LKTemplate& tmpl, size_t width, size_t height, const img prevIm,
+                                     Rectangle templateBox);
+    
+    TRACKINGRESULT see_LKTemplateTrack(LKTemplate& tmpl, size_t width, size_t height, const img nextIm, 
+                                       Vector2 &motion, Vector2 *leftMotion = 0, float *ssd = 0,
+                                       float epsi = 0.00003, int maxIter = 1500, int *iterations = 0);
+    
+    TRACKINGRESULT see_LKTemplateTrackFlexible(LKTemplate& tmpl, size_t width, size_t height, const img nextIm, 
+                                               Vector2 &motion, Vector2 *leftMotion = 0, float *ssd = 0,
+                                               float epsi = 0.00003, int maxIter = 1500, 
+                                               Rectangle *trackedBox = 0, int *iterations = 0);
+    
+    void see_LKTemplateAffine(const LKTemplate& tmpl, Vector2 motion, AffineTransformation& warp);
+    
+    TRACKINGRESULT see_LKTemplateTrackAffine(LKTemplate& tmpl, size_t width, size_t height, const img nextIm,
+                                             AffineTransformation& warp, float *ssd = 0, 
+                                             float epsi = 0.00003, int maxIter = 1500, int *iterations = 0);
+    
+    TRACKINGRESULT see_LKTemplateTrackHomography(LKTemplate& tmpl, size_t width, size_t height, const img nextIm,
+                                                 HomographyTransformation& warp, float *ssd = 0, 
+                                                 float epsi = 0.00003, int maxIter = 1500, int *iterations = 0);
+    
+    TRACKINGRESULT see_ICLKTemplateMatching(size_t width, size_t height, img prevIm, img nextIm,
+                                            Rectangle templateBox, Vector2 &motion, 
+                                            Vector2 *leftMotion = 0, float *ssd = 0, 
+                                            float epsi = 0.00003, int maxIter = 1500);
+    
+    void see_freeLKTemplate(LKTemplate& tmpl);
+    
+    TRACKINGRESULT see_setLKPatches(LKPatchSet& set, size_t width, size_t height, const img prevIm,
+                                    const Rectangle *boxes, size_t count);
+    
+    TRACKINGRESULT see_LKPatchesTrack(LKPatchSet& set, size_t width, size_t height, const img nextIm,
+                                      Vector2 &motion, float epsi = 0.00003, int maxIter = 1500, 
+                                      float inlierDist = 1.0, size_t *inliers = 0, struct ThreadPool *pool = 0);
+    
+    void see_freeLKPatches(LKPatchSet& set);
+    
+/*! Scratch bytes needed by see_coarseTranslationSearch (box size and radius in pixels) */
+#define see_coarseSearchBufferSize(boxWidth, boxHeight, radius, scale) \
+    (((boxWidth)/(scale) + 1)*((boxHeight)/(scale) + 1) + \
+     ((boxWidth)/(scale) + 2*(((radius) + (scale) - 1)/(scale)) + 2)*((boxHeight)/(scale) + 2*(((radius) + (scale) - 1)/(scale)) + 2))
+    
+    TRACKINGRESULT see_coarseTranslationSearch(size_t width, size_t height, const img prevIm, const img nextIm,
+                                               Rectangle templateBox, unsigned int radius, Vector2 &motion, 
+                                               unsigned int scale = 2, unsigned int *sad = 0, 
+                                               unsigned char *buffer = NULL);
+    
+    TRACKINGRESULT see_setNCCTemplate(NCCTemplate& tmpl, size_t width, size_t height, const img image, 
+                                      Rectangle box);
+    
+    TRACKINGRESULT see_NCCTemplateMatch(NCCTemplate& tmpl, const img image, Rectangle &box, 
+                                        float *score = 0, float minScore = 0.8);
+    
+    void see_freeNCCTemplate(NCCTemplate& tmpl);
+    
+    void see_LKTrackerSetFrame(LKTracker& tracker, const img image, size_t width, size_t height, unsigned int pyrLevels);
+    
+    TRACKINGRESULT see_LKTrackerPyramidalLKTemplateMatching(LKTracker& tracker, const img nextIm, size_t width, size_t height,
+                                                            Rectangle templateBox, unsigned int pyrLevels, Vector2 &motion, 
+                                                            Vector2 *leftMotion = 0, float *ssd = 0,
+                                                            float epsi = 0.00003, int maxIter = 1500);
+    
+    TRACKINGRESULT see_LKTrackerLKPyramidalLK(LKTracker& tracker, const img nextIm, size_t width, size_t height,
+                                              Rectangle templateBox, unsigned int pyrLevels, Vector2 &motion,
+                                              float *ssd = 0, float epsi = 0.03, int maxIter = 100);
+    
+    void see_resetLKTracker(LKTracker& tracker);
+    void see_freeLKTracker(LKTracker& tracker);
                         
 #if __cplusplus
 }
@@ -33,6 +33,8 @@
 #include "ImageSaliency.h"
 #include "ImageConversion.h"
 #include "SeeCommon.h"
+#include "SeeSIMD.h"
+#include "SeeThreadPool.h"
 #include <assert.h>
 #include <math.h>
 #include <iostream>
@@ -47,79 +49,58 @@
 void see_maxNormalize(img& image, size_t width, size_t height);
 img see_centerSurround(img& img1, size_t w1, size_t h1,
                        img& img2, size_t w2, size_t h2);
+void see_centerSurroundWithBuffers(const float *img1, size_t w1, size_t h1,
+                                   const float *img2, size_t w2, size_t h2, float *out, float *buffer);
 img see_centerSurround2(img& img1, size_t w1, size_t h1,
                         img& img2, size_t w2, size_t h2);
+void see_centerSurround2WithBuffers(const float *img1, size_t w1, size_t h1,
+                                    const float *img2, size_t w2, size_t h2, float *out, float *buffer);
+
+/*! Scratch floats needed by the center-surround operators */
+#define see_centerSurroundBufferSize(w1, h1, h2) see_enlargeBufferSize(w1, h1, h2)
 
 #pragma mark SALIENCY ITTI
 
 /*! Extract intensity and color opponency features
-    \param array input image (RGBA)
+    \param array input image (BGRA)
     \param width image width
     \param height image height
     \param shrinkingTimes how many times to shrink original data by half
 	\param featInt image intensity
 	\param featRG red-green opponency
 	\param featBY blue-yellow opponency
+    \param bytesPerRow bytes per row in <a>array</a> (0 if rows are contiguous)
  */
 void see_featuresItti(const unsigned char *array, size_t& width, size_t& height, unsigned int shrinkingTimes,
-					  img *featInt, img *featRG, img *featBY)
+					  img *featInt, img *featRG, img *featBY, size_t bytesPerRow)
 {    
 #ifdef TIME_FEATURESITTI
     double t = tic();
 #endif
     
-	img red = 0, green = 0, blue = 0;
-    size_t size;
-    
-#ifdef TIME_FEATURESITTI
-    double tDecomp = tic();
-#endif
+    if (bytesPerRow == 0) bytesPerRow = 4*width;
     
     if (shrinkingTimes > 0)
     {
-        see_shrinkRGBA(shrinkingTimes, array, width, height, FILTER_GAUS7, FSIZE_GAUS7, &red, &green, &blue);
-        size = width*height;
+        img red = 0, green = 0, blue = 0;
+        see_shrinkRGBA(shrinkingTimes, array, width, height, FILTER_GAUS7, FSIZE_GAUS7, 
+                       &red, &green, &blue, bytesPerRow);
+        size_t size = width*height;
+        
+        *featInt = see_intensity(red, green, blue, size);
+        see_opponency(red, green, blue, size, featRG, featBY);
+        
+        free(red); free(green); free(blue);
     }
     else
     {
-        size = width*height;
-        see_decompose(array, size, &red, &green, &blue);
+        // one pass over the BGRA data
+        size_t size = width*height;
+        *featInt = (float *)malloc(size*sizeof(float));
+        *featRG = (float *)malloc(size*sizeof(float));
+        *featBY = (float *)malloc(size*sizeof(float));
+        see_featuresBGRA(array, width, height, bytesPerRow, *featInt, *featRG, *featBY);
     }
-
-#ifdef TIME_FEATURESITTI
-    tDecomp = toc(tDecomp);
-    tDecomp = tDecomp / NANOS_IN_MS;
-    COUT_TIME_LOG_AT("see_decompose", tDecomp);
-#endif
-    
-    
-#ifdef TIME_FEATURESITTI
-    double tInt = tic();
-#endif
-    
-	*featInt = see_intensity(red, green, blue, size);
-    
-#ifdef TIME_FEATURESITTI
-    tInt = toc(tInt);
-    tInt = tInt / NANOS_IN_MS;
-    COUT_TIME_LOG_AT("see_intensity", tInt);
-#endif
-    
-    
-#ifdef TIME_FEATURESITTI
-    double tOpp = tic();
-#endif
-    
-	see_opponency(red, green, blue, size, featRG, featBY);
-    
-#ifdef TIME_FEATURESITTI
-    tOpp = toc(tOpp);
-    tOpp = tOpp / NANOS_IN_MS;
-    COUT_TIME_LOG_AT("see_opponency", tOpp);
-#endif
-    
-    
-	free(red); free(green); free(blue);
     
 #ifdef TIME_FEATURESITTI
     t = toc(t);
@@ -129,6 +110,55 @@ void see_featuresItti(const unsigned char *array, size_t& width, size_t& height,
 
 }
 
+/*! Count local maximums
+	\param image input image
+	\param width image width
+	\param height image height
+    \param threshold minimum value of a local maximum (not included)
+    \param row0 first row to check
+    \param row1 row after the last one to check
+    \return number of pixels greater than <a>threshold</a> and not smaller than any of their 8 neighbors
+ 
+    Rows 1 to <a>height</a>-2 and columns 2 to <a>width</a>-3 are checked (the range see_maxNormalize 
+    has always used), restricted to rows <a>row0</a> to <a>row1</a>-1. Each vector of pixels is 
+    compared against the maximum of its neighbors and the resulting mask is counted in registers, 
+    so the image is read once.
+ */
+static size_t see_countLocalMax(const float *image, size_t width, size_t height, float threshold,
+                                size_t row0, size_t row1)
+{
+    if (width < 5 || height < 3) return 0;
+    if (row0 < 1) row0 = 1;
+    if (row1 > height - 1) row1 = height - 1;
+    
+    size_t count = 0;
+    size_t last = width - 2;                            //!< first column that is not checked
+    vfloat t = vf_set(threshold);
+    
+	for ( size_t row = row0; row < row1; row++ )
+	{
+        const float *up = image + (row-1)*width, *mid = up + width, *down = mid + width;
+        
+        size_t x = 2;
+        for ( ; x + SEE_VWIDTH <= last; x += SEE_VWIDTH )
+        {
+            vfloat m = vf_max(vf_max(vf_load(up + x - 1), vf_load(up + x)), vf_load(up + x + 1));
+            m = vf_max(m, vf_max(vf_load(mid + x - 1), vf_load(mid + x + 1)));
+            m = vf_max(m, vf_max(vf_max(vf_load(down + x - 1), vf_load(down + x)), vf_load(down + x + 1)));
+            count += vf_count_gt_ge(vf_load(mid + x), t, m);
+        }
+        for ( ; x < last; x++ )
+        {
+            float m = fmaxf(fmaxf(up[x-1], up[x]), up[x+1]);
+            m = fmaxf(m, fmaxf(mid[x-1], mid[x+1]));
+            m = fmaxf(m, fmaxf(fmaxf(down[x-1], down[x]), down[x+1]));
+            if (mid[x] > threshold && mid[x] >= m) count++;
+        }
+	}
+    
+    return count;
+}
+
 /*! Normalize image depending on number of local maximums
 	\param image input image
 	\param width image width
@@ -141,14 +171,14 @@ void see_featuresItti(const unsigned char *array, size_t& width, size_t& height,
 	 
 	If no local maximums are found, <a>image</a> is not modified.
 	 
-	\note this is taking maximas as greater than (not equal) than the neighbors!
+	\note local maximums are greater than half the image maximum and not smaller than their neighbors
  */
 void see_maxNormalize(img& image, size_t width, size_t height)
 {    
 	assert( image != 0 );
     
     float threshold = 0.0;
-    vDSP_maxv(image, 1, &threshold, width*height);
+    see_maxv(image, 1, &threshold, width*height);
     
     // \todo remove if stable...
     if (isnan(threshold) || isinf(threshold)) 
@@ -161,44 +191,13 @@ void see_maxNormalize(img& image, size_t width, size_t height)
     
 	threshold = threshold*0.5; // half maximum
     
-	size_t w = width-2; 
-	img tmp = (float *)malloc(width * sizeof(float));
-	img tmp1 = (float *)malloc(w * sizeof(float));
-
-    float m = 0.0f;
-	
-	
-	for ( int row = 1; row < height - 1; row++ )
-	{
-		// max(top,bottom)
-		vDSP_vmax(image+(row-1)*width, 1, image+(row+1)*width, 1,tmp, 1, width);
-        // max(max(top,bottom), this_row)
-        vDSP_vmax(tmp, 1, image + row*width, 1, tmp, 1, width);
-        
-        // max(left, right)
-        vDSP_vmax(tmp, 1, tmp+2, 1, tmp1, 1, w);
-        // max(max(left, right), middle)
-        vDSP_vmax(tmp1, 1, tmp+1, 1, tmp1, 1, w);
-
-		float *addr = image + row*width + 1;	
-
-		// go linear here because we don't want to convert
-		// image to another type (e.g. char or int) for 
-		// logic bit-wise comparison...
-		for (int col = 1; col < w - 1; col ++)
-		{
-			if (addr[col] > threshold && tmp1[col] == addr[col]) m = m + 1.0;
-		}
-	}
+    float m = (float)see_countLocalMax(image, width, height, threshold, 0, height);
 	
 	if (m > 0)
 	{
 		m = 1.0/sqrt(m);
-		vDSP_vsmul(image,1,&m,image,1,width*height);
+		see_vsmul(image,1,&m,image,1,width*height);
 	}
-
-	free(tmp);
-	free(tmp1);
 }
 
 /*! Accross-scale center-surround operator
@@ -213,27 +212,49 @@ void see_maxNormalize(img& image, size_t width, size_t height)
  */
 img see_centerSurround(img& img1, size_t w1, size_t h1,
                        img& img2, size_t w2, size_t h2)
+{    
+	img scaled = (float *)malloc(w1*h1*sizeof(float));
+    float *buffer = (float *)malloc(see_centerSurroundBufferSize(w1, h1, h2)*sizeof(float));
+    
+    see_centerSurroundWithBuffers(img1, w1, h1, img2, w2, h2, scaled, buffer);
+    
+    free(buffer);
+	
+	return scaled;
+}
+
+/*! Accross-scale center-surround operator without allocating memory
+	\param img1 bigger image
+	\param w1 <a>img1</a> width
+	\param h1 <a>img1</a> height
+	\param img2 smaller image
+	\param w2 <a>img2</a> width
+	\param h2 <a>img2</a> height
+	\param out center surround result (<a>w1</a>*<a>h1</a> floats)
+	\param buffer scratch (see_centerSurroundBufferSize(<a>w1</a>, <a>h1</a>, <a>h2</a>) floats)
+	\note <a>img2</a> should be a subsampled version of <a>img1</a>
+ */
+void see_centerSurroundWithBuffers(const float *img1, size_t w1, size_t h1,
+                                   const float *img2, size_t w2, size_t h2, float *out, float *buffer)
 {    
 	size_t size = w1*h1;
-	img scaled = see_enlarge(w1, h1, img2, w2, h2);
+	see_enlargeWithBuffers(w1, h1, img2, w2, h2, out, buffer);
     
 //    std::cout << "center surround with " << w1 << "x" << h1 
 //              << " and " << w2 << "x" << h2 << std::endl;
     
-    // vDSP_vsub(A, i, B, j, C, k, ...) yields C = B - A.
-	vDSP_vsub(scaled, 1, img1, 1, scaled, 1, size);	
-//	vDSP_vsub(img1, 1, scaled, 1, scaled, 1, size);	
+    // see_vsub(A, i, B, j, C, k, ...) yields C = B - A.
+	see_vsub(out, 1, img1, 1, out, 1, size);	
+//	see_vsub(img1, 1, out, 1, out, 1, size);	
     
 #ifdef DO_DOUBLE_CENTER_SURROUND
     float t = 0;
-    vDSP_vthres (scaled, 1, &t, scaled, 1, size);
+    see_vthres(out, 1, &t, out, 1, size);
 #else
-    vDSP_vabs(scaled, 1, scaled, 1, size);
+    see_vabs(out, 1, out, 1, size);
 #endif
 
-	see_maxNormalize(scaled, w1, h1);
-	
-	return scaled;
+	see_maxNormalize(out, w1, h1);
 }
 
 #ifdef DO_DOUBLE_CENTER_SURROUND
@@ -250,23 +271,40 @@ img see_centerSurround(img& img1, size_t w1, size_t h1,
 img see_centerSurround2(img& img1, size_t w1, size_t h1,
                         img& img2, size_t w2, size_t h2)
 {    
-	size_t size = w1*h1;
-	img scaled = see_enlarge(w1, h1, img2, w2, h2);
-    
-    //    std::cout << "center surround with " << w1 << "x" << h1 
-    //              << " and " << w2 << "x" << h2 << std::endl;
+	img scaled = (float *)malloc(w1*h1*sizeof(float));
+    float *buffer = (float *)malloc(see_centerSurroundBufferSize(w1, h1, h2)*sizeof(float));
     
-    // vDSP_vsub(A, i, B, j, C, k, ...) yields C = B - A.
-	vDSP_vsub(img1, 1, scaled, 1, scaled, 1, size);	
-    //	vDSP_vsub(img1, 1, scaled, 1, scaled, 1, size);	
-    float t = 0;
-    vDSP_vthres (scaled, 1, &t, scaled, 1, size);
-//	vDSP_vabs(scaled, 1, scaled, 1, size);
+    see_centerSurround2WithBuffers(img1, w1, h1, img2, w2, h2, scaled, buffer);
     
-	see_maxNormalize(scaled, w1, h1);
+    free(buffer);
 	
 	return scaled;
 }
+
+/*! Accross-scale center-surround operator (inverse) without allocating memory
+ \param img1 bigger image
+ \param w1 <a>img1</a> width
+ \param h1 <a>img1</a> height
+ \param img2 smaller image
+ \param w2 <a>img2</a> width
+ \param h2 <a>img2</a> height
+ \param out center surround result (<a>w1</a>*<a>h1</a> floats)
+ \param buffer scratch (see_centerSurroundBufferSize(<a>w1</a>, <a>h1</a>, <a>h2</a>) floats)
+ \note <a>img2</a> should be a subsampled version of <a>img1</a>
+ */
+void see_centerSurround2WithBuffers(const float *img1, size_t w1, size_t h1,
+                                    const float *img2, size_t w2, size_t h2, float *out, float *buffer)
+{    
+	size_t size = w1*h1;
+	see_enlargeWithBuffers(w1, h1, img2, w2, h2, out, buffer);
+    
+    // see_vsub(A, i, B, j, C, k, ...) yields C = B - A.
+	see_vsub(img1, 1, out, 1, out, 1, size);	
+    float t = 0;
+    see_vthres(out, 1, &t, out, 1, size);
+    
+	see_maxNormalize(out, w1, h1);
+}
 #endif
 				  
 
@@ -280,6 +318,10 @@ img see_centerSurround2(img& img1, size_t w1, size_t h1,
 	\param saliency saliency map
 	\param salw <a>saliency</a> width
 	\param salh <a>saliency</a> height
+    \param featureInt intensity feature (or NULL if undesired)
+    \param featureRG red-green feature (or NULL if undesired)
+    \param featureBY blue-yellow feature (or NULL if undesired)
+    \param bytesPerRow bytes per row in <a>array</a> (0 if rows are contiguous)
  
 	\note The full size of the pyramid is <a>pyrlev<a/>+<a>surrlev</a>.
 	\note If offset is zero, the firt level of the pyramid is the input image.
@@ -289,7 +331,7 @@ img see_centerSurround2(img& img1, size_t w1, size_t h1,
 void see_saliencyItti(const unsigned char *array, size_t width, size_t height,
 					  size_t pyrlev, size_t offset, size_t surrlev,
 					  img& saliency, size_t& salw, size_t& salh,
-                      img *featureInt, img *featureRG, img *featureBY)
+                      img *featureInt, img *featureRG, img *featureBY, size_t bytesPerRow)
 {
 #ifdef TIME_SALIENCY
     double t = tic();
@@ -304,7 +346,7 @@ void see_saliencyItti(const unsigned char *array, size_t width, size_t height,
 #endif
     
 	// extract features (reduce image first if offset > 0)
-	see_featuresItti(array, width, height, offset, &featInt, &featRG, &featBY);
+	see_featuresItti(array, width, height, offset, &featInt, &featRG, &featBY, bytesPerRow);
     
 #ifdef TIME_SALIENCY
     tFeat = toc(tFeat);
@@ -348,198 +390,373 @@ void see_saliencyItti(const unsigned char *array, size_t width, size_t height,
     \param pyrlev pyramid size
     \param surrlev number of surround levels to consider {1,..,<a>surrlev<a/>}
     \param saliency saliency map
-    \param salw <a>saliency</a> width
-    \param salh <a>saliency</a> height
+    \param pyramids intensity, r-g and b-y pyramids to reuse between calls (or NULL)
 
     \note The full size of the pyramid is <a>pyrlev<a/>+<a>surrlev</a>
+    \note Pass the same three <a>pyramids</a> on every frame to avoid reallocating them. They 
+    are released by the caller with see_freePyramid.
+    \note Use a SaliencyEngine to process a stream of frames without allocating memory.
 
     \todo check parameters
  */
 void see_saliencyIttiWithFeatures(const img featInt, const img featRG, const img featBY, 
                                   size_t width, size_t height, size_t pyrlev, size_t surrlev,
-                                  img& saliency)
+                                  img& saliency, Pyramid *pyramids)
 {
-#ifdef TIME_SALIENCY
-    double t = tic();
-#endif
+    SaliencyEngine engine;
+    if (pyramids != NULL) // borrow the caller's pyramids
+    {
+        for (int c=0; c<3; c++) see_swapPyramids(engine.pyramids[c], pyramids[c]);
+    }
     
-//    std::cout << "input saliency: " << width << "x" << height << std::endl;
+    see_initSaliencyEngine(engine, width, height, pyrlev, surrlev);
+    saliency = (float *)malloc(width*height*sizeof(float));
+    see_saliencyEngineIttiWithFeatures(engine, featInt, featRG, featBY, saliency);
     
-    size_t totlev = pyrlev + surrlev, size = width*height;
-    pyr pyrInt; pyr pyrRG; pyr pyrBY;
-	pyr pyrSurrInt; pyr pyrSurrRG; pyr pyrSurrBY;
+    if (pyramids != NULL) // give them back (they may have grown)
+    {
+        for (int c=0; c<3; c++) see_swapPyramids(engine.pyramids[c], pyramids[c]);
+    }
+    see_freeSaliencyEngine(engine);
+}
+
+#pragma mark SALIENCY ENGINE
+
+/*! Configure a saliency engine
+    \param engine engine
+    \param width feature width
+    \param height feature height
+    \param pyrlev pyramid size
+    \param surrlev number of surround levels to consider {1,..,<a>surrlev<a/>}
+    \param threads threads doing work, including the caller (1 computes everything on the calling thread)
+    \param bands bands of rows each channel is split into (at most SEE_SALIENCY_MAX_BANDS)
+ 
+    Allocates every workspace used by see_saliencyEngineIttiWithFeatures. Nothing is done if 
+    <a>engine</a> is already configured with the same parameters, so this can be called on every 
+    frame. The pyramids are sized by the first frame and reused afterwards.
+ 
+    With <a>threads</a> > 1 the three feature channels run concurrently on a pool that lives as 
+    long as the engine. Bands let more than three threads work on one frame, at the cost of a few 
+    more synchronization points per pyramid level.
+ */
+void see_initSaliencyEngine(SaliencyEngine& engine, size_t width, size_t height, size_t pyrlev, size_t surrlev,
+                            size_t threads, size_t bands)
+{
+    assert(pyrlev > 0 && surrlev > 0 && threads > 0 && bands > 0);
     
-    // build feature pyramids
-#ifdef TIME_SALIENCY
-    double tPyrAvg = 0;
-    double tPyr = tic();
+    if (bands > SEE_SALIENCY_MAX_BANDS) bands = SEE_SALIENCY_MAX_BANDS;
+    if (bands > height) bands = height;
+#ifdef DO_DOUBLE_CENTER_SURROUND
+    bands = 1; // the banded path only computes one center-surround map per pair of levels
 #endif
     
-	see_pyramid(featInt, width, height, totlev, pyrInt, FILTER_GAUS7, FSIZE_GAUS7, 0);
-#ifdef TIME_SALIENCY
-    tPyr = toc(tPyr);
-    tPyrAvg = tPyr / NANOS_IN_MS;
-    tPyr = tic();
-#endif
+    if (engine.data != 0 && engine.width == width && engine.height == height &&
+        engine.pyrlev == pyrlev && engine.surrlev == surrlev && 
+        engine.threads == threads && engine.bands == bands)
+        return;
     
-    see_pyramid(featRG, width, height, totlev, pyrRG, FILTER_GAUS7, FSIZE_GAUS7, 0);
-#ifdef TIME_SALIENCY
-    tPyr = toc(tPyr);
-    tPyrAvg = tPyrAvg + (tPyr / NANOS_IN_MS);
-    tPyr = tic();
-#endif
+    if (engine.threads != threads || (threads > 1 && engine.pool == 0))
+    {
+        see_freeThreadPool(engine.pool);
+        engine.pool = (threads > 1 ? see_createThreadPool(threads) : 0);
+    }
     
-    see_pyramid(featBY, width, height, totlev, pyrBY, FILTER_GAUS7, FSIZE_GAUS7, 0);
-#ifdef TIME_SALIENCY
-    tPyr = toc(tPyr);
-    tPyrAvg = tPyrAvg + (tPyr / NANOS_IN_MS);
-    tPyrAvg = tPyrAvg/3.0;
-    COUT_TIME_LOG_AT("avg(see_pyramid)",tPyrAvg);
-#endif    
-	
-	// set max size of image in pyramids
-	size_t w1 , h1, w2, h2;
-	img surround;
-#ifdef DO_DOUBLE_CENTER_SURROUND
-	img surround2;
-#endif
-	
-#ifdef TIME_SALIENCY
-    double tCenterSurround = tic();
-#endif
+    size_t size = width*height;
+    size_t levelSize = (width >> 1)*(height >> 1);
+    size_t bufferSize = see_centerSurroundBufferSize(width, height, height >> 1);
+    size_t nsurround = 1;
+    engine.bandBufferSize = 0;
+    if (bands > 1)
+    {
+        // every surround map of a level is kept until the level is normalized
+        nsurround = (surrlev > 1 ? surrlev - 1 : 1);
+        engine.bandBufferSize = see_enlargeRowsBufferSize(width, height, height >> 1, (height + bands - 1)/bands);
+        bufferSize = bands*engine.bandBufferSize;
+    }
     
-	// apply accross scale center-surround operations
-	for (int l=0; l<pyrlev; l++)
+    // channels only need their own scratch when they run concurrently
+    size_t scratchSize = nsurround*size + levelSize + bufferSize;
+    size_t nscratch = (threads > 1 ? 3 : 1);
+    
+    free(engine.data);
+    engine.data = (float *)malloc((3*size + nscratch*scratchSize)*sizeof(float));
+    assert(engine.data != 0);
+    
+    for (int c=0; c<3; c++)
+    {
+        float *scratch = engine.data + 3*size + (nscratch > 1 ? c : 0)*scratchSize;
+        engine.conspicuity[c] = engine.data + c*size;
+        engine.surround[c] = scratch;
+        engine.levelSum[c] = scratch + nsurround*size;
+        engine.buffer[c] = engine.levelSum[c] + levelSize;
+    }
+    
+    engine.width = width;
+    engine.height = height;
+    engine.pyrlev = pyrlev;
+    engine.surrlev = surrlev;
+    engine.threads = threads;
+    engine.bands = bands;
+}
+
+/*! Compute the conspicuity map of one feature from its pyramid
+    \param engine engine
+    \param c feature (0 for intensity, 1 for r-g and 2 for b-y)
+ 
+    The center-surround maps of each level are added up at that level's size, and the sum is 
+    enlarged to full size once per level. Enlarging is linear, so this matches enlarging every 
+    map on its own up to the order of the float additions.
+ */
+static void see_saliencyEngineConspicuity(SaliencyEngine& engine, int c)
+{
+    const Pyramid& pyr = engine.pyramids[c];
+    size_t size = engine.width*engine.height;
+    
+	for (int l=0; l<engine.pyrlev; l++)
 	{
 		// set image size at this level
-		w1 = width >> l; h1 = height >> l;
+		size_t w1 = engine.width >> l, h1 = engine.height >> l;
+        float *acc = (l == 0 ? engine.conspicuity[c] : engine.levelSum[c]);
 		
-		for (int s=1; s<surrlev+1; s++)
+		for (int s=1; s<engine.surrlev+1; s++)
 		{
 			// set second image size
-			w2 = w1 >> s; h2 = h1 >> s;
-			
-			// intensity
-			surround = see_centerSurround(pyrInt.at(l), w1, h1, pyrInt.at(l+s), w2, h2);
-#ifdef DO_DOUBLE_CENTER_SURROUND
-			surround2 = see_centerSurround2(pyrInt.at(l), w1, h1, pyrInt.at(l+s), w2, h2);
-#endif
-			if (l) // store result with a size of width*height
-			{
-				img tmp = see_enlarge(width, height, surround, w1, h1);
-				free(surround);
-				surround = tmp;
-#ifdef DO_DOUBLE_CENTER_SURROUND
-				img tmp2 = see_enlarge(width, height, surround2, w1, h1);
-				free(surround2);
-				surround2 = tmp2;
-#endif
-			}
-			pyrSurrInt.push_back(surround);
-#ifdef DO_DOUBLE_CENTER_SURROUND
-			pyrSurrInt.push_back(surround2);
-#endif
-            
-			// r-g
-			surround = see_centerSurround(pyrRG.at(l), w1, h1, pyrRG.at(l+s), w2, h2);
-#ifdef DO_DOUBLE_CENTER_SURROUND
-			surround2 = see_centerSurround2(pyrRG.at(l), w1, h1, pyrRG.at(l+s), w2, h2);
-#endif
-			if (l) // store result with a size of width*height
-			{
-				img tmp = see_enlarge(width, height, surround, w1, h1);
-				free(surround);
-				surround = tmp;
-#ifdef DO_DOUBLE_CENTER_SURROUND
-				img tmp2 = see_enlarge(width, height, surround2, w1, h1);
-				free(surround2);
-				surround2 = tmp2;
-#endif
-			}
-			pyrSurrRG.push_back(surround);
-#ifdef DO_DOUBLE_CENTER_SURROUND
-			pyrSurrRG.push_back(surround2);
-#endif
+			size_t w2 = w1 >> s, h2 = h1 >> s;
+            img center = see_pyramidLevel(pyr, l);
+            img surr = see_pyramidLevel(pyr, l+s);
 			
-			// b-y
-			surround = see_centerSurround(pyrBY.at(l), w1, h1, pyrBY.at(l+s), w2, h2);
-#ifdef DO_DOUBLE_CENTER_SURROUND
-			surround2 = see_centerSurround2(pyrBY.at(l), w1, h1, pyrBY.at(l+s), w2, h2);
-#endif
-			if (l) // store result with a size of width*height
-			{
-				img tmp = see_enlarge(width, height, surround, w1, h1);
-				free(surround);
-				surround = tmp;
+            // the first map of the level initializes its sum
+            float *out = (s == 1 ? acc : engine.surround[c]);
+            see_centerSurroundWithBuffers(center, w1, h1, surr, w2, h2, out, engine.buffer[c]);
+            if (out != acc) see_vadd(acc, 1, out, 1, acc, 1, w1*h1);
 #ifdef DO_DOUBLE_CENTER_SURROUND
-				img tmp2 = see_enlarge(width, height, surround2, w1, h1);
-				free(surround2);
-				surround2 = tmp2;
+            see_centerSurround2WithBuffers(center, w1, h1, surr, w2, h2, engine.surround[c], engine.buffer[c]);
+            see_vadd(acc, 1, engine.surround[c], 1, acc, 1, w1*h1);
 #endif
-			}
-			pyrSurrBY.push_back(surround);
-#ifdef DO_DOUBLE_CENTER_SURROUND
-			pyrSurrBY.push_back(surround2);
-#endif			
 		}
+        
+        if (l) // bring the sum of this level to a size of width*height
+        {
+            see_enlargeWithBuffers(engine.width, engine.height, acc, w1, h1, engine.surround[c], engine.buffer[c]);
+            see_vadd(engine.conspicuity[c], 1, engine.surround[c], 1, engine.conspicuity[c], 1, size);
+        }
 	}
+}
+
+/*! Work shared by the bands of one pyramid level of one channel */
+typedef struct SaliencyLevelJob
+{
+    SaliencyEngine *engine;
+    int c, l;                                                       //!< channel and level
+    size_t w1, h1;                                                  //!< level size
+    float *maps[SEE_PYRAMID_MAX_LEVELS + 1];                        //!< center-surround map of each surround level
+    float maxima[SEE_PYRAMID_MAX_LEVELS + 1][SEE_SALIENCY_MAX_BANDS]; //!< maximum of each map in each band
+    float threshold[SEE_PYRAMID_MAX_LEVELS + 1];                    //!< half the maximum of each map
+    size_t counts[SEE_PYRAMID_MAX_LEVELS + 1][SEE_SALIENCY_MAX_BANDS];//!< local maximums of each map in each band
+    float scale[SEE_PYRAMID_MAX_LEVELS + 1];                        //!< normalization of each map (0 to leave it as is)
+} SaliencyLevelJob;
+
+/*! Rows of a band
+    \param rows image height
+    \param bands number of bands
+    \param b band
+    \param r0 first row of the band
+    \param r1 row after the last one of the band
+ */
+static inline void see_bandRows(size_t rows, size_t bands, size_t b, size_t& r0, size_t& r1)
+{
+    r0 = rows*b/bands;
+    r1 = rows*(b+1)/bands;
+}
+
+/*! Center-surround maps of a level over one band, and their maximums over the band */
+static void see_saliencyBandSurround(void *context, size_t b)
+{
+    SaliencyLevelJob *job = (SaliencyLevelJob *)context;
+    const SaliencyEngine& engine = *job->engine;
+    const Pyramid& pyr = engine.pyramids[job->c];
+    size_t w1 = job->w1, h1 = job->h1, r0, r1;
+    see_bandRows(h1, engine.bands, b, r0, r1);
+    float *buffer = engine.buffer[job->c] + b*engine.bandBufferSize;
+    const float *center = see_pyramidLevel(pyr, job->l) + r0*w1;
+    
+    for (int s=1; s<engine.surrlev+1; s++)
+    {
+        job->maxima[s][b] = -INFINITY;
+        if (r1 == r0) continue;
+        
+        float *out = job->maps[s] + r0*w1;
+        size_t n = (r1 - r0)*w1;
+        see_enlargeRows(w1, h1, see_pyramidLevel(pyr, job->l + s), w1 >> s, h1 >> s, r0, r1 - r0, out, buffer);
+        see_vsub(out, 1, center, 1, out, 1, n);
+        see_vabs(out, 1, out, 1, n);
+        see_maxv(out, 1, &job->maxima[s][b], n);
+    }
+}
+
+/*! Local maximums of the center-surround maps of a level over one band */
+static void see_saliencyBandCount(void *context, size_t b)
+{
+    SaliencyLevelJob *job = (SaliencyLevelJob *)context;
+    size_t r0, r1;
+    see_bandRows(job->h1, job->engine->bands, b, r0, r1);
     
-#ifdef TIME_SALIENCY
-    tCenterSurround = toc(tCenterSurround);
-    tCenterSurround = tCenterSurround / NANOS_IN_MS;
-    COUT_TIME_LOG_AT("all center surround",tCenterSurround);
-#endif
-	
+    for (int s=1; s<job->engine->surrlev+1; s++)
+        job->counts[s][b] = see_countLocalMax(job->maps[s], job->w1, job->h1, job->threshold[s], r0, r1);
+}
+
+/*! Normalize the center-surround maps of a level over one band and add them up */
+static void see_saliencyBandSum(void *context, size_t b)
+{
+    SaliencyLevelJob *job = (SaliencyLevelJob *)context;
+    size_t w1 = job->w1, r0, r1;
+    see_bandRows(job->h1, job->engine->bands, b, r0, r1);
+    size_t n = (r1 - r0)*w1;
+    float *acc = job->maps[1] + r0*w1;
     
-#ifdef TIME_SALIENCY
-    double tConspicuity = tic();
-#endif
+    for (int s=1; s<job->engine->surrlev+1; s++)
+    {
+        float *out = job->maps[s] + r0*w1;
+        if (job->scale[s] != 0) see_vsmul(out, 1, &job->scale[s], out, 1, n);
+        if (s > 1) see_vadd(acc, 1, out, 1, acc, 1, n);
+    }
+}
+
+/*! Enlarge the sum of the maps of a level over one band and add it to the conspicuity map */
+static void see_saliencyBandEnlarge(void *context, size_t b)
+{
+    SaliencyLevelJob *job = (SaliencyLevelJob *)context;
+    const SaliencyEngine& engine = *job->engine;
+    size_t width = engine.width, r0, r1;
+    see_bandRows(engine.height, engine.bands, b, r0, r1);
+    if (r1 == r0) return;
+    
+    float *out = engine.surround[job->c] + r0*width;
+    float *cons = engine.conspicuity[job->c] + r0*width;
+    see_enlargeRows(width, engine.height, job->maps[1], job->w1, job->h1, r0, r1 - r0, out,
+                    engine.buffer[job->c] + b*engine.bandBufferSize);
+    see_vadd(cons, 1, out, 1, cons, 1, (r1 - r0)*width);
+}
+
+/*! Compute the conspicuity map of one feature from its pyramid, splitting each level in bands of rows
+    \param engine engine (with more than one band)
+    \param c feature (0 for intensity, 1 for r-g and 2 for b-y)
+ 
+    Same result as see_saliencyEngineConspicuity. The bands run on the engine's pool; they are 
+    joined to find the maximum of each map, to count its local maximums, and before enlarging 
+    the sum of a level (which reads rows of neighboring bands).
+ */
+static void see_saliencyEngineConspicuityBands(SaliencyEngine& engine, int c)
+{
+    SaliencyLevelJob job;
+    job.engine = &engine;
+    job.c = c;
+    size_t size = engine.width*engine.height;
     
-	// compute conspicuity maps
-	for ( int i = 1; i < pyrSurrInt.size(); i++ )
+	for (int l=0; l<engine.pyrlev; l++)
 	{
-		// intensity
-		vDSP_vadd(pyrSurrInt.at(0),1,pyrSurrInt.at(i),1,pyrSurrInt.at(0),1,size);
-		// r-g
-		vDSP_vadd(pyrSurrRG.at(0),1,pyrSurrRG.at(i),1,pyrSurrRG.at(0),1,size);
-		// b-y
-		vDSP_vadd(pyrSurrBY.at(0),1,pyrSurrBY.at(i),1,pyrSurrBY.at(0),1,size);
+        job.l = l;
+        job.w1 = engine.width >> l;
+        job.h1 = engine.height >> l;
+        
+        // the first map of the level is its sum
+        job.maps[1] = (l == 0 ? engine.conspicuity[c] : engine.levelSum[c]);
+        for (int s=2; s<engine.surrlev+1; s++) job.maps[s] = engine.surround[c] + (s-2)*size;
+        
+        see_threadPoolRun(engine.pool, see_saliencyBandSurround, &job, engine.bands);
+        for (int s=1; s<engine.surrlev+1; s++)
+        {
+            float maxv = job.maxima[s][0];
+            for (size_t b=1; b<engine.bands; b++)
+                if (job.maxima[s][b] > maxv || isnan(job.maxima[s][b])) maxv = job.maxima[s][b];
+            job.threshold[s] = maxv*0.5;
+            job.scale[s] = (isnan(maxv) || isinf(maxv) ? 0 : 1);  // as see_maxNormalize
+        }
+        
+        see_threadPoolRun(engine.pool, see_saliencyBandCount, &job, engine.bands);
+        for (int s=1; s<engine.surrlev+1; s++)
+        {
+            size_t m = 0;
+            for (size_t b=0; b<engine.bands; b++) m += job.counts[s][b];
+            job.scale[s] = (job.scale[s] != 0 && m > 0 ? 1.0/sqrt((float)m) : 0);
+        }
+        
+        see_threadPoolRun(engine.pool, see_saliencyBandSum, &job, engine.bands);
+        
+        if (l) // bring the sum of this level to a size of width*height
+            see_threadPoolRun(engine.pool, see_saliencyBandEnlarge, &job, engine.bands);
 	}
+}
+
+/*! Work shared by the three channels of a frame */
+typedef struct SaliencyChannelJob
+{
+    SaliencyEngine *engine;
+    img feat[3];                    //!< intensity, r-g and b-y features
+} SaliencyChannelJob;
+
+/*! Pyramid, conspicuity map and conspicuity normalization of one channel */
+static void see_saliencyEngineChannel(void *context, size_t c)
+{
+    SaliencyChannelJob *job = (SaliencyChannelJob *)context;
+    SaliencyEngine& engine = *job->engine;
+    
+    see_pyramid(job->feat[c], engine.width, engine.height, engine.pyrlev + engine.surrlev,
+                engine.pyramids[c], FILTER_GAUS7, FSIZE_GAUS7, 0);
     
-	see_maxNormalize(pyrSurrInt.at(0), width, height);
-	see_maxNormalize(pyrSurrRG.at(0), width, height);
-	see_maxNormalize(pyrSurrBY.at(0), width, height);
-	vDSP_vadd(pyrSurrRG.at(0),1,pyrSurrBY.at(0),1,pyrSurrRG.at(0),1,size);
-	see_maxNormalize(pyrSurrRG.at(0), width, height); // store color conspicuity in top RG
+    if (engine.bands > 1) see_saliencyEngineConspicuityBands(engine, (int)c);
+    else see_saliencyEngineConspicuity(engine, (int)c);
+    
+    see_maxNormalize(engine.conspicuity[c], engine.width, engine.height);
+}
+
+/*! Simplified version of Itti's saliency method given intensity, r-g and b-y features
+    \param engine engine configured with see_initSaliencyEngine
+    \param featInt intensity feature
+    \param featRG red-green feature
+    \param faetBY blue-yellow features
+    \param saliency saliency map (<a>engine</a> width times height floats, provided by the caller)
+ 
+    Same result as see_saliencyIttiWithFeatures, but all the work is done in the workspaces of 
+    <a>engine</a>: once its pyramids have been sized by the first frame, no memory is allocated.
+ */
+void see_saliencyEngineIttiWithFeatures(SaliencyEngine& engine, const img featInt, const img featRG, 
+                                        const img featBY, img saliency)
+{
+    assert(engine.data != 0 && saliency != 0);
     
 #ifdef TIME_SALIENCY
-    tConspicuity = toc(tConspicuity);
-    tConspicuity = tConspicuity / NANOS_IN_MS;
-    COUT_TIME_LOG_AT("all conspicuity",tConspicuity);
+    double t = tic();
 #endif
-	
+    
+    size_t width = engine.width, height = engine.height, size = width*height;
+    
 #ifdef TIME_SALIENCY
-    double tMerge = tic();
+    double tChannels = tic();
 #endif
     
-	// combine conspicuity maps and store final result
-	saliency = (float *)malloc(size*sizeof(float));
-	float divfactor = 0.5;
-	vDSP_vadd(pyrSurrInt.at(0),1,pyrSurrRG.at(0),1,pyrSurrInt.at(0),1,size);
-	vDSP_vsmul(pyrSurrInt.at(0),1,&divfactor,saliency,1,size);
+    // build feature pyramids, apply accross scale center-surround operations and add them up into 
+    // normalized conspicuity maps (one task per channel)
+    SaliencyChannelJob job;
+    job.engine = &engine;
+    job.feat[0] = featInt; job.feat[1] = featRG; job.feat[2] = featBY;
+    see_threadPoolRun(engine.pool, see_saliencyEngineChannel, &job, 3);
     
 #ifdef TIME_SALIENCY
-    tMerge = toc(tMerge);
-    tMerge = tMerge / NANOS_IN_MS;
-    COUT_TIME_LOG_AT("final merge",tMerge);
+    tChannels = toc(tChannels);
+    tChannels = tChannels / NANOS_IN_MS;
+    COUT_TIME_LOG_AT("all channels",tChannels);
 #endif
-    
-	// be good with the environment
-	see_freePyr(pyrSurrInt); see_freePyr(pyrSurrRG); see_freePyr(pyrSurrBY);
-    pyrInt.erase(pyrInt.begin());
-    pyrRG.erase(pyrRG.begin());
-    pyrBY.erase(pyrBY.begin());
-	see_freePyr(pyrInt); see_freePyr(pyrRG); see_freePyr(pyrBY);    
+	
+	// compute color conspicuity
+    float *consInt = engine.conspicuity[0], *consRG = engine.conspicuity[1], *consBY = engine.conspicuity[2];
+	see_vadd(consRG,1,consBY,1,consRG,1,size);
+	see_maxNormalize(consRG, width, height); // store color conspicuity in RG
+	
+	// combine conspicuity maps and store final result
+	float divfactor = 0.5;
+	see_vadd(consInt,1,consRG,1,consInt,1,size);
+	see_vsmul(consInt,1,&divfactor,saliency,1,size);
     
 #ifdef TIME_SALIENCY
     t = toc(t);
@@ -548,4 +765,20 @@ void see_saliencyIttiWithFeatures(const img featInt, const img featRG, const img
 #endif
 }
 
-
+/*! Release the workspaces of a saliency engine
+    \param engine engine (it can be configured again with see_initSaliencyEngine)
+ */
+void see_freeSaliencyEngine(SaliencyEngine& engine)
+{
+    see_freeThreadPool(engine.pool);
+    free(engine.data);
+    for (int c=0; c<3; c++) see_freePyramid(engine.pyramids[c]);
+    
+    // back to the state of a new engine (pyramids are not copyable)
+    engine.width = engine.height = 0;
+    engine.pyrlev = engine.surrlev = 0;
+    engine.threads = engine.bands = 1;
+    engine.pool = 0;
+    engine.data = 0;
+    engine.bandBufferSize = 0;
+}
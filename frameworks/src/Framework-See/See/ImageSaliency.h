@@ -44,16 +44,57 @@ extern "C" {
 #pragma mark SALIENCY ITTI
 
 void see_featuresItti(const unsigned char *array, size_t& width, size_t& height, unsigned int shrinkingTimes,
-                      img *featInt, img *featRG, img *featBY);
+                      img *featInt, img *featRG, img *featBY, size_t bytesPerRow = 0);
     
 void see_saliencyItti(const unsigned char *array, size_t width, size_t height,
 					  size_t pyrlev, size_t offset, size_t surrlev,
 					  img& saliency, size_t& salw, size_t& salh, 
-                      img *featureInt = NULL, img *featureRG = NULL, img *featureBY = NULL);
+                      img *featureInt = NULL, img *featureRG = NULL, img *featureBY = NULL,
+                      size_t bytesPerRow = 0);
 
 void see_saliencyIttiWithFeatures(const img featInt, const img featRG, const img featBY, 
                       size_t width, size_t height, size_t pyrlev, size_t surrlev,
-                      img& saliency);    
+                      img& saliency, Pyramid *pyramids = NULL);    
+    
+#pragma mark SALIENCY ENGINE
+    
+#define SEE_SALIENCY_MAX_BANDS 16     //!< maximum number of row bands per feature channel
+
+/**
+ Saliency context for a stream of frames of the same size. It owns the feature pyramids and 
+ every intermediate map, so computing saliency does not allocate memory once the first frame 
+ has been processed. Release with see_freeSaliencyEngine.
+ 
+ With more than one thread, the intensity, r-g and b-y channels are processed concurrently by 
+ a persistent pool and only meet when their conspicuity maps are added up. Each channel can 
+ also split its center-surround maps into bands of rows. Every thread configuration yields 
+ exactly the same saliency map.
+ */
+typedef struct SaliencyEngine
+{
+    size_t width, height;           //!< feature size
+    size_t pyrlev, surrlev;         //!< pyramid size and number of surround levels
+    size_t threads, bands;          //!< threads doing work (including the caller) and row bands per channel
+    struct ThreadPool *pool;        //!< workers (NULL with a single thread)
+    Pyramid pyramids[3];            //!< intensity, r-g and b-y pyramids
+    float *data;                    //!< workspace holding the maps below
+    float *conspicuity[3];          //!< intensity, r-g and b-y conspicuity maps
+    float *surround[3];             //!< center-surround results of each channel
+    float *levelSum[3];             //!< sum of the center-surround maps of one level (l > 0) of each channel
+    float *buffer[3];               //!< scratch for enlarging of each channel (one slice per band)
+    size_t bandBufferSize;          //!< floats in each band slice of <a>buffer</a>
+    
+    SaliencyEngine() : width(0), height(0), pyrlev(0), surrlev(0), threads(1), bands(1), pool(0), 
+                       data(0), bandBufferSize(0) {}
+} SaliencyEngine;
+    
+void see_initSaliencyEngine(SaliencyEngine& engine, size_t width, size_t height, size_t pyrlev, size_t surrlev,
+                            size_t threads = 1, size_t bands = 1);
+    
+void see_saliencyEngineIttiWithFeatures(SaliencyEngine& engine, const img featInt, const img featRG, 
+                                        const img featBY, img saliency);
+    
+void see_freeSaliencyEngine(SaliencyEngine& engine);
 	
 #if __cplusplus
 }
@@ -31,18 +31,12 @@
 //	THE SOFTWARE.
 
 #include <assert.h>
-#include <Accelerate/Accelerate.h>
+#include <math.h>
+#include <string.h>
+#include "SeeVector.h"
 #include "ImageSegmentation.h"
 #include "ImageConversion.h"
-
-#pragma mark PRIVATE PROTOTYPES
-
-bool see_tracer( int &point, int &row, int &col, const img image, size_t w, size_t h, 
-                img labels, int label, char& contourPoint);
-void see_contourTracing( const img image, size_t w, size_t h, 
-                        img labels, int row, int col, int point,
-                        int label, char neighbor );
-
+#include "SeeThreadPool.h"
 
 #pragma mark THRESHOLDING
 
@@ -69,181 +63,324 @@ void see_threshold(img *image, size_t size, float threshold, float scale)
 		see_scaleTo(*image, size, scale);
 	}
 	
-	vDSP_vthres(*image, 1, &threshold, *image, 1, size);
+	see_vthres(*image, 1, &threshold, *image, 1, size);
 	
 }
 
 
 #pragma mark BLOBS
 
-// pixel/label type
 #define CC_BLANK	 0.0f			//!< empty pixel
 
-// neighbors ordering
-#define CC_NEIGHBOR_RIGHT		0	//!< right neighbor
-#define CC_NEIGHBOR_DOWNRIGHT	1	//!< lower-right neighbor
-#define CC_NEIGHBOR_DOWN		2	//!< lower neighbor
-#define CC_NEIGHBOR_DOWNLEFT	3	//!< lower-left neighbor
-#define CC_NEIGHBOR_LEFT		4	//!< left neighbor
-#define CC_NEIGHBOR_LEFTUP		5	//!< upper-left neighbor
-#define CC_NEIGHBOR_UP			6	//!< upper neighbor
-#define CC_NEIGHBOR_UPRIGHT		7	//!< upper-right neighbor
+/*
+	Provisional labels are 1 + the index of a pixel of the same component, so the label image
+	doubles as the parent array of a union-find forest (background pixels are 0). A pixel only
+	points to itself or to an earlier pixel, and unions keep the earliest root, so every root
+	is the first pixel of its component in raster order.
+ */
 
-/*! Find next point in contour
-	\param point position along image array (initial point as input, prev point as output)
-	\param row <a>point</a> row
-	\param col <a>point</a> col
-	\param image binary image
-	\param w <a>image</a> width
-	\param h <a>image</a> height 
-	\param labels labels Mat
-	\param label contour label
-	\param contourPoint previous (input) and future contour point (output)
-	\return true if ini point is not isolated
- 
-	<a>tracer()</a> takes charge of marking surrounding contour points.
- 
-	<a>tracer()</a> starts looking for the next contour point from 
-	<a>contourPoint</a>. After the routine finishes, the position of 
-	<a>next</a> is returned in <a>contourPoint</a>. 
+/*! Root of the tree holding pixel <a>p</a> (with path halving) */
+static inline int32_t see_ccFind(int32_t *labels, int32_t p)
+{
+	while (labels[p] != p + 1)
+	{
+		int32_t q = labels[p] - 1;
+		labels[p] = labels[q];
+		p = labels[p] - 1;
+	}
+	return p;
+}
+
+/*! Join the trees holding pixels <a>a</a> and <a>b</a> (the earliest root is kept) */
+static inline void see_ccUnion(int32_t *labels, int32_t a, int32_t b)
+{
+	a = see_ccFind(labels, a);
+	b = see_ccFind(labels, b);
+	if (a < b) labels[b] = a + 1;
+	else if (b < a) labels[a] = b + 1;
+}
+
+/*! Eight mask bytes (unaligned) */
+static inline uint64_t see_ccWord(const unsigned char *p)
+{
+	uint64_t v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+/** Provisional labels of a strip of rows
+	\param mask binary image (non-zero pixels are foreground)
+	\param w <a>mask</a> width
+	\param labels label image
+	\param r0 first row of the strip
+	\param r1 row after the last row of the strip
  
-	\note <a>tracer</a> is a subroutine used by <a>contourTracing</a> to
-	trace (external or internal) contours along a binary image.
+	Rows are scanned as runs of foreground pixels. Every pixel of a run points to the first one,
+	which is joined once with each run of the row above that touches it (8-connectivity). Rows
+	above <a>r0</a> are ignored; strips are joined by see_ccMergeRow.
  */
-bool see_tracer( int &point, int &row, int &col, const img image, size_t w, size_t h, 
-				 img labels, int label, char& contourPoint)
+static void see_ccLabelStrip(const unsigned char *mask, size_t w, int32_t *labels, size_t r0, size_t r1)
 {
-	char initialContourPoint = contourPoint;
-	bool gotNextPoint = false;
-	bool outOfBounds = false;
-	int nextPoint = 0;
-	
-	do { // check for next contour point in neighboring pixels
-		
-		switch (contourPoint) {
-			case CC_NEIGHBOR_RIGHT: // point (col + 1, row )
-				outOfBounds = (col + 1) == w; 
-				nextPoint = point + 1;
-				break;
-			case CC_NEIGHBOR_DOWNRIGHT: // point (col + 1, row + 1)
-				outOfBounds = ((row + 1) == h) || ((col + 1) == w); 
-				nextPoint = point + 1 + w;
-				break;
-			case CC_NEIGHBOR_DOWN: // point (col, row + 1)
-				outOfBounds = ((row + 1) == h);
-				nextPoint = point + w;
-				break;
-			case CC_NEIGHBOR_DOWNLEFT: // point (col + 1, row - 1)
-				outOfBounds = ((row + 1) == h) || ((col - 1) == -1);
-				nextPoint = point + w - 1;
-				break;
-			case CC_NEIGHBOR_LEFT: // point (col, row - 1)
-				outOfBounds = (col - 1) == -1;
-				nextPoint = point - 1;
-				break;
-			case CC_NEIGHBOR_LEFTUP: // point (col - 1, row - 1)
-				outOfBounds = ((row - 1) == -1) || ((col - 1) == -1);
-				nextPoint = point - w - 1;
-				break;
-			case CC_NEIGHBOR_UP: // point (col, row - 1)
-				outOfBounds = (row - 1) == -1;
-				nextPoint = point - w;
-				break;
-			case CC_NEIGHBOR_UPRIGHT: // point (col + 1, row - 1)
-				outOfBounds = ((row - 1) == -1) || ((col + 1) == w);
-				nextPoint = point - w + 1;
-				break;
+	for (size_t r=r0; r<r1; r++)
+	{
+		const unsigned char *m = mask + r*w, *u = m - w;
+		int32_t *l = labels + r*w;
+		int32_t rowStart = (int32_t)(r*w);
+		memset(l, 0, w*sizeof(int32_t));
+		size_t c = 0;
+		while (c < w)
+		{
+			// skip background, a word at a time
+			while (c + 8 <= w && see_ccWord(m + c) == 0) c += 8;
+			if (c >= w) break;
+			if (!m[c]) { c++; continue; }
+			
+			size_t c0 = c;
+			while (c < w && m[c]) c++;
+			int32_t p0 = rowStart + (int32_t)c0;
+			
+			// pixels of the run point to its first pixel, which starts as a root
+			for (size_t k=c0; k<c; k++) l[k] = p0 + 1;
+			if (r == r0) continue;
+			
+			// join with every run above, from column c0 - 1 to column c
+			size_t a = (c0 > 0 ? c0 - 1 : 0), b = (c < w ? c : w - 1);
+			bool linked = false;
+			for (size_t k=a; k<=b; k++)
+			{
+				if (!u[k] || (k > a && u[k-1])) continue;
+				int32_t q = rowStart - (int32_t)w + (int32_t)k;
+				if (!linked) { l[c0] = see_ccFind(labels, q) + 1; linked = true; }
+				else see_ccUnion(labels, p0, q);
+			}
 		}
-		
-		if ( !outOfBounds )
-		{ 
-			if (image[nextPoint] != CC_BLANK) {
-				gotNextPoint = true;
-				labels[nextPoint] = (float)label;
-			} else {
-				// mark surrounding
-				assert( labels[nextPoint] == CC_UNLABELED || labels[nextPoint] == CC_SURROUNDING );
-				labels[nextPoint] = CC_SURROUNDING;
-			}	
+	}
+}
+
+/*! Join the components of row <a>r</a> with those of the row above (the first row of a strip) */
+static void see_ccMergeRow(const unsigned char *mask, size_t w, int32_t *labels, size_t r)
+{
+	const unsigned char *m = mask + r*w, *u = m - w;
+	int32_t p = (int32_t)(r*w);
+	for (size_t c=0; c<w; c++, p++)
+	{
+		if (!m[c]) continue;
+		if (u[c]) see_ccUnion(labels, p, p - (int32_t)w);
+		else
+		{
+			// upper neighbors are not connected to each other through u[c]
+			if (c > 0 && u[c-1]) see_ccUnion(labels, p, p - (int32_t)w - 1);
+			if (c+1 < w && u[c+1]) see_ccUnion(labels, p, p - (int32_t)w + 1);
 		}
-		
-		contourPoint = (contourPoint + 1) % 8;
-		
-	} while ( !gotNextPoint && contourPoint != initialContourPoint );
+	}
+}
+
+/*! Strips labeled by each task of see_labelComponents */
+typedef struct CCStripJob
+{
+	const unsigned char *mask;
+	size_t w, h;
+	int32_t *labels;
+	size_t strips;
+} CCStripJob;
+
+static void see_ccStripTask(void *context, size_t index)
+{
+	const CCStripJob *job = (const CCStripJob *)context;
+	size_t r0 = index*job->h/job->strips, r1 = (index + 1)*job->h/job->strips;
+	see_ccLabelStrip(job->mask, job->w, job->labels, r0, r1);
+}
+
+#define CC_MIN_STRIP_ROWS 16	//!< rows of the smallest strip labeled by a task
 
-	// set nextCol and nextRow after all these so we don't do 
-	// way more assignments than necessary!
-	switch (contourPoint) {
-		case CC_NEIGHBOR_RIGHT: // prev UPRIGHT
-			col = col + 1; row = row - 1;
-			break;
-		case CC_NEIGHBOR_DOWNRIGHT: // prev RIGHT
-			col = col + 1; 
-			break;
-		case CC_NEIGHBOR_DOWN: // prev DOWNRIGHT
-			col = col + 1; row = row + 1;
-			break;
-		case CC_NEIGHBOR_DOWNLEFT: // prev DOWN
-			row = row + 1;
-			break;
-		case CC_NEIGHBOR_LEFT: // prev DOWNLEFT
-			col = col - 1; row = row + 1;
-			break;
-		case CC_NEIGHBOR_LEFTUP: /// prev LEFT
-			col = col - 1; 
-			break;
-		case CC_NEIGHBOR_UP: // prev LEFTUP
-			col = col - 1; row = row - 1;
-			break;
-		case CC_NEIGHBOR_UPRIGHT: // prev UP
-			row = row - 1;
-			break;
+/*! Provisional labels of the whole mask (strips are labeled concurrently if <a>pool</a> is not NULL) */
+static void see_ccProvisionalLabels(const unsigned char *mask, size_t w, size_t h, int32_t *labels, 
+									struct ThreadPool *pool)
+{
+	if (w*h == 0) return;
+	assert(w*h < (size_t)INT32_MAX);
+	
+	size_t strips = (pool != NULL ? see_threadPoolSize(pool) : 1);
+	if (strips > h/CC_MIN_STRIP_ROWS) strips = h/CC_MIN_STRIP_ROWS;
+	if (strips < 1) strips = 1;
+	
+	CCStripJob job = {mask, w, h, labels, strips};
+	see_threadPoolRun(strips > 1 ? pool : NULL, see_ccStripTask, &job, strips);
+	for (size_t s=1; s<strips; s++)
+		see_ccMergeRow(mask, w, labels, s*h/strips);
+}
+
+/*! Initial statistics of a component whose first pixel is at (<a>col</a>,<a>row</a>) */
+static inline void see_ccInitStats(BlobStats *b, size_t col, size_t row, float v)
+{
+	b->count = 0;
+	b->sum = b->sumx = b->sumy = 0.0;
+	b->minval = b->maxval = v;
+	b->x1 = b->x2 = col;
+	b->y1 = b->y2 = row;
+}
+
+/** Replace provisional labels with consecutive ones
+	\param labels label image with provisional labels
+	\param w image width
+	\param h image height
+	\param values pixel values weighting the statistics (NULL weights all pixels by 1)
+	\param offset added to <a>values</a>
+	\param stats statistics per component (NULL skips them)
+	\return number of components
+ 
+	Parents precede their children, so they already hold their final label when reached.
+ */
+static int32_t see_ccResolve(int32_t *labels, size_t w, size_t h, const float *values, float offset, 
+							 BlobStats **stats)
+{
+	int32_t n = 0, size = (int32_t)(w*h);
+	if (stats == NULL)
+	{
+		for (int32_t p=0; p<size; p++)
+		{
+			int32_t l = labels[p];
+			if (l == 0) continue;
+			labels[p] = (l == p + 1 ? ++n : labels[l - 1]);
+		}
+		return n;
 	}
-	point = nextPoint;
 	
-	// add 1 to contourPoint so next call to trace starts appropriately
-	contourPoint = (contourPoint + 5) % 8;
+	int32_t capacity = 64;
+	BlobStats *s = (BlobStats *)malloc(capacity*sizeof(BlobStats));
+	int32_t p = 0;
+	for (size_t row=0; row<h; row++)
+	{
+		for (size_t col=0; col<w; col++, p++)
+		{
+			int32_t l = labels[p];
+			if (l == 0) continue;
+			float v = (values != NULL ? values[p] + offset : 1.0f);
+			
+			BlobStats *b;
+			if (l == p + 1)
+			{
+				if (n == capacity)
+				{
+					capacity *= 2;
+					s = (BlobStats *)realloc(s, capacity*sizeof(BlobStats));
+				}
+				b = s + n;
+				labels[p] = ++n;
+				see_ccInitStats(b, col, row, v);
+			}
+			else 
+			{
+				labels[p] = labels[l - 1];
+				b = s + labels[p] - 1;
+				if (v < b->minval) b->minval = v;
+				if (v > b->maxval) b->maxval = v;
+				if (col < b->x1) b->x1 = col;
+				if (col > b->x2) b->x2 = col;
+				b->y2 = row;
+			}
+			
+			b->count++;
+			b->sum += v;
+			b->sumx += (double)v*col;
+			b->sumy += (double)v*row;
+		}
+	}
 	
-	return gotNextPoint;	
+	*stats = s;
+	return n;
 }
 
-/*! Finds and labels internal or external contour from a starting point
-	\param image binary image
-	\param w <a>image</a> width
-	\param h <a>image</a> height
-	\param labels labels Mat
-	\param row initial row
-	\param col initial col
-	\param point position along image array (row*width + col)
-	\param label label to mark with
-	\param neighbor starting neighbor
+/** Label connected components (8-connectivity) in a binary mask
+	\param mask binary image (non-zero pixels are foreground)
+	\param w <a>mask</a> width
+	\param h <a>mask</a> height
+	\param labels label image (w*h; 0 for background, components are labeled from 1)
+	\param pool threads that label horizontal strips concurrently (NULL labels the whole image in the calling thread)
+	\return number of components
+ 
+	Union-find labeling: each strip of rows gets provisional labels in a single scan, strips are
+	joined along their boundary rows, and a last scan replaces provisional labels with consecutive 
+	ones. Components are numbered in raster order of their first pixel, as see_labelBlobs did.
  */
-void see_contourTracing( const img image, size_t w, size_t h, 
-						 img labels, int row, int col, int point,
-						 int label, char neighbor )
+size_t see_labelComponents(const unsigned char *mask, size_t w, size_t h, int32_t *labels, struct ThreadPool *pool)
 {
-	int nextPoint = point, nextRow = row, nextCol = col, currentPoint;
-	bool justPassedIniPoint = true;
+	see_ccProvisionalLabels(mask, w, h, labels, pool);
+	return see_ccResolve(labels, w, h, NULL, 0.0f, NULL);
+}
+
+/** Label connected components (8-connectivity) and gather their statistics
+	\param mask binary image (non-zero pixels are foreground)
+	\param values pixel values (w*h) weighting the statistics (NULL weights all pixels by 1)
+	\param w <a>mask</a> width
+	\param h <a>mask</a> height
+	\param labels label image (w*h; 0 for background, components are labeled from 1)
+	\param stats statistics per component (component <a>l</a> at index <a>l</a>-1; free it when done)
+	\param pool threads that label horizontal strips concurrently (NULL labels the whole image in the calling thread)
+	\return number of components
+ 
+	Same as see_labelComponents, with the statistics accumulated in the scan that assigns the
+	final labels.
+ */
+size_t see_labelComponentStats(const unsigned char *mask, const float *values, size_t w, size_t h, 
+							   int32_t *labels, BlobStats **stats, struct ThreadPool *pool)
+{
+	assert(stats != NULL);
 	
-	assert(image[point] != CC_BLANK);
+	see_ccProvisionalLabels(mask, w, h, labels, pool);
+	return see_ccResolve(labels, w, h, values, 0.0f, stats);
+}
+
+/** Centroid of the most meaningful blob of a saliency map
+	\param saliency saliency map (not modified)
+	\param w <a>saliency</a> width
+	\param h <a>saliency</a> height
+	\param x horizontal component of the blob's weighted mean
+	\param y vertical component of the blob's weighted mean
+	\param labels optional labels matrix (allocated; blobs labeled from 1)
+	\param pool threads for labeling (see see_labelComponents)
+	\return selected label (0 if no blob is meaningful)
+ 
+	Same result as see_uniformThresh, see_labelBlobs, see_selectMostMeaningfulBlob (discretized) 
+	and see_weightedMean, without a thresholded copy of the map: the minimum and the sum come 
+	from a single reduction, the mask is built against the derived threshold, and blobs are
+	selected from statistics gathered while labeling. <a>x</a> and <a>y</a> are set to the 
+	center of the map when no blob is meaningful.
+ */
+float see_salientBlobCentroid(const img saliency, size_t w, size_t h, float &x, float &y, 
+							  img *labels, struct ThreadPool *pool)
+{
+	size_t size = w*h;
+	float minimum = 0.0f, sum = 0.0f;
+	see_minsve(saliency, 1, &minimum, &sum, size);
 	
-	// tracer returns false if nextPoint is isolated
-	if (!see_tracer( nextPoint, nextRow, nextCol, image, w, h, labels, label, 
-					 neighbor )) return;
-	currentPoint = nextPoint;
+	// uniform threshold of the map displaced to a zero minimum
+	float thr = (float)(((double)sum - (double)minimum*size)/size);
+	unsigned char *mask = (unsigned char *)malloc(size);
+	if (thr > 0.0f)
+	{
+		for (size_t p=0; p<size; p++) mask[p] = (saliency[p] - minimum >= thr);
+	}
+	else memset(mask, 0, size);
 	
-	for (;;){
-		
-		see_tracer( currentPoint, nextRow, nextCol, image, w, h, labels, label, 
-				    neighbor );
+	int32_t *ilabels = (int32_t *)malloc(size*sizeof(int32_t));
+	BlobStats *stats = 0;
+	see_ccProvisionalLabels(mask, w, h, ilabels, pool);
+	int nlabels = see_ccResolve(ilabels, w, h, saliency, -minimum, &stats);
+	free(mask);
 	
-		// stop if we looped along contour
-		if (justPassedIniPoint && currentPoint == nextPoint) break;
-		
-		if (currentPoint == point) justPassedIniPoint = true;
-		else justPassedIniPoint = false;
-		
+	float selected = see_selectMostMeaningfulBlobStats(stats, nlabels, size, true);
+	see_blobWeightedMean(stats, w, h, selected, x, y);
+	free(stats);
+	
+	if (labels)
+	{
+		*labels = (float *)malloc(size*sizeof(float));
+		see_vflt32(ilabels, 1, *labels, 1, size);
 	}
+	free(ilabels);
+	
+	return selected;
 }
 
 /*! Label blobs (8-connected components) in binary image
@@ -251,72 +388,28 @@ void see_contourTracing( const img image, size_t w, size_t h,
 	\param w <a>image</a> width
 	\param h <a>image</a> height
 	\param nlabels number of blobs found
+	\param stats optional statistics per blob, weighted by <a>image</a> (blob <a>l</a> at index <a>l</a>-1)
 	\return labels matrix of connected labels
  
-	Finds connected components using F. Chang, C-J Chen, and C-J Lu
-	"A Linear-Time Component-Labeling Algorithm Using Contour Tracing Technique".
+	Float interface to see_labelComponents and see_labelComponentStats.
  
 	 \note <a>image</a> is assumed to have black background and white foreground (blobs). 
 	 Blobs are labeled from 1 to nlabels.
  */
-img see_labelBlobs(const img image, size_t w, size_t h, int &nlabels)
+img see_labelBlobs(const img image, size_t w, size_t h, int &nlabels, BlobStats **stats)
 {
 	size_t size = w*h;
-	img labels = (float*)calloc(size,sizeof(float));
-	nlabels = 0;
+	img labels = (float*)malloc(size*sizeof(float));
+	unsigned char *mask = (unsigned char *)malloc(size);
 	
-	int lastRow = h - 1;
-	
-	int row = 0, col = 0, p = 0; 
-	for ( row = 0; row < h; row++ )
-	{
-		for ( col = 0; col < w; col++ )
-		{
-			float c = image[p];         // current pixel
-			float& l = labels[p];		// current label
-			
-			if ( c == CC_BLANK ) { p++; continue;}	// nothing to do with empty pixel
-			
-			if ( l == CC_UNLABELED &&
-				 ( row == 0 || image[p-w] == CC_BLANK ))
-			{
-				// external contour
-				nlabels++;
-				l = (float)nlabels;
-				see_contourTracing(image, w, h, labels, row, col, p, l, CC_NEIGHBOR_UPRIGHT);
-			}
-			else if (( row == lastRow && l == CC_UNLABELED ) ||
-//					 ( labels[p+w] == CC_UNLABELED && image[p+w] == CC_BLANK ))
-					 ( row != lastRow && labels[p+w] == CC_UNLABELED && image[p+w] == CC_BLANK ))
-			{
-				// internal contour
-				if ( l == CC_UNLABELED )
-				{
-					// use label of left neighbor
-					l = labels[p-1];
-				}
-				
-				see_contourTracing(image, w, h, labels, row, col, p, l, CC_NEIGHBOR_DOWNLEFT);
-			}
-			else
-			{
-				// c is not a contour point
-				// we simply copy the label of the neighbor
-				if ( l == CC_UNLABELED )
-					l = labels[p-1];
-			}
-					 
-			p++;
-		}
-	}
-	
-	// forget about surrounding label...
-	// this operation could be accelerated by separating the surrounding
-	// flags to another array, and then passing this array to all other 
-	// functions in order to maintain consistency
-	float t = 0.0f;
-	vDSP_vthres(labels, 1, &t, labels, 1, size);
+	// integer labels are written in place of the float ones, then converted
+	for (size_t p=0; p<size; p++) mask[p] = (image[p] != CC_BLANK);
+	int32_t *ilabels = (int32_t *)labels;
+	if (stats) nlabels = (int)see_labelComponentStats(mask, image, w, h, ilabels, stats);
+	else nlabels = (int)see_labelComponents(mask, w, h, ilabels);
+	see_vflt32(ilabels, 1, labels, 1, size);
 	
+	free(mask);
 	return labels;
 }
 
@@ -368,7 +461,7 @@ void see_highlightBlob(const img labels, size_t size,
 	if ( *highlight == 0 )
 	{
 		*highlight = (float *)malloc(size*sizeof(float));
-		vDSP_vclr(*highlight,1,size);
+		see_vclr(*highlight,1,size);
 	}
 	
 	if (label != 0)
@@ -383,6 +476,26 @@ void see_highlightBlob(const img labels, size_t size,
 	}
 }
 
+/*! Meaningfulness threshold for blob entropies, assuming a uniform distribution
+	\param size number of bins (pixels)
+	\param M total number of samples
+ */
+static inline float see_meaningfulnessThreshold(size_t size, float M)
+{
+	return (log((float)size*(size + 1.0)) - log(2.0))/M;
+}
+
+/*! Relative entropy of a blob
+	\param r proportion of samples in the blob
+	\param p proportion of bins in the blob
+ */
+static inline float see_relativeEntropy(float r, float p)
+{
+	if ( r <= p ) return 0;
+	return (r*(log(r)/log(2) - log(p)/log(2)) + 
+			(1-r)*(log(1-r)/log(2) - log(1-p)/log(2)));
+}
+
 /*! Select most meaningful blob
 	\param image segmented image
 	\param size <a>image</a> width times <a>image</a> height
@@ -413,7 +526,7 @@ float see_selectMostMeaningfulBlob( const img image, size_t size, const img labe
 	if (discretize)
 	{
 		discrete = (float *)malloc(size*sizeof(float));
-		cblas_scopy(size, image, 1, discrete, 1);
+		see_scopy(size, image, 1, discrete, 1);
 		see_scaleTo(discrete, size, 255.0);
 	}
 	else 
@@ -436,22 +549,14 @@ float see_selectMostMeaningfulBlob( const img image, size_t size, const img labe
 	}
 	
 	// compute meaningfulness threshold assuming uniform distribution
-	t = (log((float)size*(size + 1.0)) - log(2.0))/M;
+	t = see_meaningfulnessThreshold(size, M);
 	
 	// compute blobs' relative entropy
 	for ( l = 0; l < nlabels; l++ )
 	{
 		p = n[l] * 1.0 / size;	// expected number of samples per bin
 		r = s[l] * 1.0 / M;		// expected proportion of samples
-		if ( r <= p )
-		{
-			e[l] = 0;
-		}
-		else 
-		{
-			e[l] = (r*(log(r)/log(2) - log(p)/log(2)) + 
-						(1-r)*(log(1-r)/log(2) - log(1-p)/log(2)));
-		}
+		e[l] = see_relativeEntropy(r, p);
 		if ( e[l] > t )
 		{
 			// region is meaningful
@@ -516,3 +621,97 @@ void see_weightedMean( const img image, size_t w, size_t h, const img labels,
 	y /= sum;
 }
 
+/*! Select most meaningful blob from statistics gathered while labeling
+	\param stats statistics per label (see see_labelBlobs)
+	\param nlabels number of labels
+	\param size image width times image height
+	\param discretize measure samples in the image scaled to [0,255]
+	\param entropy array with entropy per label
+	\return label with highest relative entropy
+ 
+	Same criterion as see_selectMostMeaningfulBlob, in O(nlabels). Samples are the pixel 
+	sums of each blob; when discretizing, the scaling of see_scaleTo is applied to the sums
+	(values are not truncated to integers pixel by pixel).
+ 
+	\note Pixels outside every blob are assumed to be zero, as left by thresholding.
+ */
+float see_selectMostMeaningfulBlobStats( const BlobStats *stats, int nlabels, size_t size, 
+										 bool discretize, float **entropy )
+{
+	float *e = (float *)malloc(nlabels*sizeof(float));
+	int selected = 0, l;
+	float maxe = 0;
+	
+	// image range (pixels out of the blobs are zero)
+	size_t count = 0;
+	float minimum = 0, maximum = 0;
+	double M = 0;
+	for ( l = 0; l < nlabels; l++ )
+	{
+		count += stats[l].count;
+		if ( l == 0 || stats[l].minval < minimum ) minimum = stats[l].minval;
+		if ( l == 0 || stats[l].maxval > maximum ) maximum = stats[l].maxval;
+		M += stats[l].sum;
+	}
+	if ( count < size )
+	{
+		if ( minimum > CC_BLANK ) minimum = CC_BLANK;
+		if ( maximum < CC_BLANK ) maximum = CC_BLANK;
+	}
+	double scale = 1.0;
+	if ( discretize && maximum > minimum )
+	{
+		scale = 255.0/(maximum - minimum);
+		M = (M - count*(double)minimum)*scale;
+	}
+	
+	float t = see_meaningfulnessThreshold(size, M);
+	
+	for ( l = 0; l < nlabels; l++ )
+	{
+		double s = stats[l].sum;
+		if ( scale != 1.0 ) s = (s - stats[l].count*(double)minimum)*scale;
+		
+		e[l] = see_relativeEntropy(s/M, stats[l].count * 1.0 / size);
+		if ( e[l] > t && (selected == 0 || maxe < e[l]) )
+		{
+			selected = l + 1;
+			maxe = e[l];
+		}
+	}
+	
+	if (entropy) *entropy = e; else free(e);
+	
+	return selected;
+}
+
+/*! Compute (spatial) weighted mean of a particular blob from its statistics
+	\param stats statistics per label (see see_labelBlobs)
+	\param w image width
+	\param h image height
+	\param label blob label (integer packed as a float)
+	\param x horizontal component of weighted mean
+	\param y vertical component of weighted mean
+ 
+	Same as see_weightedMean, in constant time. The center of the image is returned when 
+	<a>label</a> is zero, and the center of the blob's bounding box if its pixels sum zero.
+ */
+void see_blobWeightedMean( const BlobStats *stats, size_t w, size_t h, float label, float &x, float &y )
+{
+	if (!label) // no label was selected (no region is meaningful!)
+	{
+		x = w/2.0;
+		y = h/2.0;
+		return;
+	}
+	
+	const BlobStats *b = stats + (int)label - 1;
+	if (b->sum == 0.0)
+	{
+		x = (b->x1 + b->x2)/2.0;
+		y = (b->y1 + b->y2)/2.0;
+		return;
+	}
+	x = b->sumx/b->sum;
+	y = b->sumy/b->sum;
+}
@@ -34,6 +34,7 @@
 #define IMAGE_SEGMENTATION
 
 #include "ImageTypes.h"
+#include "SeeVector.h"
 
 #if __cplusplus
 extern "C" {
@@ -62,7 +63,7 @@ void see_threshold(img *image, size_t size, float threshold, float scale);
 inline img see_threshold2(const img image, size_t size, float threshold, float scale)
 {
 	img result = (float *)malloc(size*sizeof(float));
-	cblas_scopy(size, image, 1, result, 1);
+	see_scopy(size, image, 1, result, 1);
 	see_threshold(&result, size, threshold, scale);
 	return result;
 }
@@ -96,14 +97,14 @@ inline void see_uniformThresh(img *image, size_t size)
 {
 	// make sure the image does not have negative values
 	float tmp = 0.0;
-	vDSP_minv(*image, 1, &tmp, size);
+	see_minv(*image, 1, &tmp, size);
 	if (tmp != 0.0)
 	{
 		tmp = -tmp;
-		vDSP_vsadd(*image, 1, &tmp, *image, 1, size);
+		see_vsadd(*image, 1, &tmp, *image, 1, size);
 	}
 	// threshold
-	vDSP_sve(*image, 1, &tmp, size);
+	see_sve(*image, 1, &tmp, size);
 	if (tmp > 0.0)
 	{
 		tmp = tmp/(float)size;
@@ -114,9 +115,23 @@ inline void see_uniformThresh(img *image, size_t size)
 #pragma mark BLOBS
 	
 #define CC_UNLABELED	0.0f		//!< unlabeled pixel
-#define CC_SURROUNDING	-1.0f		//!< surrounding contour pixel
 	
-img see_labelBlobs(const img image, size_t w, size_t h, int &nlabels);	
+/*! Statistics of a blob, gathered while labeling */
+typedef struct BlobStats
+{
+	size_t count;			//!< number of pixels
+	double sum;				//!< sum of pixel values
+	double sumx, sumy;		//!< sum of pixel values times column (x) and row (y)
+	float minval, maxval;	//!< range of pixel values
+	size_t x1, y1, x2, y2;	//!< bounding box (inclusive)
+} BlobStats;
+	
+size_t see_labelComponents(const unsigned char *mask, size_t w, size_t h, int32_t *labels, 
+						   struct ThreadPool *pool = NULL);
+size_t see_labelComponentStats(const unsigned char *mask, const float *values, size_t w, size_t h, 
+							   int32_t *labels, BlobStats **stats, struct ThreadPool *pool = NULL);
+
+img see_labelBlobs(const img image, size_t w, size_t h, int &nlabels, BlobStats **stats = 0);	
 
 void see_colorBlobs(const img labels, size_t size, int nlabels, img *red, img *green, img *blue);
 	
@@ -128,6 +143,13 @@ float see_selectMostMeaningfulBlob( const img image, size_t size, const img labe
 void see_weightedMean( const img image, size_t w, size_t h, const img labels, 
 					   float label, float &x, float &y);
 
+float see_selectMostMeaningfulBlobStats( const BlobStats *stats, int nlabels, size_t size, 
+										 bool discretize, float **entropy = 0 );
+void see_blobWeightedMean( const BlobStats *stats, size_t w, size_t h, float label, float &x, float &y );
+
+float see_salientBlobCentroid(const img saliency, size_t w, size_t h, float &x, float &y, 
+							  img *labels = 0, struct ThreadPool *pool = NULL);
+
 	
 #if __cplusplus
 }
@@ -8,67 +8,155 @@
 
 #include "ImageTransformation.h"
 #include <assert.h>
+#include <math.h>
 
-//Transformation2D::Transformation2D(unsigned short size)
-//{
-//    numElem = size;
-//    if (numElem > 0)
-//        data = (float*)calloc(numElem, sizeof(float));
-//    else
-//        data = NULL;
-//}
-//
-//Transformation2D::~Transformation2D()
-//{
-////    assert(numElem != 0 || data == NULL);
-//    if (numElem != 0 && data != NULL) free(data);
-//}
-//
-///**
-// Matrix4 elements in column major order
-// */
-//typedef enum
-//{
-//    AFFINE_DXX,        //!< 1,1
-//    AFFINE_DXY,        //!< 2,1
-//    AFFINE_TX,         //!< 3,1
-//    AFFINE_DYX,        //!< 4,1
-//    AFFINE_DYY,        //!< 1,2
-//    AFFINE_TY,         //!< 2,2
-//    AFFINE_NUMELEM     //!< number of elements in the matrix
-//} AffineTransElem;      
-//
-//AffineTransformation::AffineTransformation() : Transformation2D(6)
-//{
-//    setIdentity();
-//}
-//
-//AffineTransformation::~AffineTransformation()
-//{}
-//
-//void 
-//AffineTransformation::setIdentity()
-//{
-//    data[AFFINE_DXX] = 1.0;
-//    data[AFFINE_DXY] = 0.0;
-//    data[AFFINE_DYX] = 0.0;
-//    data[AFFINE_DYY] = 1.0;
-//    data[AFFINE_TX]  = 0.0;
-//    data[AFFINE_TY]  = 0.0;
-//}
-//
-//bool
-//AffineTransformation::isIdentity()
-//{
-//    return (data[AFFINE_DXX] == 1.0 && data[AFFINE_DXY] == 0.0 &&
-//            data[AFFINE_DYX] == 0.0 && data[AFFINE_DYY] == 1.0 &&
-//            data[AFFINE_TX]  == 0.0 && data[AFFINE_TY]  == 0.0);
-//}
-//
-//bool 
-//AffineTransformation::isAllZeros()
-//{
-//    return (data[AFFINE_DXX] == 0.0 && data[AFFINE_DXY] == 0.0 &&
-//            data[AFFINE_DYX] == 0.0 && data[AFFINE_DYY] == 0.0 &&
-//            data[AFFINE_TX]  == 0.0 && data[AFFINE_TY]  == 0.0);    
-//}
+#pragma mark AFFINE TRANSFORMATION
+
+AffineTransformation::AffineTransformation()
+{
+    setIdentity();
+}
+
+AffineTransformation::AffineTransformation(float a, float b, float tx, float c, float d, float ty)
+{
+    m[0] = a; m[1] = b; m[2] = tx;
+    m[3] = c; m[4] = d; m[5] = ty;
+}
+
+void 
+AffineTransformation::setIdentity()
+{
+    m[0] = 1.0; m[1] = 0.0; m[2] = 0.0;
+    m[3] = 0.0; m[4] = 1.0; m[5] = 0.0;
+}
+
+bool
+AffineTransformation::isIdentity() const
+{
+    return (m[0] == 1.0 && m[1] == 0.0 && m[2] == 0.0 &&
+            m[3] == 0.0 && m[4] == 1.0 && m[5] == 0.0);
+}
+
+bool 
+AffineTransformation::isAllZeros() const
+{
+    for (int i=0; i<6; i++) if (m[i] != 0.0) return false;
+    return true;
+}
+
+Vector2
+AffineTransformation::apply(const Vector2& p) const
+{
+    return Vector2(m[0]*p.x + m[1]*p.y + m[2], m[3]*p.x + m[4]*p.y + m[5]);
+}
+
+/**
+    Composition (this transformation is applied after <a>t</a>)
+ */
+AffineTransformation
+AffineTransformation::operator*(const AffineTransformation& t) const
+{
+    return AffineTransformation(m[0]*t.m[0] + m[1]*t.m[3], m[0]*t.m[1] + m[1]*t.m[4], m[0]*t.m[2] + m[1]*t.m[5] + m[2],
+                                m[3]*t.m[0] + m[4]*t.m[3], m[3]*t.m[1] + m[4]*t.m[4], m[3]*t.m[2] + m[4]*t.m[5] + m[5]);
+}
+
+/**
+    Inverse transformation
+    @param inv inverse (not modified if the transformation is singular)
+    @return was the transformation inverted?
+ */
+bool
+AffineTransformation::inverse(AffineTransformation& inv) const
+{
+    double det = (double)m[0]*m[4] - (double)m[1]*m[3];
+    if (det == 0 || !isfinite(det)) return false;
+    
+    double a = m[4]/det, b = -m[1]/det, c = -m[3]/det, d = m[0]/det;
+    inv = AffineTransformation(a, b, -(a*m[2] + b*m[5]), c, d, -(c*m[2] + d*m[5]));
+    return true;
+}
+
+#pragma mark HOMOGRAPHY TRANSFORMATION
+
+HomographyTransformation::HomographyTransformation()
+{
+    setIdentity();
+}
+
+HomographyTransformation::HomographyTransformation(const AffineTransformation& t)
+{
+    for (int i=0; i<6; i++) m[i] = t.m[i];
+    m[6] = 0.0; m[7] = 0.0; m[8] = 1.0;
+}
+
+void 
+HomographyTransformation::setIdentity()
+{
+    for (int i=0; i<9; i++) m[i] = (i % 4 == 0 ? 1.0 : 0.0);
+}
+
+bool
+HomographyTransformation::isIdentity() const
+{
+    for (int i=0; i<9; i++) if (m[i] != (i % 4 == 0 ? 1.0 : 0.0)) return false;
+    return true;
+}
+
+bool 
+HomographyTransformation::isAllZeros() const
+{
+    for (int i=0; i<9; i++) if (m[i] != 0.0) return false;
+    return true;
+}
+
+Vector2
+HomographyTransformation::apply(const Vector2& p) const
+{
+    float w = m[6]*p.x + m[7]*p.y + m[8];
+    return Vector2((m[0]*p.x + m[1]*p.y + m[2])/w, (m[3]*p.x + m[4]*p.y + m[5])/w);
+}
+
+/**
+    Composition (this transformation is applied after <a>t</a>)
+ */
+HomographyTransformation
+HomographyTransformation::operator*(const HomographyTransformation& t) const
+{
+    HomographyTransformation r;
+    for (int i=0; i<3; i++)
+        for (int j=0; j<3; j++)
+            r.m[3*i+j] = m[3*i]*t.m[j] + m[3*i+1]*t.m[3+j] + m[3*i+2]*t.m[6+j];
+    return r;
+}
+
+/**
+    Inverse transformation (adjugate over determinant)
+    @param inv inverse (not modified if the transformation is singular)
+    @return was the transformation inverted?
+ */
+bool
+HomographyTransformation::inverse(HomographyTransformation& inv) const
+{
+    double a[9];
+    for (int i=0; i<9; i++) a[i] = m[i];
+    double c0 = a[4]*a[8] - a[5]*a[7], c1 = a[5]*a[6] - a[3]*a[8], c2 = a[3]*a[7] - a[4]*a[6];
+    double det = a[0]*c0 + a[1]*c1 + a[2]*c2;
+    if (det == 0 || !isfinite(det)) return false;
+    
+    inv.m[0] = c0/det; inv.m[1] = (a[2]*a[7] - a[1]*a[8])/det; inv.m[2] = (a[1]*a[5] - a[2]*a[4])/det;
+    inv.m[3] = c1/det; inv.m[4] = (a[0]*a[8] - a[2]*a[6])/det; inv.m[5] = (a[2]*a[3] - a[0]*a[5])/det;
+    inv.m[6] = c2/det; inv.m[7] = (a[1]*a[6] - a[0]*a[7])/det; inv.m[8] = (a[0]*a[4] - a[1]*a[3])/det;
+    return true;
+}
+
+/**
+    Scale the matrix so that its last element is 1 (if it is not zero)
+ */
+void
+HomographyTransformation::normalize()
+{
+    if (m[8] == 0.0) return;
+    float k = 1.0/m[8];
+    for (int i=0; i<8; i++) m[i] *= k;
+    m[8] = 1.0;
+}
@@ -9,42 +9,140 @@
 #ifndef IMAGE_TRANSFORMATION
 #define IMAGE_TRANSFORMATION
 
-//#if __cplusplus
-//extern "C" {
-//#endif
-//
-//class Transformation2D
-//{
-//protected:
-//    float *data;            //!< transformation data (most probably a matrix)
-//    unsigned short numElem; //!< number of elements (size of data)
-//    
-//public:
-//    Transformation2D(unsigned short size = 0);
-//    ~Transformation2D();
-//    
-//    virtual inline void setIdentity() = 0;   
-//    virtual bool isIdentity() = 0;
-//    virtual bool isAllZeros() = 0;
-//
-//};
-//
-///**
-//    2x3 2D Affine transformation (stored in row-major order)
-// */
-//class AffineTransformation: Transformation2D
-//{
-//public:
-//    AffineTransformation();
-//    ~AffineTransformation();
-//  
-//    inline void setIdentity();
-//    virtual bool isIdentity();
-//    virtual bool isAllZeros(); 
-//};
-//
-//#if __cplusplus
-//}
-//#endif
+#include <BasicMath/Vector2.h>
+
+/**
+    2x3 2D affine transformation (stored in row-major order)
+ 
+    [x' y']' = [m0 m1 m2; m3 m4 m5] [x y 1]'
+ */
+class AffineTransformation
+{
+public:
+    float m[6];             //!< matrix elements
+    
+    AffineTransformation();
+    AffineTransformation(float a, float b, float tx, float c, float d, float ty);
+    
+    void setIdentity();
+    bool isIdentity() const;
+    bool isAllZeros() const;
+    
+    Vector2 apply(const Vector2& p) const;
+    AffineTransformation operator*(const AffineTransformation& t) const;
+    bool inverse(AffineTransformation& inv) const;
+};
+
+/**
+    3x3 2D projective transformation (stored in row-major order)
+ 
+    [u v w]' = [m0 m1 m2; m3 m4 m5; m6 m7 m8] [x y 1]' and (x',y') = (u/w, v/w)
+ */
+class HomographyTransformation
+{
+public:
+    float m[9];             //!< matrix elements
+    
+    HomographyTransformation();
+    HomographyTransformation(const AffineTransformation& t);
+    
+    void setIdentity();
+    bool isIdentity() const;
+    bool isAllZeros() const;
+    
+    Vector2 apply(const Vector2& p) const;
+    HomographyTransformation operator*(const HomographyTransformation& t) const;
+    bool inverse(HomographyTransformation& inv) const;
+    void normalize();
+};
+
+#pragma mark WARP MODELS
+
+/**
+    Warp models for Lucas-Kanade tracking. Each model is a compile-time parameter of the tracker: 
+    it gives the steepest descent terms of a template pixel, maps points and composes the inverse 
+    of an incremental warp (inverse compositional update). The parameters of the incremental warp 
+    are those of Baker and Matthews, so that the warp is the identity when they are all zero.
+ */
+struct AffineWarp
+{
+    enum { NPARAMS = 6 };
+    typedef AffineTransformation Transformation;
+    
+    /*! Steepest descent terms [gx gy] dW/dp at (x,y) */
+    static inline void steepest(float gx, float gy, float x, float y, float *sd)
+    {
+        sd[0] = gx*x; sd[1] = gy*x; sd[2] = gx*y; sd[3] = gy*y; sd[4] = gx; sd[5] = gy;
+    }
+    
+    /*! Warp with incremental parameters <a>dp</a> */
+    static inline Transformation incremental(const float *dp)
+    {
+        return AffineTransformation(1 + dp[0], dp[2], dp[4], dp[1], 1 + dp[3], dp[5]);
+    }
+    
+    static inline Vector2 map(const Transformation& t, float x, float y)
+    {
+        return Vector2(t.m[0]*x + t.m[1]*y + t.m[2], t.m[3]*x + t.m[4]*y + t.m[5]);
+    }
+    
+    /*! Perspective denominator at (x,y) */
+    static inline float depth(const Transformation&, float, float) { return 1; }
+    
+    /*! t = t o incremental(dp)^-1 (false if the increment cannot be inverted) */
+    static inline bool compose(Transformation& t, const float *dp)
+    {
+        AffineTransformation inv;
+        if (!incremental(dp).inverse(inv)) return false;
+        t = t*inv;
+        return true;
+    }
+};
+
+struct HomographyWarp
+{
+    enum { NPARAMS = 8 };
+    typedef HomographyTransformation Transformation;
+    
+    /*! Steepest descent terms [gx gy] dW/dp at (x,y) */
+    static inline void steepest(float gx, float gy, float x, float y, float *sd)
+    {
+        float r = gx*x + gy*y;
+        sd[0] = gx*x; sd[1] = gy*x; sd[2] = gx*y; sd[3] = gy*y; sd[4] = gx; sd[5] = gy;
+        sd[6] = -x*r; sd[7] = -y*r;
+    }
+    
+    /*! Warp with incremental parameters <a>dp</a> */
+    static inline Transformation incremental(const float *dp)
+    {
+        HomographyTransformation t;
+        t.m[0] = 1 + dp[0]; t.m[1] = dp[2]; t.m[2] = dp[4];
+        t.m[3] = dp[1]; t.m[4] = 1 + dp[3]; t.m[5] = dp[5];
+        t.m[6] = dp[6]; t.m[7] = dp[7]; t.m[8] = 1;
+        return t;
+    }
+    
+    static inline Vector2 map(const Transformation& t, float x, float y)
+    {
+        float w = t.m[6]*x + t.m[7]*y + t.m[8];
+        return Vector2((t.m[0]*x + t.m[1]*y + t.m[2])/w, (t.m[3]*x + t.m[4]*y + t.m[5])/w);
+    }
+    
+    /*! Perspective denominator at (x,y) */
+    static inline float depth(const Transformation& t, float x, float y)
+    {
+        return t.m[6]*x + t.m[7]*y + t.m[8];
+    }
+    
+    /*! t = t o incremental(dp)^-1 (false if the increment cannot be inverted) */
+    static inline bool compose(Transformation& t, const float *dp)
+    {
+        HomographyTransformation inv;
+        if (!incremental(dp).inverse(inv)) return false;
+        t = t*inv;
+        t.normalize();
+        return true;
+    }
+};
 
 #endif
@@ -34,6 +34,8 @@
 #define IMAGE_TYPES
 
 #include <vector>
+#include <stddef.h>
+#include <stdlib.h>
 
 #if __cplusplus
 extern "C" {
@@ -42,7 +44,34 @@ extern "C" {
 typedef int* iimg;					//!< int matrix
 typedef unsigned char* ucimg;		//!< unsigned char matrix
 typedef float* img;					//!< float matrix 
-typedef std::vector<img> pyr;		//!< pyramid
+
+#define SEE_PYRAMID_MAX_LEVELS 16   //!< maximum number of levels in a Pyramid
+
+/*! Image pyramid stored in a single allocation
+ 
+    All levels live one after the other in <a>data</a> (each starting on a 64-byte boundary),
+    followed by the scratch space needed to filter them. The storage is kept between calls to 
+    see_pyramid and only grows when a larger pyramid is requested, so the same Pyramid can be 
+    rebuilt every frame without allocating. Levels never alias the caller's image.
+ 
+    Release with see_freePyramid.
+ */
+typedef struct Pyramid
+{
+    float *data;                                    //!< storage for all levels (and filtering scratch)
+    size_t capacity;                                //!< floats allocated in <a>data</a>
+    size_t levels;                                  //!< number of levels
+    size_t width[SEE_PYRAMID_MAX_LEVELS];           //!< width of each level
+    size_t height[SEE_PYRAMID_MAX_LEVELS];          //!< height of each level
+    size_t offset[SEE_PYRAMID_MAX_LEVELS];          //!< start of each level in <a>data</a>
+    
+    Pyramid() : data(0), capacity(0), levels(0) {}
+    
+private:
+    // a pyramid owns <a>data</a>: pass it by reference or pointer (see_swapPyramids transfers it)
+    Pyramid(const Pyramid&);
+    Pyramid& operator=(const Pyramid&);
+} Pyramid;
 
     
 #if __cplusplus
@@ -0,0 +1,198 @@
+//
+//  MotionPrediction.cpp
+//  Framework-See
+//
+//	Copyright 2014 Carnegie Mellon University
+//
+//	This work was developed under the Rehabilitation Engineering Research
+//	Center on Accessible Public Transportation (www.rercapt.org) and is funded
+//	by grant number H133E080019 from the United States Department of Education
+//	through the National Institute on Disability and Rehabilitation Research.
+//	No endorsement should be assumed by NIDRR or the United States Government
+//	for the content contained on this code.
+//
+//	Permission is hereby granted, free of charge, to any person obtaining a copy
+//	of this software and associated documentation files (the "Software"), to deal
+//	in the Software without restriction, including without limitation the rights
+//	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//	copies of the Software, and to permit persons to whom the Software is
+//	furnished to do so, subject to the following conditions:
+//
+//	The above copyright notice and this permission notice shall be included in
+//	all copies or substantial portions of the Software.
+//
+//	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//	THE SOFTWARE.
+
+
+#include "MotionPrediction.h"
+#include <assert.h>
+#include <math.h>
+
+#pragma mark Gyro motion prediction
+
+/** Start a gyro predictor
+    \param predictor predictor (any samples it holds are dropped)
+ */
+void see_initGyroPredictor(GyroPredictor& predictor)
+{
+    predictor.next = 0;
+    predictor.count = 0;
+    int err = pthread_mutex_init(&predictor.lock, NULL);
+    assert(err == 0); (void)err;
+}
+
+/** Add an angular velocity measurement
+    \param predictor predictor
+    \param timestamp time of the measurement in seconds (same clock as the frame timestamps)
+    \param wx angular velocity around the x axis (rad/s)
+    \param wy angular velocity around the y axis (rad/s)
+    \param wz angular velocity around the z axis (rad/s)
+ 
+    Samples must arrive in time order; a sample older than the newest one resets the buffer 
+    (e.g. the sensor was restarted). When the buffer is full the oldest sample is overwritten.
+ */
+void see_gyroPredictorAddSample(GyroPredictor& predictor, double timestamp, float wx, float wy, float wz)
+{
+    pthread_mutex_lock(&predictor.lock);
+    
+    if (predictor.count > 0)
+    {
+        size_t newest = (predictor.next + SEE_GYRO_BUFFER_SIZE - 1) % SEE_GYRO_BUFFER_SIZE;
+        if (timestamp < predictor.time[newest]) predictor.count = 0;
+    }
+    
+    predictor.time[predictor.next] = timestamp;
+    predictor.rate[predictor.next][0] = wx;
+    predictor.rate[predictor.next][1] = wy;
+    predictor.rate[predictor.next][2] = wz;
+    predictor.next = (predictor.next + 1) % SEE_GYRO_BUFFER_SIZE;
+    if (predictor.count < SEE_GYRO_BUFFER_SIZE) predictor.count++;
+    
+    pthread_mutex_unlock(&predictor.lock);
+}
+
+/** Drop all samples
+    \param predictor predictor
+ */
+void see_gyroPredictorReset(GyroPredictor& predictor)
+{
+    pthread_mutex_lock(&predictor.lock);
+    predictor.count = 0;
+    pthread_mutex_unlock(&predictor.lock);
+}
+
+/** Rotation of the sensor between two instants
+    \param predictor predictor
+    \param t0 start time (s)
+    \param t1 end time (s)
+    \param rotation rotation vector (axis times angle in radians, in the sensor axes)
+    \return was the interval covered by the samples?
+ 
+    The angular velocity is interpolated linearly between samples and held constant before the 
+    oldest and after the newest one, then integrated over [t0, t1]. The rotation between frames 
+    is small, so the components are integrated independently. The prediction fails (and 
+    <a>rotation</a> is zero) when there are no samples, when [t0, t1] is empty, or when it starts 
+    more than SEE_GYRO_MAX_GAP seconds before the oldest sample or ends more than SEE_GYRO_MAX_GAP 
+    seconds after the newest one.
+ */
+bool see_gyroPredictorRotation(GyroPredictor& predictor, double t0, double t1, float rotation[3])
+{
+    rotation[0] = rotation[1] = rotation[2] = 0;
+    if (!(t1 > t0)) return false;
+    
+    pthread_mutex_lock(&predictor.lock);
+    
+    size_t n = predictor.count;
+    size_t first = (predictor.next + SEE_GYRO_BUFFER_SIZE - n) % SEE_GYRO_BUFFER_SIZE;
+    size_t last = (predictor.next + SEE_GYRO_BUFFER_SIZE - 1) % SEE_GYRO_BUFFER_SIZE;
+    if (n == 0 || t0 < predictor.time[first] - SEE_GYRO_MAX_GAP || t1 > predictor.time[last] + SEE_GYRO_MAX_GAP)
+    {
+        pthread_mutex_unlock(&predictor.lock);
+        return false;
+    }
+    
+    double angle[3] = {0, 0, 0};
+    
+    // constant rate before the oldest sample
+    double hi = fmin(t1, predictor.time[first]);
+    if (hi > t0)
+        for (int k=0; k<3; k++) angle[k] += (hi - t0)*predictor.rate[first][k];
+    
+    // linear rate between consecutive samples
+    for (size_t i=1; i<n; i++)
+    {
+        size_t a = (first + i - 1) % SEE_GYRO_BUFFER_SIZE, b = (first + i) % SEE_GYRO_BUFFER_SIZE;
+        double ta = predictor.time[a], tb = predictor.time[b];
+        double lo = fmax(t0, ta);
+        hi = fmin(t1, tb);
+        if (hi <= lo || tb <= ta) continue;
+        double sLo = (lo - ta)/(tb - ta), sHi = (hi - ta)/(tb - ta);
+        for (int k=0; k<3; k++)
+        {
+            double ra = predictor.rate[a][k], rb = predictor.rate[b][k];
+            angle[k] += (hi - lo)*(ra + 0.5*(sLo + sHi)*(rb - ra));
+        }
+    }
+    
+    // constant rate after the newest sample
+    double lo = fmax(t0, predictor.time[last]);
+    if (t1 > lo)
+        for (int k=0; k<3; k++) angle[k] += (t1 - lo)*predictor.rate[last][k];
+    
+    pthread_mutex_unlock(&predictor.lock);
+    
+    for (int k=0; k<3; k++) rotation[k] = angle[k];
+    return true;
+}
+
+/** Image motion of a static scene point caused by a camera rotation
+    \param rotation rotation vector of the camera (axis times angle in radians) in camera axes: x along 
+    the image columns, y along the image rows and z along the optical axis
+    \param focal focal length in pixels
+    \param point position of the scene point in the image, relative to the principal point
+    \param motion displacement of the point in the image
+    \return is the point still in front of the camera?
+ 
+    Pinhole model: the point is back-projected, rotated by the inverse of the camera rotation 
+    (Rodrigues formula) and projected again. Translation is neglected, which is accurate for 
+    distant scenes and for the short time between frames.
+ */
+bool see_predictRotationMotion(const float rotation[3], float focal, Vector2 point, Vector2 &motion)
+{
+    motion = Vector2(0, 0);
+    
+    double theta = sqrt((double)rotation[0]*rotation[0] + (double)rotation[1]*rotation[1] + 
+                        (double)rotation[2]*rotation[2]);
+    if (theta < 1e-12) return true;
+    
+    double k[3] = {rotation[0]/theta, rotation[1]/theta, rotation[2]/theta};
+    double p[3] = {point.x/focal, point.y/focal, 1.0};
+    
+    // R^T p = p cos(theta) - (k x p) sin(theta) + k (k.p) (1 - cos(theta))
+    double c = cos(theta), s = sin(theta);
+    double kp = k[0]*p[0] + k[1]*p[1] + k[2]*p[2];
+    double kxp[3] = {k[1]*p[2] - k[2]*p[1], k[2]*p[0] - k[0]*p[2], k[0]*p[1] - k[1]*p[0]};
+    double q[3];
+    for (int i=0; i<3; i++) q[i] = p[i]*c - kxp[i]*s + k[i]*kp*(1 - c);
+    
+    if (q[2] <= 0) return false;
+    
+    motion = Vector2(focal*q[0]/q[2] - point.x, focal*q[1]/q[2] - point.y);
+    return true;
+}
+
+/** Release a gyro predictor
+    \param predictor predictor
+ */
+void see_freeGyroPredictor(GyroPredictor& predictor)
+{
+    pthread_mutex_destroy(&predictor.lock);
+    predictor.next = 0;
+    predictor.count = 0;
+}
@@ -0,0 +1,82 @@
+//
+//  MotionPrediction.h
+//  Framework-See
+//
+//	Copyright 2014 Carnegie Mellon University
+//
+//	This work was developed under the Rehabilitation Engineering Research
+//	Center on Accessible Public Transportation (www.rercapt.org) and is funded
+//	by grant number H133E080019 from the United States Department of Education
+//	through the National Institute on Disability and Rehabilitation Research.
+//	No endorsement should be assumed by NIDRR or the United States Government
+//	for the content contained on this code.
+//
+//	Permission is hereby granted, free of charge, to any person obtaining a copy
+//	of this software and associated documentation files (the "Software"), to deal
+//	in the Software without restriction, including without limitation the rights
+//	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//	copies of the Software, and to permit persons to whom the Software is
+//	furnished to do so, subject to the following conditions:
+//
+//	The above copyright notice and this permission notice shall be included in
+//	all copies or substantial portions of the Software.
+//
+//	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//	THE SOFTWARE.
+
+
+#ifndef MOTION_PREDICTION
+#define MOTION_PREDICTION
+
+#include <BasicMath/Vector2.h>
+#include <pthread.h>
+#include <stddef.h>
+
+#if __cplusplus
+extern "C" {
+#endif
+    
+#pragma mark GYRO MOTION PREDICTION
+    
+#define SEE_GYRO_BUFFER_SIZE    64      //!< gyro samples kept by a GyroPredictor (>1 s at 50 Hz)
+#define SEE_GYRO_MAX_GAP        0.1     //!< max. time (s) a prediction may extrapolate before the oldest or past the newest sample
+    
+    /**
+     Ring buffer of timestamped angular velocities used to predict the image motion caused by 
+     rotating the camera between two frames. Samples are added by the sensor thread with 
+     see_gyroPredictorAddSample and read by the tracking thread with see_gyroPredictorRotation, 
+     so both calls take <a>lock</a>. Release with see_freeGyroPredictor.
+     */
+    typedef struct GyroPredictor
+    {
+        double time[SEE_GYRO_BUFFER_SIZE];      //!< sample timestamps (seconds, increasing)
+        float rate[SEE_GYRO_BUFFER_SIZE][3];    //!< angular velocity (rad/s) around the x, y and z axes
+        size_t next;                            //!< slot for the next sample
+        size_t count;                           //!< valid samples
+        pthread_mutex_t lock;                   //!< guards the buffer
+        
+        GyroPredictor() : next(0), count(0) {}
+    } GyroPredictor;
+    
+    void see_initGyroPredictor(GyroPredictor& predictor);
+    
+    void see_gyroPredictorAddSample(GyroPredictor& predictor, double timestamp, float wx, float wy, float wz);
+    
+    void see_gyroPredictorReset(GyroPredictor& predictor);
+    
+    bool see_gyroPredictorRotation(GyroPredictor& predictor, double t0, double t1, float rotation[3]);
+    
+    bool see_predictRotationMotion(const float rotation[3], float focal, Vector2 point, Vector2 &motion);
+    
+    void see_freeGyroPredictor(GyroPredictor& predictor);
+    
+#if __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,225 @@
+//
+//  SeeFFT.cpp
+//  Framework-See
+//
+//	Copyright 2014 Carnegie Mellon University
+//
+//	This work was developed under the Rehabilitation Engineering Research
+//	Center on Accessible Public Transportation (www.rercapt.org) and is funded
+//	by grant number H133E080019 from the United States Department of Education
+//	through the National Institute on Disability and Rehabilitation Research.
+//	No endorsement should be assumed by NIDRR or the United States Government
+//	for the content contained on this code.
+//
+//	Permission is hereby granted, free of charge, to any person obtaining a copy
+//	of this software and associated documentation files (the "Software"), to deal
+//	in the Software without restriction, including without limitation the rights
+//	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//	copies of the Software, and to permit persons to whom the Software is
+//	furnished to do so, subject to the following conditions:
+//
+//	The above copyright notice and this permission notice shall be included in
+//	all copies or substantial portions of the Software.
+//
+//	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//	THE SOFTWARE.
+
+
+#include "SeeFFT.h"
+#include "SeeSIMD.h"
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+
+/** Smallest FFT length that holds a signal
+    \param n signal length
+    \return smallest power of two not smaller than <a>n</a>
+ */
+size_t see_fftSize(size_t n)
+{
+    size_t size = 1;
+    while (size < n) size <<= 1;
+    return size;
+}
+
+/** Prepare a FFT
+    \param plan plan (its tables are replaced)
+    \param n transform length
+    \return false if <a>n</a> is not a power of two
+ */
+bool see_initFFTPlan(FFTPlan& plan, size_t n)
+{
+    see_freeFFTPlan(plan);
+    if (n == 0 || (n & (n - 1)) != 0) return false;
+    
+    plan.n = n;
+    plan.bitrev = (unsigned int *)malloc(n*sizeof(unsigned int));
+    plan.cosTable = (float *)malloc(n*sizeof(float));
+    plan.sinTable = (float *)malloc(n*sizeof(float));
+    assert(plan.bitrev != 0 && plan.cosTable != 0 && plan.sinTable != 0);
+    
+    unsigned int bits = 0;
+    while (((size_t)1 << bits) < n) bits++;
+    for (size_t i=0; i<n; i++)
+    {
+        unsigned int r = 0;
+        for (unsigned int b=0; b<bits; b++)
+            if (i & ((size_t)1 << b)) r |= 1u << (bits - 1 - b);
+        plan.bitrev[i] = r;
+    }
+    
+    // stage of half size h uses the h twiddles starting at h - 1
+    for (size_t h=1; h<n; h<<=1)
+        for (size_t k=0; k<h; k++)
+        {
+            double angle = M_PI*k/h;
+            plan.cosTable[h - 1 + k] = cos(angle);
+            plan.sinTable[h - 1 + k] = sin(angle);
+        }
+    
+    return true;
+}
+
+/** In-place complex FFT
+    \param plan plan of the transform length
+    \param re real part (plan.n)
+    \param im imaginary part (plan.n)
+    \param inverse compute the inverse transform (unscaled: divide by plan.n to invert exactly)
+ 
+    Decimation in time: the input is permuted in bit-reversed order and combined by butterflies of 
+    growing size. Stages with at least SEE_VWIDTH butterflies per block are vectorized.
+ */
+void see_fft(const FFTPlan& plan, float *re, float *im, bool inverse)
+{
+    size_t n = plan.n;
+    for (size_t i=0; i<n; i++)
+    {
+        size_t j = plan.bitrev[i];
+        if (i < j)
+        {
+            float t = re[i]; re[i] = re[j]; re[j] = t;
+            t = im[i]; im[i] = im[j]; im[j] = t;
+        }
+    }
+    
+    float sign = (inverse ? 1.0f : -1.0f);
+    vfloat vsign = vf_set(sign);
+    for (size_t h=1; h<n; h<<=1)
+    {
+        const float *wr = plan.cosTable + h - 1, *ws = plan.sinTable + h - 1;
+        for (size_t start=0; start<n; start+=2*h)
+        {
+            float *ar = re + start, *ai = im + start, *br = ar + h, *bi = ai + h;
+            size_t k = 0;
+            for (; k+SEE_VWIDTH<=h; k+=SEE_VWIDTH)
+            {
+                vfloat c = vf_load(wr + k), s = vf_mul(vsign, vf_load(ws + k));
+                vfloat xr = vf_load(br + k), xi = vf_load(bi + k);
+                vfloat tr = vf_sub(vf_mul(c, xr), vf_mul(s, xi));
+                vfloat ti = vf_add(vf_mul(c, xi), vf_mul(s, xr));
+                vfloat yr = vf_load(ar + k), yi = vf_load(ai + k);
+                vf_store(ar + k, vf_add(yr, tr)); vf_store(ai + k, vf_add(yi, ti));
+                vf_store(br + k, vf_sub(yr, tr)); vf_store(bi + k, vf_sub(yi, ti));
+            }
+            for (; k<h; k++)
+            {
+                float c = wr[k], s = sign*ws[k];
+                float tr = c*br[k] - s*bi[k], ti = c*bi[k] + s*br[k];
+                br[k] = ar[k] - tr; bi[k] = ai[k] - ti;
+                ar[k] += tr; ai[k] += ti;
+            }
+        }
+    }
+}
+
+/** FFT of every column of a matrix, computed on whole rows
+    \param plan plan of the column length (number of rows)
+    \param re real part (plan.n rows of <a>cols</a> values)
+    \param im imaginary part
+    \param cols row length
+    \param inverse compute the inverse transform (unscaled)
+ 
+    Same butterflies as see_fft, with rows in place of samples: every butterfly applies one twiddle 
+    factor to two rows, so memory is read sequentially and all the columns share the vector work.
+ */
+static void see_fftColumns(const FFTPlan& plan, float *re, float *im, size_t cols, bool inverse)
+{
+    size_t n = plan.n;
+    for (size_t i=0; i<n; i++)
+    {
+        size_t j = plan.bitrev[i];
+        if (i < j)
+        {
+            float *ri = re + i*cols, *rj = re + j*cols, *ii = im + i*cols, *ij = im + j*cols;
+            for (size_t c=0; c<cols; c++)
+            {
+                float t = ri[c]; ri[c] = rj[c]; rj[c] = t;
+                t = ii[c]; ii[c] = ij[c]; ij[c] = t;
+            }
+        }
+    }
+    
+    float sign = (inverse ? 1.0f : -1.0f);
+    for (size_t h=1; h<n; h<<=1)
+    {
+        for (size_t start=0; start<n; start+=2*h)
+        {
+            for (size_t k=0; k<h; k++)
+            {
+                float cw = plan.cosTable[h - 1 + k], sw = sign*plan.sinTable[h - 1 + k];
+                vfloat c = vf_set(cw), s = vf_set(sw);
+                float *ar = re + (start + k)*cols, *ai = im + (start + k)*cols;
+                float *br = ar + h*cols, *bi = ai + h*cols;
+                size_t x = 0;
+                for (; x+SEE_VWIDTH<=cols; x+=SEE_VWIDTH)
+                {
+                    vfloat xr = vf_load(br + x), xi = vf_load(bi + x);
+                    vfloat tr = vf_sub(vf_mul(c, xr), vf_mul(s, xi));
+                    vfloat ti = vf_add(vf_mul(c, xi), vf_mul(s, xr));
+                    vfloat yr = vf_load(ar + x), yi = vf_load(ai + x);
+                    vf_store(ar + x, vf_add(yr, tr)); vf_store(ai + x, vf_add(yi, ti));
+                    vf_store(br + x, vf_sub(yr, tr)); vf_store(bi + x, vf_sub(yi, ti));
+                }
+                for (; x<cols; x++)
+                {
+                    float tr = cw*br[x] - sw*bi[x], ti = cw*bi[x] + sw*br[x];
+                    br[x] = ar[x] - tr; bi[x] = ai[x] - ti;
+                    ar[x] += tr; ai[x] += ti;
+                }
+            }
+        }
+    }
+}
+
+/** In-place 2D complex FFT
+    \param rowPlan plan of the row length (number of columns)
+    \param colPlan plan of the column length (number of rows)
+    \param re real part (colPlan.n rows of rowPlan.n values)
+    \param im imaginary part
+    \param inverse compute the inverse transform (unscaled: divide by rowPlan.n*colPlan.n to invert exactly)
+ */
+void see_fft2D(const FFTPlan& rowPlan, const FFTPlan& colPlan, float *re, float *im, bool inverse)
+{
+    size_t cols = rowPlan.n, rows = colPlan.n;
+    for (size_t r=0; r<rows; r++)
+        see_fft(rowPlan, re + r*cols, im + r*cols, inverse);
+    see_fftColumns(colPlan, re, im, cols, inverse);
+}
+
+/** Release a FFT plan
+    \param plan plan
+ */
+void see_freeFFTPlan(FFTPlan& plan)
+{
+    free(plan.bitrev);
+    free(plan.cosTable);
+    free(plan.sinTable);
+    plan.bitrev = 0;
+    plan.cosTable = plan.sinTable = 0;
+    plan.n = 0;
+}
@@ -0,0 +1,71 @@
+//
+//  SeeFFT.h
+//  Framework-See
+//
+//	Copyright 2014 Carnegie Mellon University
+//
+//	This work was developed under the Rehabilitation Engineering Research
+//	Center on Accessible Public Transportation (www.rercapt.org) and is funded
+//	by grant number H133E080019 from the United States Department of Education
+//	through the National Institute on Disability and Rehabilitation Research.
+//	No endorsement should be assumed by NIDRR or the United States Government
+//	for the content contained on this code.
+//
+//	Permission is hereby granted, free of charge, to any person obtaining a copy
+//	of this software and associated documentation files (the "Software"), to deal
+//	in the Software without restriction, including without limitation the rights
+//	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//	copies of the Software, and to permit persons to whom the Software is
+//	furnished to do so, subject to the following conditions:
+//
+//	The above copyright notice and this permission notice shall be included in
+//	all copies or substantial portions of the Software.
+//
+//	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//	THE SOFTWARE.
+
+
+#ifndef SEE_FFT
+#define SEE_FFT
+
+#include <stddef.h>
+
+#if __cplusplus
+extern "C" {
+#endif
+    
+    /**
+     Radix-2 complex FFT of a fixed power-of-two length. Holds the bit-reversal permutation and 
+     the twiddle factors of every stage, stored contiguously so butterflies are vectorized. 
+     Complex data is split into real and imaginary arrays. Release with see_freeFFTPlan.
+     */
+    typedef struct FFTPlan
+    {
+        size_t n;                   //!< transform length (power of two)
+        unsigned int *bitrev;       //!< bit-reversal permutation (n)
+        float *cosTable;            //!< cos(2 pi k / 2h) for each stage of half size h = 1, 2, 4, ... (n - 1)
+        float *sinTable;            //!< sin(2 pi k / 2h) for each stage (n - 1)
+        
+        FFTPlan() : n(0), bitrev(0), cosTable(0), sinTable(0) {}
+    } FFTPlan;
+    
+    size_t see_fftSize(size_t n);
+    
+    bool see_initFFTPlan(FFTPlan& plan, size_t n);
+    
+    void see_fft(const FFTPlan& plan, float *re, float *im, bool inverse = false);
+    
+    void see_fft2D(const FFTPlan& rowPlan, const FFTPlan& colPlan, float *re, float *im, bool inverse = false);
+    
+    void see_freeFFTPlan(FFTPlan& plan);
+    
+#if __cplusplus
+}
+#endif
+
+#endif
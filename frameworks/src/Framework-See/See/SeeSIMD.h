@@ -0,0 +1,460 @@
+//
+//  SeeSIMD.h
+//  Framework-See
+//
+//	Copyright 2014 Carnegie Mellon University
+//
+//	This work was developed under the Rehabilitation Engineering Research
+//	Center on Accessible Public Transportation (www.rercapt.org) and is funded
+//	by grant number H133E080019 from the United States Department of Education
+//	through the National Institute on Disability and Rehabilitation Research.
+//	No endorsement should be assumed by NIDRR or the United States Government
+//	for the content contained on this code.
+//
+//	Permission is hereby granted, free of charge, to any person obtaining a copy
+//	of this software and associated documentation files (the "Software"), to deal
+//	in the Software without restriction, including without limitation the rights
+//	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//	copies of the Software, and to permit persons to whom the Software is
+//	furnished to do so, subject to the following conditions:
+//
+//	The above copyright notice and this permission notice shall be included in
+//	all copies or substantial portions of the Software.
+//
+//	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//	THE SOFTWARE.
+
+// Private header: thin register-level wrappers so that See kernels can be
+// written once for AVX2, SSE and NEON. The instruction set follows the compiler
+// target (not SEE_BACKEND_*), so hand-written kernels stay vectorized even when
+// Accelerate provides the generic vector routines. Defining SEE_BACKEND_SCALAR
+// turns every register into a single float.
+
+#ifndef SEE_SIMD
+#define SEE_SIMD
+
+#include "SeeVector.h"
+#include <math.h>
+
+#if defined(SEE_BACKEND_SCALAR)
+    #define SEE_SIMD_SCALAR
+#elif defined(__AVX2__)
+    #define SEE_SIMD_AVX2
+    #include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+    #define SEE_SIMD_SSE
+    #include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    #define SEE_SIMD_NEON
+    #include <arm_neon.h>
+#else
+    #define SEE_SIMD_SCALAR
+#endif
+
+#pragma mark FLOAT REGISTERS
+
+#if defined(SEE_SIMD_AVX2)
+
+typedef __m256 vfloat;
+#define SEE_VWIDTH 8
+
+static inline vfloat vf_load(const float *p)            { return _mm256_loadu_ps(p); }
+static inline void   vf_store(float *p, vfloat a)       { _mm256_storeu_ps(p, a); }
+static inline vfloat vf_set(float k)                    { return _mm256_set1_ps(k); }
+//! p[0], p[2], ..., p[14]
+static inline vfloat vf_load_even(const float *p)
+{
+    __m256 t = _mm256_shuffle_ps(_mm256_loadu_ps(p), _mm256_loadu_ps(p + 8), _MM_SHUFFLE(2,0,2,0));
+    return _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(t), _MM_SHUFFLE(3,1,2,0)));
+}
+static inline vfloat vf_add(vfloat a, vfloat b)         { return _mm256_add_ps(a, b); }
+static inline vfloat vf_sub(vfloat a, vfloat b)         { return _mm256_sub_ps(a, b); }
+static inline vfloat vf_mul(vfloat a, vfloat b)         { return _mm256_mul_ps(a, b); }
+static inline vfloat vf_div(vfloat a, vfloat b)         { return _mm256_div_ps(a, b); }
+static inline vfloat vf_sqrt(vfloat a)                  { return _mm256_sqrt_ps(a); }
+static inline vfloat vf_max(vfloat a, vfloat b)         { return _mm256_max_ps(a, b); }
+static inline vfloat vf_min(vfloat a, vfloat b)         { return _mm256_min_ps(a, b); }
+static inline vfloat vf_abs(vfloat a)                   { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a); }
+//! a >= b ? a : 0
+static inline vfloat vf_thres(vfloat a, vfloat b)       { return _mm256_and_ps(a, _mm256_cmp_ps(a, b, _CMP_GE_OQ)); }
+//! a >= b ? x : 0
+static inline vfloat vf_mask_ge(vfloat x, vfloat a, vfloat b) { return _mm256_and_ps(x, _mm256_cmp_ps(a, b, _CMP_GE_OQ)); }
+//! number of lanes where a > t and a >= m
+static inline int    vf_count_gt_ge(vfloat a, vfloat t, vfloat m)
+{
+    __m256 k = _mm256_and_ps(_mm256_cmp_ps(a, t, _CMP_GT_OQ), _mm256_cmp_ps(a, m, _CMP_GE_OQ));
+    return __builtin_popcount(_mm256_movemask_ps(k));
+}
+//! B, G and R of SEE_VWIDTH consecutive BGRA pixels
+static inline void   vf_load_bgra(const unsigned char *p, vfloat *b, vfloat *g, vfloat *r)
+{
+    __m256i px = _mm256_loadu_si256((const __m256i*)p), m = _mm256_set1_epi32(0xFF);
+    *b = _mm256_cvtepi32_ps(_mm256_and_si256(px, m));
+    *g = _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(px, 8), m));
+    *r = _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(px, 16), m));
+}
+static inline float  vf_hsum(vfloat a)
+{
+    __m128 s = _mm_add_ps(_mm256_castps256_ps128(a), _mm256_extractf128_ps(a, 1));
+    s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+    s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+    return _mm_cvtss_f32(s);
+}
+static inline float  vf_hmax(vfloat a)
+{
+    __m128 s = _mm_max_ps(_mm256_castps256_ps128(a), _mm256_extractf128_ps(a, 1));
+    s = _mm_max_ps(s, _mm_movehl_ps(s, s));
+    s = _mm_max_ss(s, _mm_shuffle_ps(s, s, 1));
+    return _mm_cvtss_f32(s);
+}
+static inline float  vf_hmin(vfloat a)
+{
+    __m128 s = _mm_min_ps(_mm256_castps256_ps128(a), _mm256_extractf128_ps(a, 1));
+    s = _mm_min_ps(s, _mm_movehl_ps(s, s));
+    s = _mm_min_ss(s, _mm_shuffle_ps(s, s, 1));
+    return _mm_cvtss_f32(s);
+}
+
+// sum of absolute differences of n bytes (psadbw)
+static inline unsigned int vu8_sad(const unsigned char *a, const unsigned char *b, size_t n)
+{
+    size_t i = 0;
+    __m256i acc = _mm256_setzero_si256();
+    for (; i+32<=n; i+=32)
+        acc = _mm256_add_epi64(acc, _mm256_sad_epu8(_mm256_loadu_si256((const __m256i *)(a+i)),
+                                                    _mm256_loadu_si256((const __m256i *)(b+i))));
+    __m128i s = _mm_add_epi64(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+    if (i+16 <= n)
+    {
+        s = _mm_add_epi64(s, _mm_sad_epu8(_mm_loadu_si128((const __m128i *)(a+i)), _mm_loadu_si128((const __m128i *)(b+i))));
+        i += 16;
+    }
+    unsigned int sum = (unsigned int)(_mm_cvtsi128_si32(s) + _mm_cvtsi128_si32(_mm_srli_si128(s, 8)));
+    for (; i<n; i++) sum += (a[i] > b[i] ? a[i] - b[i] : b[i] - a[i]);
+    return sum;
+}
+
+// sums of k*|a1 - a0| and of max(k*|a1 - a0| - |b1 - b0|, 0) over n bytes 
+// (k*255 must fit in 16 bits; n up to 65535 pixels)
+static inline void vu8_blur_variation(const unsigned char *a0, const unsigned char *a1, 
+                                      const unsigned char *b0, const unsigned char *b1, size_t n, 
+                                      unsigned short k, unsigned long long *sumDiff, unsigned long long *sumVariation)
+{
+    size_t i = 0;
+    unsigned int sd = 0, sv = 0;
+    __m256i accD = _mm256_setzero_si256(), accV = _mm256_setzero_si256(), vk = _mm256_set1_epi16(k);
+    __m256i lo = _mm256_set1_epi32(0xffff);
+    for (; i+16<=n; i+=16)
+    {
+        __m256i x0 = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(a0+i)));
+        __m256i x1 = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(a1+i)));
+        __m256i y0 = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(b0+i)));
+        __m256i y1 = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(b1+i)));
+        __m256i d = _mm256_mullo_epi16(_mm256_or_si256(_mm256_subs_epu16(x1, x0), _mm256_subs_epu16(x0, x1)), vk);
+        __m256i e = _mm256_or_si256(_mm256_subs_epu16(y1, y0), _mm256_subs_epu16(y0, y1));
+        __m256i v = _mm256_subs_epu16(d, e);
+        // widen to 32 bits (odd and even lanes)
+        accD = _mm256_add_epi32(accD, _mm256_add_epi32(_mm256_srli_epi32(d, 16), _mm256_and_si256(d, lo)));
+        accV = _mm256_add_epi32(accV, _mm256_add_epi32(_mm256_srli_epi32(v, 16), _mm256_and_si256(v, lo)));
+    }
+    __m128i d4 = _mm_add_epi32(_mm256_castsi256_si128(accD), _mm256_extracti128_si256(accD, 1));
+    __m128i v4 = _mm_add_epi32(_mm256_castsi256_si128(accV), _mm256_extracti128_si256(accV, 1));
+    d4 = _mm_add_epi32(d4, _mm_srli_si128(d4, 8)); d4 = _mm_add_epi32(d4, _mm_srli_si128(d4, 4));
+    v4 = _mm_add_epi32(v4, _mm_srli_si128(v4, 8)); v4 = _mm_add_epi32(v4, _mm_srli_si128(v4, 4));
+    sd = (unsigned int)_mm_cvtsi128_si32(d4);
+    sv = (unsigned int)_mm_cvtsi128_si32(v4);
+    for (; i<n; i++)
+    {
+        unsigned int d = k*(a1[i] > a0[i] ? a1[i] - a0[i] : a0[i] - a1[i]);
+        unsigned int e = (b1[i] > b0[i] ? b1[i] - b0[i] : b0[i] - b1[i]);
+        sd += d;
+        sv += (d > e ? d - e : 0);
+    }
+    *sumDiff += sd;
+    *sumVariation += sv;
+}
+
+#elif defined(SEE_SIMD_SSE)
+
+typedef __m128 vfloat;
+#define SEE_VWIDTH 4
+
+static inline vfloat vf_load(const float *p)            { return _mm_loadu_ps(p); }
+static inline void   vf_store(float *p, vfloat a)       { _mm_storeu_ps(p, a); }
+static inline vfloat vf_set(float k)                    { return _mm_set1_ps(k); }
+static inline vfloat vf_load_even(const float *p)
+{
+    return _mm_shuffle_ps(_mm_loadu_ps(p), _mm_loadu_ps(p + 4), _MM_SHUFFLE(2,0,2,0));
+}
+static inline vfloat vf_add(vfloat a, vfloat b)         { return _mm_add_ps(a, b); }
+static inline vfloat vf_sub(vfloat a, vfloat b)         { return _mm_sub_ps(a, b); }
+static inline vfloat vf_mul(vfloat a, vfloat b)         { return _mm_mul_ps(a, b); }
+static inline vfloat vf_div(vfloat a, vfloat b)         { return _mm_div_ps(a, b); }
+static inline vfloat vf_sqrt(vfloat a)                  { return _mm_sqrt_ps(a); }
+static inline vfloat vf_max(vfloat a, vfloat b)         { return _mm_max_ps(a, b); }
+static inline vfloat vf_min(vfloat a, vfloat b)         { return _mm_min_ps(a, b); }
+static inline vfloat vf_abs(vfloat a)                   { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+static inline vfloat vf_thres(vfloat a, vfloat b)       { return _mm_and_ps(a, _mm_cmpge_ps(a, b)); }
+static inline vfloat vf_mask_ge(vfloat x, vfloat a, vfloat b) { return _mm_and_ps(x, _mm_cmpge_ps(a, b)); }
+static inline int    vf_count_gt_ge(vfloat a, vfloat t, vfloat m)
+{
+    // popcount of the 4-bit mask from a table packed in nibbles (SSE2 targets may lack popcnt)
+    int k = _mm_movemask_ps(_mm_and_ps(_mm_cmpgt_ps(a, t), _mm_cmpge_ps(a, m)));
+    return (int)((0x4332322132212110ULL >> (4*k)) & 0xF);
+}
+static inline void   vf_load_bgra(const unsigned char *p, vfloat *b, vfloat *g, vfloat *r)
+{
+    __m128i px = _mm_loadu_si128((const __m128i*)p), m = _mm_set1_epi32(0xFF);
+    *b = _mm_cvtepi32_ps(_mm_and_si128(px, m));
+    *g = _mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(px, 8), m));
+    *r = _mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(px, 16), m));
+}
+static inline float  vf_hsum(vfloat a)
+{
+    __m128 s = _mm_add_ps(a, _mm_movehl_ps(a, a));
+    s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+    return _mm_cvtss_f32(s);
+}
+static inline float  vf_hmax(vfloat a)
+{
+    __m128 s = _mm_max_ps(a, _mm_movehl_ps(a, a));
+    s = _mm_max_ss(s, _mm_shuffle_ps(s, s, 1));
+    return _mm_cvtss_f32(s);
+}
+static inline float  vf_hmin(vfloat a)
+{
+    __m128 s = _mm_min_ps(a, _mm_movehl_ps(a, a));
+    s = _mm_min_ss(s, _mm_shuffle_ps(s, s, 1));
+    return _mm_cvtss_f32(s);
+}
+
+// sum of absolute differences of n bytes (psadbw)
+static inline unsigned int vu8_sad(const unsigned char *a, const unsigned char *b, size_t n)
+{
+    size_t i = 0;
+    __m128i s = _mm_setzero_si128();
+    for (; i+16<=n; i+=16)
+        s = _mm_add_epi64(s, _mm_sad_epu8(_mm_loadu_si128((const __m128i *)(a+i)), _mm_loadu_si128((const __m128i *)(b+i))));
+    unsigned int sum = (unsigned int)(_mm_cvtsi128_si32(s) + _mm_cvtsi128_si32(_mm_srli_si128(s, 8)));
+    for (; i<n; i++) sum += (a[i] > b[i] ? a[i] - b[i] : b[i] - a[i]);
+    return sum;
+}
+
+// sums of k*|a1 - a0| and of max(k*|a1 - a0| - |b1 - b0|, 0) over n bytes 
+// (k*255 must fit in 16 bits; n up to 65535 pixels)
+static inline void vu8_blur_variation(const unsigned char *a0, const unsigned char *a1, 
+                                      const unsigned char *b0, const unsigned char *b1, size_t n, 
+                                      unsigned short k, unsigned long long *sumDiff, unsigned long long *sumVariation)
+{
+    size_t i = 0;
+    unsigned int sd = 0, sv = 0;
+    __m128i accD = _mm_setzero_si128(), accV = _mm_setzero_si128(), vk = _mm_set1_epi16(k);
+    __m128i zero = _mm_setzero_si128(), lo = _mm_set1_epi32(0xffff);
+    for (; i+8<=n; i+=8)
+    {
+        __m128i x0 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(a0+i)), zero);
+        __m128i x1 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(a1+i)), zero);
+        __m128i y0 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(b0+i)), zero);
+        __m128i y1 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(b1+i)), zero);
+        __m128i d = _mm_mullo_epi16(_mm_or_si128(_mm_subs_epu16(x1, x0), _mm_subs_epu16(x0, x1)), vk);
+        __m128i e = _mm_or_si128(_mm_subs_epu16(y1, y0), _mm_subs_epu16(y0, y1));
+        __m128i v = _mm_subs_epu16(d, e);
+        // widen to 32 bits (odd and even lanes)
+        accD = _mm_add_epi32(accD, _mm_add_epi32(_mm_srli_epi32(d, 16), _mm_and_si128(d, lo)));
+        accV = _mm_add_epi32(accV, _mm_add_epi32(_mm_srli_epi32(v, 16), _mm_and_si128(v, lo)));
+    }
+    accD = _mm_add_epi32(accD, _mm_srli_si128(accD, 8)); accD = _mm_add_epi32(accD, _mm_srli_si128(accD, 4));
+    accV = _mm_add_epi32(accV, _mm_srli_si128(accV, 8)); accV = _mm_add_epi32(accV, _mm_srli_si128(accV, 4));
+    sd = (unsigned int)_mm_cvtsi128_si32(accD);
+    sv = (unsigned int)_mm_cvtsi128_si32(accV);
+    for (; i<n; i++)
+    {
+        unsigned int d = k*(a1[i] > a0[i] ? a1[i] - a0[i] : a0[i] - a1[i]);
+        unsigned int e = (b1[i] > b0[i] ? b1[i] - b0[i] : b0[i] - b1[i]);
+        sd += d;
+        sv += (d > e ? d - e : 0);
+    }
+    *sumDiff += sd;
+    *sumVariation += sv;
+}
+
+#elif defined(SEE_SIMD_NEON)
+
+typedef float32x4_t vfloat;
+#define SEE_VWIDTH 4
+
+static inline vfloat vf_load(const float *p)            { return vld1q_f32(p); }
+static inline void   vf_store(float *p, vfloat a)       { vst1q_f32(p, a); }
+static inline vfloat vf_set(float k)                    { return vdupq_n_f32(k); }
+static inline vfloat vf_load_even(const float *p)       { return vld2q_f32(p).val[0]; }
+static inline vfloat vf_add(vfloat a, vfloat b)         { return vaddq_f32(a, b); }
+static inline vfloat vf_sub(vfloat a, vfloat b)         { return vsubq_f32(a, b); }
+static inline vfloat vf_mul(vfloat a, vfloat b)         { return vmulq_f32(a, b); }
+#if defined(__aarch64__)
+static inline vfloat vf_div(vfloat a, vfloat b)         { return vdivq_f32(a, b); }
+static inline vfloat vf_sqrt(vfloat a)                  { return vsqrtq_f32(a); }
+#else
+static inline vfloat vf_div(vfloat a, vfloat b)
+{
+    // no vector divide on ARMv7 (the reciprocal estimate would not be exact)
+    float x[4], y[4];
+    vst1q_f32(x, a); vst1q_f32(y, b);
+    x[0] /= y[0]; x[1] /= y[1]; x[2] /= y[2]; x[3] /= y[3];
+    return vld1q_f32(x);
+}
+static inline vfloat vf_sqrt(vfloat a)
+{
+    float x[4];
+    vst1q_f32(x, a);
+    x[0] = sqrtf(x[0]); x[1] = sqrtf(x[1]); x[2] = sqrtf(x[2]); x[3] = sqrtf(x[3]);
+    return vld1q_f32(x);
+}
+#endif
+static inline vfloat vf_max(vfloat a, vfloat b)         { return vmaxq_f32(a, b); }
+static inline vfloat vf_min(vfloat a, vfloat b)         { return vminq_f32(a, b); }
+static inline vfloat vf_abs(vfloat a)                   { return vabsq_f32(a); }
+static inline vfloat vf_thres(vfloat a, vfloat b)
+{
+    return vreinterpretq_f32_u32(vandq_u32(vreinterpretq_u32_f32(a), vcgeq_f32(a, b)));
+}
+static inline vfloat vf_mask_ge(vfloat x, vfloat a, vfloat b)
+{
+    return vreinterpretq_f32_u32(vandq_u32(vreinterpretq_u32_f32(x), vcgeq_f32(a, b)));
+}
+static inline int    vf_count_gt_ge(vfloat a, vfloat t, vfloat m)
+{
+    uint32x4_t k = vshrq_n_u32(vandq_u32(vcgtq_f32(a, t), vcgeq_f32(a, m)), 31);
+    uint32x2_t c = vadd_u32(vget_low_u32(k), vget_high_u32(k));
+    return (int)vget_lane_u32(vpadd_u32(c, c), 0);
+}
+static inline void   vf_load_bgra(const unsigned char *p, vfloat *b, vfloat *g, vfloat *r)
+{
+    uint32x4_t px = vreinterpretq_u32_u8(vld1q_u8(p)), m = vdupq_n_u32(0xFF);
+    *b = vcvtq_f32_u32(vandq_u32(px, m));
+    *g = vcvtq_f32_u32(vandq_u32(vshrq_n_u32(px, 8), m));
+    *r = vcvtq_f32_u32(vandq_u32(vshrq_n_u32(px, 16), m));
+}
+static inline float  vf_hsum(vfloat a)
+{
+    float32x2_t s = vadd_f32(vget_low_f32(a), vget_high_f32(a));
+    return vget_lane_f32(vpadd_f32(s, s), 0);
+}
+static inline float  vf_hmax(vfloat a)
+{
+    float32x2_t s = vmax_f32(vget_low_f32(a), vget_high_f32(a));
+    return vget_lane_f32(vpmax_f32(s, s), 0);
+}
+static inline float  vf_hmin(vfloat a)
+{
+    float32x2_t s = vmin_f32(vget_low_f32(a), vget_high_f32(a));
+    return vget_lane_f32(vpmin_f32(s, s), 0);
+}
+
+// sum of absolute differences of n bytes (vabd, widened pairwise into 32-bit lanes)
+static inline unsigned int vu8_sad(const unsigned char *a, const unsigned char *b, size_t n)
+{
+    size_t i = 0;
+    uint32x4_t acc = vdupq_n_u32(0);
+    for (; i+16<=n; i+=16)
+        acc = vpadalq_u16(acc, vpaddlq_u8(vabdq_u8(vld1q_u8(a+i), vld1q_u8(b+i))));
+    uint64x2_t s = vpaddlq_u32(acc);
+    unsigned int sum = (unsigned int)(vgetq_lane_u64(s, 0) + vgetq_lane_u64(s, 1));
+    for (; i<n; i++) sum += (a[i] > b[i] ? a[i] - b[i] : b[i] - a[i]);
+    return sum;
+}
+
+// sums of k*|a1 - a0| and of max(k*|a1 - a0| - |b1 - b0|, 0) over n bytes 
+// (k*255 must fit in 16 bits; n up to 65535 pixels)
+static inline void vu8_blur_variation(const unsigned char *a0, const unsigned char *a1, 
+                                      const unsigned char *b0, const unsigned char *b1, size_t n, 
+                                      unsigned short k, unsigned long long *sumDiff, unsigned long long *sumVariation)
+{
+    size_t i = 0;
+    unsigned int sd = 0, sv = 0;
+    uint32x4_t accD = vdupq_n_u32(0), accV = vdupq_n_u32(0);
+    for (; i+8<=n; i+=8)
+    {
+        uint16x8_t d = vmulq_n_u16(vmovl_u8(vabd_u8(vld1_u8(a1+i), vld1_u8(a0+i))), k);
+        uint16x8_t e = vmovl_u8(vabd_u8(vld1_u8(b1+i), vld1_u8(b0+i)));
+        accD = vpadalq_u16(accD, d);
+        accV = vpadalq_u16(accV, vqsubq_u16(d, e));
+    }
+    uint64x2_t d2 = vpaddlq_u32(accD), v2 = vpaddlq_u32(accV);
+    sd = (unsigned int)(vgetq_lane_u64(d2, 0) + vgetq_lane_u64(d2, 1));
+    sv = (unsigned int)(vgetq_lane_u64(v2, 0) + vgetq_lane_u64(v2, 1));
+    for (; i<n; i++)
+    {
+        unsigned int d = k*(a1[i] > a0[i] ? a1[i] - a0[i] : a0[i] - a1[i]);
+        unsigned int e = (b1[i] > b0[i] ? b1[i] - b0[i] : b0[i] - b1[i]);
+        sd += d;
+        sv += (d > e ? d - e : 0);
+    }
+    *sumDiff += sd;
+    *sumVariation += sv;
+}
+
+#else
+
+typedef float vfloat;
+#define SEE_VWIDTH 1
+
+static inline vfloat vf_load(const float *p)            { return *p; }
+static inline void   vf_store(float *p, vfloat a)       { *p = a; }
+static inline vfloat vf_set(float k)                    { return k; }
+static inline vfloat vf_load_even(const float *p)       { return *p; }
+static inline vfloat vf_add(vfloat a, vfloat b)         { return a + b; }
+static inline vfloat vf_sub(vfloat a, vfloat b)         { return a - b; }
+static inline vfloat vf_mul(vfloat a, vfloat b)         { return a * b; }
+static inline vfloat vf_div(vfloat a, vfloat b)         { return a / b; }
+static inline vfloat vf_sqrt(vfloat a)                  { return sqrtf(a); }
+static inline vfloat vf_max(vfloat a, vfloat b)         { return (a > b ? a : b); }
+static inline vfloat vf_min(vfloat a, vfloat b)         { return (a < b ? a : b); }
+static inline vfloat vf_abs(vfloat a)                   { return fabsf(a); }
+static inline vfloat vf_thres(vfloat a, vfloat b)       { return (a >= b ? a : 0.0f); }
+static inline vfloat vf_mask_ge(vfloat x, vfloat a, vfloat b) { return (a >= b ? x : 0.0f); }
+static inline int    vf_count_gt_ge(vfloat a, vfloat t, vfloat m) { return (a > t && a >= m); }
+static inline void   vf_load_bgra(const unsigned char *p, vfloat *b, vfloat *g, vfloat *r)
+{
+    *b = p[0]; *g = p[1]; *r = p[2];
+}
+static inline float  vf_hsum(vfloat a)                  { return a; }
+static inline float  vf_hmax(vfloat a)                  { return a; }
+static inline float  vf_hmin(vfloat a)                  { return a; }
+
+
+// sum of absolute differences of n bytes
+static inline unsigned int vu8_sad(const unsigned char *a, const unsigned char *b, size_t n)
+{
+    size_t i = 0;
+    unsigned int sum = 0;
+    for (; i<n; i++) sum += (a[i] > b[i] ? a[i] - b[i] : b[i] - a[i]);
+    return sum;
+}
+
+// sums of k*|a1 - a0| and of max(k*|a1 - a0| - |b1 - b0|, 0) over n bytes 
+// (k*255 must fit in 16 bits; n up to 65535 pixels)
+static inline void vu8_blur_variation(const unsigned char *a0, const unsigned char *a1, 
+                                      const unsigned char *b0, const unsigned char *b1, size_t n, 
+                                      unsigned short k, unsigned long long *sumDiff, unsigned long long *sumVariation)
+{
+    size_t i = 0;
+    unsigned int sd = 0, sv = 0;
+    for (; i<n; i++)
+    {
+        unsigned int d = k*(a1[i] > a0[i] ? a1[i] - a0[i] : a0[i] - a1[i]);
+        unsigned int e = (b1[i] > b0[i] ? b1[i] - b0[i] : b0[i] - b1[i]);
+        sd += d;
+        sv += (d > e ? d - e : 0);
+    }
+    *sumDiff += sd;
+    *sumVariation += sv;
+}
+
+#endif
+
+#endif
@@ -0,0 +1,191 @@
+//
+//  SeeThreadPool.cpp
+//  Framework-See
+//
+//	Copyright 2014 Carnegie Mellon University
+//
+//	This work was developed under the Rehabilitation Engineering Research
+//	Center on Accessible Public Transportation (www.rercapt.org) and is funded
+//	by grant number H133E080019 from the United States Department of Education
+//	through the National Institute on Disability and Rehabilitation Research.
+//	No endorsement should be assumed by NIDRR or the United States Government
+//	for the content contained on this code.
+//
+//	Permission is hereby granted, free of charge, to any person obtaining a copy
+//	of this software and associated documentation files (the "Software"), to deal
+//	in the Software without restriction, including without limitation the rights
+//	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//	copies of the Software, and to permit persons to whom the Software is
+//	furnished to do so, subject to the following conditions:
+//
+//	The above copyright notice and this permission notice shall be included in
+//	all copies or substantial portions of the Software.
+//
+//	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//	THE SOFTWARE.
+
+
+#include "SeeThreadPool.h"
+#include <assert.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+/*! Tasks submitted by one call to see_threadPoolRun (lives on the caller's stack) */
+typedef struct ThreadPoolBatch
+{
+    see_task task;
+    void *context;
+    size_t n;                               //!< number of tasks
+    size_t next;                            //!< next task to be claimed
+    size_t pending;                         //!< tasks that have not finished yet
+    struct ThreadPoolBatch *older;          //!< batch submitted before this one
+} ThreadPoolBatch;
+
+struct ThreadPool
+{
+    pthread_mutex_t lock;
+    pthread_cond_t work;                    //!< signaled when a batch is submitted or the pool stops
+    pthread_cond_t done;                    //!< signaled when a batch finishes
+    ThreadPoolBatch *batches;               //!< batches with unclaimed tasks (newest first)
+    bool quit;
+    size_t nworkers;
+    pthread_t *workers;
+};
+
+#pragma mark PRIVATE
+
+/*! Claim the next task of a batch (lock held)
+    \note The batch leaves the list once all of its tasks have been claimed.
+ */
+static size_t see_threadPoolClaim(ThreadPool *pool, ThreadPoolBatch *batch)
+{
+    size_t i = batch->next++;
+    if (batch->next == batch->n)
+    {
+        ThreadPoolBatch **b = &pool->batches;
+        while (*b != batch) b = &(*b)->older;
+        *b = batch->older;
+    }
+    return i;
+}
+
+/*! Run a claimed task and account for it (lock held, released while the task runs) */
+static void see_threadPoolExecute(ThreadPool *pool, ThreadPoolBatch *batch, size_t i)
+{
+    pthread_mutex_unlock(&pool->lock);
+    batch->task(batch->context, i);
+    pthread_mutex_lock(&pool->lock);
+    
+    if (--batch->pending == 0) pthread_cond_broadcast(&pool->done);
+}
+
+static void* see_threadPoolWorker(void *arg)
+{
+    ThreadPool *pool = (ThreadPool *)arg;
+    
+    pthread_mutex_lock(&pool->lock);
+    while (!pool->quit)
+    {
+        // nested batches are newer, so they are served first
+        ThreadPoolBatch *batch = pool->batches;
+        if (batch == 0)
+        {
+            pthread_cond_wait(&pool->work, &pool->lock);
+            continue;
+        }
+        see_threadPoolExecute(pool, batch, see_threadPoolClaim(pool, batch));
+    }
+    pthread_mutex_unlock(&pool->lock);
+    
+    return 0;
+}
+
+#pragma mark THREAD POOL
+
+size_t see_numberOfCores()
+{
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return (n > 0 ? (size_t)n : 1);
+}
+
+ThreadPool* see_createThreadPool(size_t threads)
+{
+    assert(threads > 0);
+    
+    ThreadPool *pool = (ThreadPool *)malloc(sizeof(ThreadPool));
+    assert(pool != 0);
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->work, NULL);
+    pthread_cond_init(&pool->done, NULL);
+    pool->batches = 0;
+    pool->quit = false;
+    pool->nworkers = 0;
+    pool->workers = (pthread_t *)malloc((threads - 1)*sizeof(pthread_t) + 1);
+    
+    for (size_t i=0; i<threads-1; i++)
+    {
+        if (pthread_create(&pool->workers[pool->nworkers], NULL, see_threadPoolWorker, pool) != 0) break;
+        pool->nworkers++;
+    }
+    
+    return pool;
+}
+
+size_t see_threadPoolSize(const ThreadPool *pool)
+{
+    return (pool == 0 ? 1 : pool->nworkers + 1);
+}
+
+void see_threadPoolRun(ThreadPool *pool, see_task task, void *context, size_t n)
+{
+    if (n == 0) return;
+    if (pool == 0 || pool->nworkers == 0 || n == 1)
+    {
+        for (size_t i=0; i<n; i++) task(context, i);
+        return;
+    }
+    
+    ThreadPoolBatch batch;
+    batch.task = task;
+    batch.context = context;
+    batch.n = n;
+    batch.next = 0;
+    batch.pending = n;
+    
+    pthread_mutex_lock(&pool->lock);
+    batch.older = pool->batches;
+    pool->batches = &batch;
+    pthread_cond_broadcast(&pool->work);
+    
+    // work on the batch, then wait for the tasks that other threads are running
+    while (batch.next < batch.n)
+        see_threadPoolExecute(pool, &batch, see_threadPoolClaim(pool, &batch));
+    while (batch.pending > 0)
+        pthread_cond_wait(&pool->done, &pool->lock);
+    
+    pthread_mutex_unlock(&pool->lock);
+}
+
+void see_freeThreadPool(ThreadPool *pool)
+{
+    if (pool == 0) return;
+    
+    pthread_mutex_lock(&pool->lock);
+    pool->quit = true;
+    pthread_cond_broadcast(&pool->work);
+    pthread_mutex_unlock(&pool->lock);
+    
+    for (size_t i=0; i<pool->nworkers; i++) pthread_join(pool->workers[i], NULL);
+    
+    pthread_cond_destroy(&pool->done);
+    pthread_cond_destroy(&pool->work);
+    pthread_mutex_destroy(&pool->lock);
+    free(pool->workers);
+    free(pool);
+}
@@ -0,0 +1,82 @@
+//
+//  SeeThreadPool.h
+//  Framework-See
+//
+//	Copyright 2014 Carnegie Mellon University
+//
+//	This work was developed under the Rehabilitation Engineering Research
+//	Center on Accessible Public Transportation (www.rercapt.org) and is funded
+//	by grant number H133E080019 from the United States Department of Education
+//	through the National Institute on Disability and Rehabilitation Research.
+//	No endorsement should be assumed by NIDRR or the United States Government
+//	for the content contained on this code.
+//
+//	Permission is hereby granted, free of charge, to any person obtaining a copy
+//	of this software and associated documentation files (the "Software"), to deal
+//	in the Software without restriction, including without limitation the rights
+//	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//	copies of the Software, and to permit persons to whom the Software is
+//	furnished to do so, subject to the following conditions:
+//
+//	The above copyright notice and this permission notice shall be included in
+//	all copies or substantial portions of the Software.
+//
+//	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//	THE SOFTWARE.
+
+
+#ifndef SEE_THREAD_POOL
+#define SEE_THREAD_POOL
+
+#include <stddef.h>
+
+#if __cplusplus
+extern "C" {
+#endif
+    
+    /*! Persistent pool of worker threads (opaque) */
+    typedef struct ThreadPool ThreadPool;
+    
+    /*! Task run by a pool
+        \param context data shared by all the tasks of a batch
+        \param index task index within the batch
+     */
+    typedef void (*see_task)(void *context, size_t index);
+    
+    /*! Number of processors online */
+    size_t see_numberOfCores();
+    
+    /*! Start a pool
+        \param threads number of threads doing work, including the one that calls see_threadPoolRun 
+        (<a>threads</a> - 1 workers are started)
+        \return pool (release with see_freeThreadPool)
+     */
+    ThreadPool* see_createThreadPool(size_t threads);
+    
+    /*! Number of threads doing work in a pool (including the caller) */
+    size_t see_threadPoolSize(const ThreadPool *pool);
+    
+    /*! Run a batch of tasks and wait for all of them to finish
+        \param pool pool (if NULL, the tasks are run in order by the calling thread)
+        \param task task
+        \param context data passed to every task
+        \param n number of tasks (indices 0 to <a>n</a>-1)
+     
+        The calling thread works on the batch too. Tasks may run batches of their own on the 
+        same pool: a thread waiting for a batch only waits for tasks that are already running.
+     */
+    void see_threadPoolRun(ThreadPool *pool, see_task task, void *context, size_t n);
+    
+    /*! Stop the workers of a pool and release it */
+    void see_freeThreadPool(ThreadPool *pool);
+    
+#if __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,538 @@
+//
+//  SeeVector.cpp
+//  Framework-See
+//
+//	Copyright 2014 Carnegie Mellon University
+//
+//	This work was developed under the Rehabilitation Engineering Research
+//	Center on Accessible Public Transportation (www.rercapt.org) and is funded
+//	by grant number H133E080019 from the United States Department of Education
+//	through the National Institute on Disability and Rehabilitation Research.
+//	No endorsement should be assumed by NIDRR or the United States Government
+//	for the content contained on this code.
+//
+//	Permission is hereby granted, free of charge, to any person obtaining a copy
+//	of this software and associated documentation files (the "Software"), to deal
+//	in the Software without restriction, including without limitation the rights
+//	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//	copies of the Software, and to permit persons to whom the Software is
+//	furnished to do so, subject to the following conditions:
+//
+//	The above copyright notice and this permission notice shall be included in
+//	all copies or substantial portions of the Software.
+//
+//	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//	THE SOFTWARE.
+
+#include "SeeVector.h"
+#include "SeeSIMD.h"
+#include <string.h>
+
+#ifdef SEE_BACKEND_ACCELERATE
+
+#pragma mark ACCELERATE BACKEND
+
+const char* see_vectorBackend() { return "accelerate"; }
+
+void see_scopy(int n, const float *x, int incx, float *y, int incy)
+{ cblas_scopy(n, x, incx, y, incy); }
+
+void see_vclr(float *c, long ic, size_t n)
+{ vDSP_vclr(c, ic, n); }
+
+void see_vramp(const float *a, const float *b, float *c, long ic, size_t n)
+{ vDSP_vramp(a, b, c, ic, n); }
+
+void see_vfltu8(const unsigned char *a, long ia, float *c, long ic, size_t n)
+{ vDSP_vfltu8(a, ia, c, ic, n); }
+
+void see_vfixru8(const float *a, long ia, unsigned char *c, long ic, size_t n)
+{ vDSP_vfixru8(a, ia, c, ic, n); }
+
+void see_vflt32(const int *a, long ia, float *c, long ic, size_t n)
+{ vDSP_vflt32(a, ia, c, ic, n); }
+
+void see_vfix32(const float *a, long ia, int *c, long ic, size_t n)
+{ vDSP_vfix32(a, ia, c, ic, n); }
+
+void see_vadd(const float *a, long ia, const float *b, long ib, float *c, long ic, size_t n)
+{ vDSP_vadd(a, ia, b, ib, c, ic, n); }
+
+void see_vsub(const float *a, long ia, const float *b, long ib, float *c, long ic, size_t n)
+{ vDSP_vsub(a, ia, b, ib, c, ic, n); }
+
+void see_vsadd(const float *a, long ia, const float *b, float *c, long ic, size_t n)
+{ vDSP_vsadd(a, ia, b, c, ic, n); }
+
+void see_vsmul(const float *a, long ia, const float *b, float *c, long ic, size_t n)
+{ vDSP_vsmul(a, ia, b, c, ic, n); }
+
+void see_vsma(const float *a, long ia, const float *b, const float *c, long ic, float *d, long id, size_t n)
+{ vDSP_vsma(a, ia, b, c, ic, d, id, n); }
+
+void see_sscal(int n, float alpha, float *x, int incx)
+{ cblas_sscal(n, alpha, x, incx); }
+
+void see_vabs(const float *a, long ia, float *c, long ic, size_t n)
+{ vDSP_vabs(a, ia, c, ic, n); }
+
+void see_vmax(const float *a, long ia, const float *b, long ib, float *c, long ic, size_t n)
+{ vDSP_vmax(a, ia, b, ib, c, ic, n); }
+
+void see_vmin(const float *a, long ia, const float *b, long ib, float *c, long ic, size_t n)
+{ vDSP_vmin(a, ia, b, ib, c, ic, n); }
+
+void see_vthres(const float *a, long ia, const float *b, float *c, long ic, size_t n)
+{ vDSP_vthres(a, ia, b, c, ic, n); }
+
+void see_maxv(const float *a, long ia, float *c, size_t n)
+{ vDSP_maxv(a, ia, c, n); }
+
+void see_minv(const float *a, long ia, float *c, size_t n)
+{ vDSP_minv(a, ia, c, n); }
+
+void see_sve(const float *a, long ia, float *c, size_t n)
+{ vDSP_sve(a, ia, c, n); }
+
+void see_svesq(const float *a, long ia, float *c, size_t n)
+{ vDSP_svesq(a, ia, c, n); }
+
+void see_minsve(const float *a, long ia, float *minimum, float *sum, size_t n)
+{
+    vDSP_minv(a, ia, minimum, n);
+    vDSP_sve(a, ia, sum, n);
+}
+
+void see_dotpr(const float *a, long ia, const float *b, long ib, float *c, size_t n)
+{ vDSP_dotpr(a, ia, b, ib, c, n); }
+
+void see_conv(const float *a, long ia, const float *f, long ifl,
+              float *c, long ic, size_t n, size_t p)
+{ vDSP_conv(a, ia, f, ifl, c, ic, n, p); }
+
+void see_desamp(const float *a, long df, const float *f, float *c, size_t n, size_t p)
+{ vDSP_desamp(a, df, f, c, n, p); }
+
+void see_vlint(const float *a, const float *b, long ib, float *c, long ic, size_t n, size_t m)
+{ vDSP_vlint(a, b, ib, c, ic, n, m); }
+
+#else
+
+#pragma mark SIMD BACKEND
+
+const char* see_vectorBackend()
+{
+#if defined(SEE_BACKEND_AVX2)
+    return "avx2";
+#elif defined(SEE_BACKEND_SSE)
+    return "sse";
+#elif defined(SEE_BACKEND_NEON)
+    return "neon";
+#else
+    return "scalar";
+#endif
+}
+
+/*! Copy vector (same semantics as cblas_scopy, including negative strides) */
+void see_scopy(int n, const float *x, int incx, float *y, int incy)
+{
+    if (n <= 0) return;
+    if (incx == 1 && incy == 1) { memmove(y, x, n*sizeof(float)); return; }
+    if (incx < 0) x += (1 - n)*incx;
+    if (incy < 0) y += (1 - n)*incy;
+    for (int i = 0; i < n; i++) y[i*incy] = x[i*incx];
+}
+
+void see_vclr(float *c, long ic, size_t n)
+{
+    if (ic == 1) { memset(c, 0, n*sizeof(float)); return; }
+    for (size_t i = 0; i < n; i++) c[i*ic] = 0.0f;
+}
+
+void see_vramp(const float *a, const float *b, float *c, long ic, size_t n)
+{
+    float init = *a, inc = *b;
+    for (size_t i = 0; i < n; i++) c[i*ic] = init + i*inc;
+}
+
+void see_vfltu8(const unsigned char *a, long ia, float *c, long ic, size_t n)
+{
+    size_t i = 0;
+    if (ia == 1 && ic == 1)
+    {
+#if defined(SEE_SIMD_AVX2) || defined(SEE_SIMD_SSE)
+        const __m128i zero = _mm_setzero_si128();
+        for (; i + 16 <= n; i += 16)
+        {
+            __m128i v = _mm_loadu_si128((const __m128i*)(a + i));
+            __m128i lo = _mm_unpacklo_epi8(v, zero), hi = _mm_unpackhi_epi8(v, zero);
+            _mm_storeu_ps(c + i,      _mm_cvtepi32_ps(_mm_unpacklo_epi16(lo, zero)));
+            _mm_storeu_ps(c + i + 4,  _mm_cvtepi32_ps(_mm_unpackhi_epi16(lo, zero)));
+            _mm_storeu_ps(c + i + 8,  _mm_cvtepi32_ps(_mm_unpacklo_epi16(hi, zero)));
+            _mm_storeu_ps(c + i + 12, _mm_cvtepi32_ps(_mm_unpackhi_epi16(hi, zero)));
+        }
+#elif defined(SEE_SIMD_NEON)
+        for (; i + 16 <= n; i += 16)
+        {
+            uint8x16_t v = vld1q_u8(a + i);
+            uint16x8_t lo = vmovl_u8(vget_low_u8(v)), hi = vmovl_u8(vget_high_u8(v));
+            vst1q_f32(c + i,      vcvtq_f32_u32(vmovl_u16(vget_low_u16(lo))));
+            vst1q_f32(c + i + 4,  vcvtq_f32_u32(vmovl_u16(vget_high_u16(lo))));
+            vst1q_f32(c + i + 8,  vcvtq_f32_u32(vmovl_u16(vget_low_u16(hi))));
+            vst1q_f32(c + i + 12, vcvtq_f32_u32(vmovl_u16(vget_high_u16(hi))));
+        }
+#endif
+    }
+    for (; i < n; i++) c[i*ic] = (float)a[i*ia];
+}
+
+void see_vfixru8(const float *a, long ia, unsigned char *c, long ic, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+    {
+        float v = a[i*ia] + 0.5f;
+        c[i*ic] = (unsigned char)(v <= 0.0f ? 0 : (v >= 255.0f ? 255 : (int)v));
+    }
+}
+
+void see_vflt32(const int *a, long ia, float *c, long ic, size_t n)
+{
+    for (size_t i = 0; i < n; i++) c[i*ic] = (float)a[i*ia];
+}
+
+void see_vfix32(const float *a, long ia, int *c, long ic, size_t n)
+{
+    for (size_t i = 0; i < n; i++) c[i*ic] = (int)a[i*ia];
+}
+
+// element-wise binary operation with a contiguous SIMD path and a strided scalar path
+#define SEE_BINARY_OP(name, vop, sop)                                                   \
+void name(const float *a, long ia, const float *b, long ib, float *c, long ic, size_t n)\
+{                                                                                       \
+    size_t i = 0;                                                                       \
+    if (ia == 1 && ib == 1 && ic == 1)                                                  \
+    {                                                                                   \
+        for (; i + SEE_VWIDTH <= n; i += SEE_VWIDTH)                                    \
+        {                                                                               \
+            vfloat x = vf_load(a + i), y = vf_load(b + i);                              \
+            vf_store(c + i, vop);                                                       \
+        }                                                                               \
+    }                                                                                   \
+    for (; i < n; i++)                                                                  \
+    {                                                                                   \
+        float x = a[i*ia], y = b[i*ib];                                                 \
+        c[i*ic] = sop;                                                                  \
+    }                                                                                   \
+}
+
+SEE_BINARY_OP(see_vadd, vf_add(x, y), x + y)
+SEE_BINARY_OP(see_vsub, vf_sub(y, x), y - x)
+SEE_BINARY_OP(see_vmax, vf_max(x, y), (x > y ? x : y))
+SEE_BINARY_OP(see_vmin, vf_min(x, y), (x < y ? x : y))
+
+// element-wise operation against a scalar
+#define SEE_SCALAR_OP(name, vop, sop)                                                   \
+void name(const float *a, long ia, const float *b, float *c, long ic, size_t n)         \
+{                                                                                       \
+    size_t i = 0;                                                                       \
+    float k = *b;                                                                       \
+    if (ia == 1 && ic == 1)                                                             \
+    {                                                                                   \
+        vfloat y = vf_set(k);                                                           \
+        for (; i + SEE_VWIDTH <= n; i += SEE_VWIDTH)                                    \
+        {                                                                               \
+            vfloat x = vf_load(a + i);                                                  \
+            vf_store(c + i, vop);                                                       \
+        }                                                                               \
+    }                                                                                   \
+    for (; i < n; i++)                                                                  \
+    {                                                                                   \
+        float x = a[i*ia];                                                              \
+        c[i*ic] = sop;                                                                  \
+    }                                                                                   \
+}
+
+SEE_SCALAR_OP(see_vsadd, vf_add(x, y), x + k)
+SEE_SCALAR_OP(see_vsmul, vf_mul(x, y), x * k)
+SEE_SCALAR_OP(see_vthres, vf_thres(x, y), (x >= k ? x : 0.0f))
+
+void see_vsma(const float *a, long ia, const float *b, const float *c, long ic, float *d, long id, size_t n)
+{
+    size_t i = 0;
+    float k = *b;
+    if (ia == 1 && ic == 1 && id == 1)
+    {
+        vfloat y = vf_set(k);
+        for (; i + SEE_VWIDTH <= n; i += SEE_VWIDTH)
+            vf_store(d + i, vf_add(vf_mul(vf_load(a + i), y), vf_load(c + i)));
+    }
+    for (; i < n; i++) d[i*id] = a[i*ia]*k + c[i*ic];
+}
+
+void see_sscal(int n, float alpha, float *x, int incx)
+{
+    if (n <= 0 || incx <= 0) return;
+    see_vsmul(x, incx, &alpha, x, incx, n);
+}
+
+void see_vabs(const float *a, long ia, float *c, long ic, size_t n)
+{
+    size_t i = 0;
+    if (ia == 1 && ic == 1)
+        for (; i + SEE_VWIDTH <= n; i += SEE_VWIDTH) vf_store(c + i, vf_abs(vf_load(a + i)));
+    for (; i < n; i++) c[i*ic] = fabsf(a[i*ia]);
+}
+
+#pragma mark Reductions
+
+void see_maxv(const float *a, long ia, float *c, size_t n)
+{
+    float m = -INFINITY;
+    size_t i = 0;
+    if (ia == 1 && n >= SEE_VWIDTH)
+    {
+        vfloat acc = vf_load(a);
+        for (i = SEE_VWIDTH; i + SEE_VWIDTH <= n; i += SEE_VWIDTH) acc = vf_max(acc, vf_load(a + i));
+        m = vf_hmax(acc);
+    }
+    for (; i < n; i++) if (a[i*ia] > m) m = a[i*ia];
+    *c = m;
+}
+
+void see_minv(const float *a, long ia, float *c, size_t n)
+{
+    float m = INFINITY;
+    size_t i = 0;
+    if (ia == 1 && n >= SEE_VWIDTH)
+    {
+        vfloat acc = vf_load(a);
+        for (i = SEE_VWIDTH; i + SEE_VWIDTH <= n; i += SEE_VWIDTH) acc = vf_min(acc, vf_load(a + i));
+        m = vf_hmin(acc);
+    }
+    for (; i < n; i++) if (a[i*ia] < m) m = a[i*ia];
+    *c = m;
+}
+
+void see_sve(const float *a, long ia, float *c, size_t n)
+{
+    float s = 0.0f;
+    size_t i = 0;
+    if (ia == 1)
+    {
+        vfloat acc0 = vf_set(0.0f), acc1 = vf_set(0.0f);
+        for (; i + 2*SEE_VWIDTH <= n; i += 2*SEE_VWIDTH)
+        {
+            acc0 = vf_add(acc0, vf_load(a + i));
+            acc1 = vf_add(acc1, vf_load(a + i + SEE_VWIDTH));
+        }
+        s = vf_hsum(vf_add(acc0, acc1));
+    }
+    for (; i < n; i++) s += a[i*ia];
+    *c = s;
+}
+
+void see_svesq(const float *a, long ia, float *c, size_t n)
+{
+    see_dotpr(a, ia, a, ia, c, n);
+}
+
+void see_minsve(const float *a, long ia, float *minimum, float *sum, size_t n)
+{
+    float m = INFINITY, s = 0.0f;
+    size_t i = 0;
+    if (ia == 1)
+    {
+        vfloat min0 = vf_set(INFINITY), min1 = vf_set(INFINITY);
+        vfloat acc0 = vf_set(0.0f), acc1 = vf_set(0.0f);
+        for (; i + 2*SEE_VWIDTH <= n; i += 2*SEE_VWIDTH)
+        {
+            vfloat x0 = vf_load(a + i), x1 = vf_load(a + i + SEE_VWIDTH);
+            min0 = vf_min(min0, x0);
+            min1 = vf_min(min1, x1);
+            acc0 = vf_add(acc0, x0);
+            acc1 = vf_add(acc1, x1);
+        }
+        m = vf_hmin(vf_min(min0, min1));
+        s = vf_hsum(vf_add(acc0, acc1));
+    }
+    for (; i < n; i++)
+    {
+        float x = a[i*ia];
+        if (x < m) m = x;
+        s += x;
+    }
+    *minimum = m;
+    *sum = s;
+}
+
+void see_dotpr(const float *a, long ia, const float *b, long ib, float *c, size_t n)
+{
+    float s = 0.0f;
+    size_t i = 0;
+    if (ia == 1 && ib == 1)
+    {
+        vfloat acc0 = vf_set(0.0f), acc1 = vf_set(0.0f);
+        for (; i + 2*SEE_VWIDTH <= n; i += 2*SEE_VWIDTH)
+        {
+            acc0 = vf_add(acc0, vf_mul(vf_load(a + i), vf_load(b + i)));
+            acc1 = vf_add(acc1, vf_mul(vf_load(a + i + SEE_VWIDTH), vf_load(b + i + SEE_VWIDTH)));
+        }
+        s = vf_hsum(vf_add(acc0, acc1));
+    }
+    for (; i < n; i++) s += a[i*ia]*b[i*ib];
+    *c = s;
+}
+
+#pragma mark Filtering and interpolation
+
+void see_conv(const float *a, long ia, const float *f, long ifl,
+              float *c, long ic, size_t n, size_t p)
+{
+    size_t k = 0;
+    if (ia == 1 && ic == 1)
+    {
+        // four registers of output in flight per tap
+        for (; k + 4*SEE_VWIDTH <= n; k += 4*SEE_VWIDTH)
+        {
+            const float *src = a + k;
+            vfloat acc0 = vf_set(0.0f), acc1 = acc0, acc2 = acc0, acc3 = acc0;
+            for (size_t j = 0; j < p; j++, src++)
+            {
+                vfloat fj = vf_set(f[(long)j*ifl]);
+                acc0 = vf_add(acc0, vf_mul(vf_load(src), fj));
+                acc1 = vf_add(acc1, vf_mul(vf_load(src + SEE_VWIDTH), fj));
+                acc2 = vf_add(acc2, vf_mul(vf_load(src + 2*SEE_VWIDTH), fj));
+                acc3 = vf_add(acc3, vf_mul(vf_load(src + 3*SEE_VWIDTH), fj));
+            }
+            vf_store(c + k, acc0);
+            vf_store(c + k + SEE_VWIDTH, acc1);
+            vf_store(c + k + 2*SEE_VWIDTH, acc2);
+            vf_store(c + k + 3*SEE_VWIDTH, acc3);
+        }
+        for (; k + SEE_VWIDTH <= n; k += SEE_VWIDTH)
+        {
+            vfloat acc = vf_set(0.0f);
+            for (size_t j = 0; j < p; j++)
+                acc = vf_add(acc, vf_mul(vf_load(a + k + j), vf_set(f[(long)j*ifl])));
+            vf_store(c + k, acc);
+        }
+    }
+    for (; k < n; k++)
+    {
+        float acc = 0.0f;
+        const float *src = a + (long)k*ia;
+        for (size_t j = 0; j < p; j++) acc = acc + src[(long)j*ia]*f[(long)j*ifl];
+        c[(long)k*ic] = acc;
+    }
+}
+
+void see_desamp(const float *a, long df, const float *f, float *c, size_t n, size_t p)
+{
+    size_t k = 0;
+    if (df == 2)
+    {
+        // taps read every other sample, so deinterleave the even lanes on load; each load also
+        // reads the odd sample after the last even one, so the final block goes to the scalar tail
+        for (; k + SEE_VWIDTH < n; k += SEE_VWIDTH)
+        {
+            const float *src = a + 2*k;
+            vfloat acc = vf_set(0.0f);
+            for (size_t j = 0; j < p; j++)
+                acc = vf_add(acc, vf_mul(vf_load_even(src + j), vf_set(f[j])));
+            vf_store(c + k, acc);
+        }
+    }
+    for (; k < n; k++)
+    {
+        float acc = 0.0f;
+        const float *src = a + (long)k*df;
+        for (size_t j = 0; j < p; j++) acc = acc + src[j]*f[j];
+        c[k] = acc;
+    }
+}
+
+void see_vlint(const float *a, const float *b, long ib, float *c, long ic, size_t n, size_t m)
+{
+    long last = (long)m - 1;
+    for (size_t i = 0; i < n; i++)
+    {
+        float x = b[i*ib];
+        long idx = (long)x;
+        float alpha = x - idx;
+        long next = (idx < last ? idx + 1 : last);
+        c[i*ic] = a[idx] + alpha*(a[next] - a[idx]);
+    }
+}
+
+#endif
+
+#pragma mark ROW KERNELS (ALL BACKENDS)
+
+void see_convVer(const float *const *rows, long df, const float *f, long ifl,
+                 float *c, long ic, size_t w, size_t n, size_t p)
+{
+    size_t r = 0;
+    
+    // four output rows per sweep: each input row is loaded once and feeds every
+    // output row whose window covers it
+    for (; r + 4 <= n; r += 4)
+    {
+        const float *const *in = rows + r*df;
+        float *out = c + r*ic;
+        long span = 3*df + (long)p;                         //!< input rows touched by this block
+        size_t x = 0;
+        for (; x + 2*SEE_VWIDTH <= w; x += 2*SEE_VWIDTH)
+        {
+            vfloat a0 = vf_set(0.0f), a1 = a0, a2 = a0, a3 = a0;
+            vfloat b0 = a0, b1 = a0, b2 = a0, b3 = a0;
+            for (long i = 0; i < span; i++)
+            {
+                vfloat va = vf_load(in[i] + x), vb = vf_load(in[i] + x + SEE_VWIDTH);
+                long j;
+                j = i;        if (j < (long)p) { vfloat k = vf_set(f[j*ifl]); a0 = vf_add(a0, vf_mul(va, k)); b0 = vf_add(b0, vf_mul(vb, k)); }
+                j = i - df;   if (j >= 0 && j < (long)p) { vfloat k = vf_set(f[j*ifl]); a1 = vf_add(a1, vf_mul(va, k)); b1 = vf_add(b1, vf_mul(vb, k)); }
+                j = i - 2*df; if (j >= 0 && j < (long)p) { vfloat k = vf_set(f[j*ifl]); a2 = vf_add(a2, vf_mul(va, k)); b2 = vf_add(b2, vf_mul(vb, k)); }
+                j = i - 3*df; if (j >= 0) { vfloat k = vf_set(f[j*ifl]); a3 = vf_add(a3, vf_mul(va, k)); b3 = vf_add(b3, vf_mul(vb, k)); }
+            }
+            vf_store(out + x, a0);          vf_store(out + x + SEE_VWIDTH, b0);
+            vf_store(out + ic + x, a1);     vf_store(out + ic + x + SEE_VWIDTH, b1);
+            vf_store(out + 2*ic + x, a2);   vf_store(out + 2*ic + x + SEE_VWIDTH, b2);
+            vf_store(out + 3*ic + x, a3);   vf_store(out + 3*ic + x + SEE_VWIDTH, b3);
+        }
+        for (; x < w; x++)
+        {
+            for (int q = 0; q < 4; q++)
+            {
+                float acc = 0.0f;
+                for (size_t j = 0; j < p; j++) acc = acc + in[q*df + j][x]*f[(long)j*ifl];
+                out[q*ic + x] = acc;
+            }
+        }
+    }
+    
+    // remaining rows one at a time
+    for (; r < n; r++)
+    {
+        const float *const *in = rows + r*df;
+        float *out = c + r*ic;
+        size_t x = 0;
+        for (; x + SEE_VWIDTH <= w; x += SEE_VWIDTH)
+        {
+            vfloat acc = vf_set(0.0f);
+            for (size_t j = 0; j < p; j++)
+                acc = vf_add(acc, vf_mul(vf_load(in[j] + x), vf_set(f[(long)j*ifl])));
+            vf_store(out + x, acc);
+        }
+        for (; x < w; x++)
+        {
+            float acc = 0.0f;
+            for (size_t j = 0; j < p; j++) acc = acc + in[j][x]*f[(long)j*ifl];
+            out[x] = acc;
+        }
+    }
+}
@@ -0,0 +1,178 @@
+//
+//  SeeVector.h
+//  Framework-See
+//
+//	Copyright 2014 Carnegie Mellon University
+//
+//	This work was developed under the Rehabilitation Engineering Research
+//	Center on Accessible Public Transportation (www.rercapt.org) and is funded
+//	by grant number H133E080019 from the United States Department of Education
+//	through the National Institute on Disability and Rehabilitation Research.
+//	No endorsement should be assumed by NIDRR or the United States Government
+//	for the content contained on this code.
+//
+//	Permission is hereby granted, free of charge, to any person obtaining a copy
+//	of this software and associated documentation files (the "Software"), to deal
+//	in the Software without restriction, including without limitation the rights
+//	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//	copies of the Software, and to permit persons to whom the Software is
+//	furnished to do so, subject to the following conditions:
+//
+//	The above copyright notice and this permission notice shall be included in
+//	all copies or substantial portions of the Software.
+//
+//	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//	THE SOFTWARE.
+
+#ifndef SEE_VECTOR
+#define SEE_VECTOR
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Vector backend used by all the image processing routines in See. The backend
+// is chosen at build time. Define one of the SEE_BACKEND_* macros to force it,
+// otherwise Accelerate is used on Apple platforms and the widest SIMD extension
+// the compiler targets is used elsewhere.
+#if !defined(SEE_BACKEND_ACCELERATE) && !defined(SEE_BACKEND_AVX2) && \
+    !defined(SEE_BACKEND_SSE) && !defined(SEE_BACKEND_NEON) && !defined(SEE_BACKEND_SCALAR)
+    #if defined(__APPLE__)
+        #define SEE_BACKEND_ACCELERATE
+    #elif defined(__AVX2__)
+        #define SEE_BACKEND_AVX2
+    #elif defined(__SSE2__) || defined(_M_X64)
+        #define SEE_BACKEND_SSE
+    #elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+        #define SEE_BACKEND_NEON
+    #else
+        #define SEE_BACKEND_SCALAR
+    #endif
+#endif
+
+#ifdef SEE_BACKEND_ACCELERATE
+#include <Accelerate/Accelerate.h>
+#endif
+
+#if __cplusplus
+extern "C" {
+#endif
+
+    /*! Name of the vector backend selected at build time (e.g., "accelerate", "avx2") */
+    const char* see_vectorBackend();
+
+#pragma mark COPY AND CONVERSION
+
+    void see_scopy(int n, const float *x, int incx, float *y, int incy);
+    void see_vclr(float *c, long ic, size_t n);
+    void see_vramp(const float *a, const float *b, float *c, long ic, size_t n);
+    void see_vfltu8(const unsigned char *a, long ia, float *c, long ic, size_t n);
+    void see_vfixru8(const float *a, long ia, unsigned char *c, long ic, size_t n);
+    void see_vflt32(const int *a, long ia, float *c, long ic, size_t n);
+    void see_vfix32(const float *a, long ia, int *c, long ic, size_t n);
+
+#pragma mark ARITHMETIC
+
+    /*! C = A + B */
+    void see_vadd(const float *a, long ia, const float *b, long ib, float *c, long ic, size_t n);
+    /*! C = B - A (same operand order as vDSP_vsub) */
+    void see_vsub(const float *a, long ia, const float *b, long ib, float *c, long ic, size_t n);
+    /*! C = A + b */
+    void see_vsadd(const float *a, long ia, const float *b, float *c, long ic, size_t n);
+    /*! C = A * b */
+    void see_vsmul(const float *a, long ia, const float *b, float *c, long ic, size_t n);
+    /*! D = A * b + C */
+    void see_vsma(const float *a, long ia, const float *b, const float *c, long ic, float *d, long id, size_t n);
+    /*! x = alpha * x */
+    void see_sscal(int n, float alpha, float *x, int incx);
+    /*! C = |A| */
+    void see_vabs(const float *a, long ia, float *c, long ic, size_t n);
+    /*! C = max(A,B) */
+    void see_vmax(const float *a, long ia, const float *b, long ib, float *c, long ic, size_t n);
+    /*! C = min(A,B) */
+    void see_vmin(const float *a, long ia, const float *b, long ib, float *c, long ic, size_t n);
+    /*! C = (A >= b ? A : 0) */
+    void see_vthres(const float *a, long ia, const float *b, float *c, long ic, size_t n);
+
+#pragma mark REDUCTIONS
+
+    void see_maxv(const float *a, long ia, float *c, size_t n);
+    void see_minv(const float *a, long ia, float *c, size_t n);
+    void see_sve(const float *a, long ia, float *c, size_t n);
+    void see_svesq(const float *a, long ia, float *c, size_t n);
+    /*! Minimum and sum of A in a single pass */
+    void see_minsve(const float *a, long ia, float *minimum, float *sum, size_t n);
+    void see_dotpr(const float *a, long ia, const float *b, long ib, float *c, size_t n);
+
+#pragma mark FILTERING AND INTERPOLATION
+
+    /*! Correlation/convolution with the semantics of vDSP_conv
+        \param a input signal (at least n + p - 1 elements)
+        \param ia <a>a</a> stride
+        \param f filter (pass the address of the last tap and <a>ifl</a> = -1 to convolve)
+        \param ifl <a>f</a> stride
+        \param c output (n elements)
+        \param ic <a>c</a> stride
+        \param n output length
+        \param p filter length
+
+        \f[ c_{k} = \sum_{j=0}^{p-1} a_{k+j} f_{j} \f]
+
+        \note The SIMD backends accumulate taps in ascending order of <a>j</a>.
+     */
+    void see_conv(const float *a, long ia, const float *f, long ifl,
+                  float *c, long ic, size_t n, size_t p);
+
+    /*! Decimating correlation with the semantics of vDSP_desamp
+        \param a input signal (at least df*(n-1) + p elements)
+        \param df decimation factor
+        \param f filter (read forwards)
+        \param c output (n elements, stride 1)
+        \param n output length
+        \param p filter length
+
+        \f[ c_{k} = \sum_{j=0}^{p-1} a_{k \cdot df+j} f_{j} \f]
+     */
+    void see_desamp(const float *a, long df, const float *f, float *c, size_t n, size_t p);
+
+    /*! Vertical correlation/convolution over rows of an image (row-major)
+        \param rows input row pointers (at least df*(n-1) + p entries)
+        \param df row step between consecutive outputs (use 2 to decimate)
+        \param f filter (pass the address of the last tap and <a>ifl</a> = -1 to convolve)
+        \param ifl <a>f</a> stride
+        \param c first output row
+        \param ic elements between output rows
+        \param w row width
+        \param n number of output rows
+        \param p filter length
+
+        \f[ c_{r,x} = \sum_{j=0}^{p-1} rows_{r \cdot df+j}[x] f_{j} \f]
+
+        Rows are passed by address so that replicated borders do not need to be copied.
+        Several output rows are accumulated in registers while walking the input rows
+        left to right, so memory is always read sequentially. Taps are accumulated in
+        ascending order of <a>j</a>, as in see_conv.
+     */
+    void see_convVer(const float *const *rows, long df, const float *f, long ifl,
+                     float *c, long ic, size_t w, size_t n, size_t p);
+
+    /*! Linear interpolation with the semantics of vDSP_vlint
+        \param a table
+        \param b fractional indices into <a>a</a>
+        \param ib <a>b</a> stride
+        \param c output
+        \param ic <a>c</a> stride
+        \param n number of elements to interpolate
+        \param m <a>a</a> length
+     */
+    void see_vlint(const float *a, const float *b, long ib, float *c, long ic, size_t n, size_t m);
+
+#if __cplusplus
+}
+#endif
+
+#endif
@@ -20,6 +20,7 @@
 
 @property (nonatomic, assign) id<RenderViewDelegate> delegate;
 
+- (GLubyte *) resizedGrayData;
 - (img) intensityFromResizedGray;
 - (void) processPixelBufferRef:(CVPixelBufferRef)pixelBufferRef;
 
@@ -23,8 +23,8 @@ inline float mini(int a, int b){ return (a < b ? a : b); }
     self.delegate = nil;
 }
 
-- (img) intensityFromResizedGray
-{    
+- (GLubyte *) resizedGrayData
+{
     if (![EAGLContext setCurrentContext:self.eaglContext])
     {
         GLVDebugLog(@"ERROR: Could not set up EAGLContext to process camera image.");
@@ -38,6 +38,14 @@ inline float mini(int a, int b){ return (a < b ? a : b); }
     GLubyte *resizedData = getRedUByteDataFromFBOTexture(0, 0, resizeTexture.size.width, resizeTexture.size.height);
     [GLVEngine glError:GLVDebugFile];
     
+    return resizedData;
+}
+
+- (img) intensityFromResizedGray
+{    
+    GLubyte *resizedData = [self resizedGrayData];
+    if (resizedData == 0) return 0;
+    
     img resizedImg = (float *)malloc(sizeof(float)*resizeTexture.size.width*resizeTexture.size.height);
     for (int r=0; r<resizeTexture.size.height; r++)
     {   
@@ -58,16 +66,16 @@ inline float mini(int a, int b){ return (a < b ? a : b); }
     // resize pixel buffer
     [self resizePixelBufferAndConvertToGray:pixelBufferRef];
     
-    // compute blurry level
-    img gray = [self intensityFromResizedGray];
+    // compute blurry level (on the 8-bit data: the metric does not change with flips or transposition)
+    GLubyte *gray = [self resizedGrayData];
     if (gray == 0)
     {
-        NSLog(@"ERROR: Could not convert pixelBuffer to img!");
+        NSLog(@"ERROR: Could not read resized gray image!");
         return;
     }
     
-    float b = perceptualBlurMetric(gray, resizeTexture.size.width, resizeTexture.size.height, 
-                                   resizeTexture.size.width, FILTER_AVERAGE5, FSIZE_AVERAGE5);
+    float b = perceptualBlurMetricU8(gray, resizeTexture.size.width, resizeTexture.size.height, 
+                                     resizeTexture.size.width, FSIZE_AVERAGE5);
     
     free(gray);
     
@@ -176,7 +176,7 @@
     double tPyr = tic();
 #endif
     
-    pyr pyramid;
+    Pyramid pyramid;
     see_pyramid(intensity, width, height, levels, pyramid, FILTER_GAUS7, FSIZE_GAUS7, 0);
     
 #ifdef TIME_PYRAMID
@@ -193,7 +193,7 @@
         CALayer *layer = (CALayer *)[self.pyrLevelLayers objectAtIndex:l];
         CGImageRelease((__bridge CGImageRef) layer.contents);
         
-        unsigned char* levelIm = see_floatArrayToUChar(pyramid.at(l), length, 0, 0, 1);
+        unsigned char* levelIm = see_floatArrayToUChar(see_pyramidLevel(pyramid, l), length, 0, 0, 1);
         
         context = CGBitmapContextCreate(levelIm, width, height, 8, width, colorSpace, kCGImageAlphaNone);
         CGImageRef image = CGBitmapContextCreateImage(context);
@@ -213,7 +213,7 @@
     
     CGColorSpaceRelease(colorSpace);
     
-    see_freePyr(pyramid);
+    see_freePyramid(pyramid);
     
 #endif
     
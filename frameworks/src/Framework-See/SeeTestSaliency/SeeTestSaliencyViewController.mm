@@ -205,13 +205,14 @@
         
         int height = CVPixelBufferGetHeight(pixelBufferRef);
         int width = CVPixelBufferGetWidth(pixelBufferRef);
+        size_t bytesPerRow = CVPixelBufferGetBytesPerRow(pixelBufferRef);
         rowBase = (unsigned char *)CVPixelBufferGetBaseAddress(pixelBufferRef);
     
 #ifdef TIME_PROCESSBUFFER
         double tSaliency = tic();
 #endif
     
-        see_saliencyItti( rowBase, width, height, self.pyrSize, self.pyrOffset, self.surrLev, saliency, w, h, NULL, NULL, NULL);
+        see_saliencyItti( rowBase, width, height, self.pyrSize, self.pyrOffset, self.surrLev, saliency, w, h, NULL, NULL, NULL, bytesPerRow);
             
 #ifdef TIME_PROCESSBUFFER
         tSaliency = toc(tSaliency);
@@ -273,15 +274,9 @@
         double tROI = tic();
 #endif
         
-        see_uniformThresh(&saliency, w*h);
-        
-        int nlabels = 0;
-		img labels = see_labelBlobs(saliency, w, h, nlabels);
-        
-		float selected = see_selectMostMeaningfulBlob(saliency, w*h, labels, nlabels, 
-                                                      true, 0, 0, 0, 0);
+        img labels = 0;
         float wx = 0, wy = 0;
-		see_weightedMean( saliency, w, h, labels, selected, wx, wy);
+		float selected = see_salientBlobCentroid(saliency, w, h, wx, wy, &labels);
         
 #ifdef TIME_PROCESSBUFFER
         tROI = toc(tROI);
@@ -0,0 +1,183 @@
+//
+//  main.cpp
+//  SeeTestSaliencyEngine
+//
+//	Copyright 2014 Carnegie Mellon University
+//
+//	This work was developed under the Rehabilitation Engineering Research
+//	Center on Accessible Public Transportation (www.rercapt.org) and is funded
+//	by grant number H133E080019 from the United States Department of Education
+//	through the National Institute on Disability and Rehabilitation Research.
+//	No endorsement should be assumed by NIDRR or the United States Government
+//	for the content contained on this code.
+//
+//	Permission is hereby granted, free of charge, to any person obtaining a copy
+//	of this software and associated documentation files (the "Software"), to deal
+//	in the Software without restriction, including without limitation the rights
+//	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//	copies of the Software, and to permit persons to whom the Software is
+//	furnished to do so, subject to the following conditions:
+//
+//	The above copyright notice and this permission notice shall be included in
+//	all copies or substantial portions of the Software.
+//
+//	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//	THE SOFTWARE.
+
+// Checks that a SaliencyEngine does not allocate memory per frame: after the first frame, 
+// see_saliencyEngineIttiWithFeatures must not call malloc, calloc, realloc or posix_memalign, 
+// and it must keep producing the map of see_saliencyIttiWithFeatures. The allocation functions 
+// are replaced below, so the See sources have to be built into the test itself. From this folder:
+//
+//   c++ -O2 -I.. -I../../Framework-BasicMath -I../../Framework-DataLogging -o SeeTestSaliencyEngine
+//       main.cpp ../See/*.cpp ../../Framework-BasicMath/BasicMath/Vector2.cpp 
+//       ../../Framework-BasicMath/BasicMath/Rectangle.cpp ../../Framework-DataLogging/DataLogging/DLTiming.cpp
+//       -lpthread
+//
+// The exit status is the number of failed checks.
+
+#include <See/ImageConversion.h>
+#include <See/ImageSaliency.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#ifdef __GLIBC__
+extern "C" void *__libc_malloc(size_t size);
+extern "C" void *__libc_calloc(size_t count, size_t size);
+extern "C" void *__libc_realloc(void *ptr, size_t size);
+extern "C" void *__libc_memalign(size_t alignment, size_t size);
+
+static void *systemMalloc(size_t size)                  { return __libc_malloc(size); }
+static void *systemCalloc(size_t count, size_t size)    { return __libc_calloc(count, size); }
+static void *systemRealloc(void *ptr, size_t size)      { return __libc_realloc(ptr, size); }
+static int systemMemalign(void **ptr, size_t alignment, size_t size)
+{
+    *ptr = __libc_memalign(alignment, size);
+    return (*ptr != 0 ? 0 : ENOMEM);
+}
+#else
+#include <dlfcn.h>
+
+// the definitions below take precedence within this executable, so look up the system ones
+static void *systemMalloc(size_t size)
+{
+    static void *(*next)(size_t) = (void *(*)(size_t))dlsym(RTLD_NEXT, "malloc");
+    return next(size);
+}
+static void *systemCalloc(size_t count, size_t size)
+{
+    static void *(*next)(size_t, size_t) = (void *(*)(size_t, size_t))dlsym(RTLD_NEXT, "calloc");
+    return next(count, size);
+}
+static void *systemRealloc(void *ptr, size_t size)
+{
+    static void *(*next)(void *, size_t) = (void *(*)(void *, size_t))dlsym(RTLD_NEXT, "realloc");
+    return next(ptr, size);
+}
+static int systemMemalign(void **ptr, size_t alignment, size_t size)
+{
+    static int (*next)(void **, size_t, size_t) = (int (*)(void **, size_t, size_t))dlsym(RTLD_NEXT, "posix_memalign");
+    return next(ptr, alignment, size);
+}
+#endif
+
+static volatile long allocations = 0;      //!< calls to the allocation functions so far
+
+extern "C" void *malloc(size_t size)                { allocations++; return systemMalloc(size); }
+extern "C" void *calloc(size_t count, size_t size)  { allocations++; return systemCalloc(count, size); }
+extern "C" void *realloc(void *ptr, size_t size)    { allocations++; return systemRealloc(ptr, size); }
+extern "C" int posix_memalign(void **ptr, size_t alignment, size_t size)
+{
+    allocations++;
+    return systemMemalign(ptr, alignment, size);
+}
+
+#define TEST_WIDTH  640         //!< camera image width
+#define TEST_HEIGHT 480         //!< camera image height
+#define TEST_PYRLEV 3           //!< saliency pyramid levels
+#define TEST_SURRLEV 3          //!< saliency surround levels
+#define TEST_FRAMES 5           //!< frames processed after the first one
+
+/*! Process a few frames with one engine configuration
+    \param featInt intensity feature
+    \param featRG r-g feature
+    \param featBY b-y feature
+    \param width feature width
+    \param height feature height
+    \param reference saliency of the features (see_saliencyIttiWithFeatures)
+    \param threads engine threads
+    \param bands engine row bands per channel
+    \return number of failed checks
+ */
+static int testEngine(const img featInt, const img featRG, const img featBY, size_t width, size_t height,
+                      const img reference, size_t threads, size_t bands)
+{
+    int failed = 0;
+    img saliency = (img)malloc(width*height*sizeof(float));
+    
+    SaliencyEngine engine;
+    see_initSaliencyEngine(engine, width, height, TEST_PYRLEV, TEST_SURRLEV, threads, bands);
+    see_saliencyEngineIttiWithFeatures(engine, featInt, featRG, featBY, saliency);
+    
+    for (int f=0; f<TEST_FRAMES; f++)
+    {
+        long before = allocations;
+        see_initSaliencyEngine(engine, width, height, TEST_PYRLEV, TEST_SURRLEV, threads, bands);
+        see_saliencyEngineIttiWithFeatures(engine, featInt, featRG, featBY, saliency);
+        long count = allocations - before;
+        
+        bool same = (memcmp(saliency, reference, width*height*sizeof(float)) == 0);
+        if (count != 0 || !same)
+        {
+            printf("FAILED threads %zu bands %zu frame %d: %ld allocations, %s map\n", 
+                   threads, bands, f + 1, count, (same ? "same" : "different"));
+            failed++;
+        }
+    }
+    
+    see_freeSaliencyEngine(engine);
+    free(saliency);
+    return failed;
+}
+
+int main()
+{
+    // synthetic BGRA frame with a bright disc
+    size_t width = TEST_WIDTH, height = TEST_HEIGHT;
+    unsigned char *bgra = (unsigned char *)malloc(width*height*4);
+    for (size_t y=0; y<height; y++)
+    {
+        for (size_t x=0; x<width; x++)
+        {
+            unsigned char *p = bgra + 4*(y*width + x);
+            long dx = (long)x - (long)width/2, dy = (long)y - (long)height/2;
+            p[0] = (3*x + y) % 256;
+            p[1] = (x*y/7) % 256;
+            p[2] = (dx*dx + dy*dy < 4000 ? 250 : y % 256);
+            p[3] = 255;
+        }
+    }
+    
+    img featInt, featRG, featBY, reference;
+    see_featuresItti(bgra, width, height, 2, &featInt, &featRG, &featBY);
+    see_saliencyIttiWithFeatures(featInt, featRG, featBY, width, height, TEST_PYRLEV, TEST_SURRLEV, reference);
+    
+    int failed = 0;
+    failed += testEngine(featInt, featRG, featBY, width, height, reference, 1, 1);
+    failed += testEngine(featInt, featRG, featBY, width, height, reference, 3, 1);
+    failed += testEngine(featInt, featRG, featBY, width, height, reference, 3, 4);
+    
+    free(reference);
+    free(featInt); free(featRG); free(featBY);
+    free(bgra);
+    
+    printf("%s\n", (failed == 0 ? "ok" : "FAILED"));
+    return failed;
+}